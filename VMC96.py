@@ -26,6 +26,8 @@
 #	THE SOFTWARE.
 #
 import time
+import asyncio
+import concurrent.futures
 import usb.core
 import pyftdi.ftdi as ftdi
 
@@ -180,9 +182,8 @@ class VMC96( object ):
 	def relay_set_state( self, relay_id, state ):
 		return self._execute_command( VMC96._CONTROLLER_RELAY + relay_id, VMC96._COMMAND_RELAY_CONTROL, [state] )
 
-	def opto_sensor_read( self ):
+	def _decode_opto_sensor( self, data ):
 		ret = []
-		data = self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_OPTO_SENSOR_STATUS )
 		if( len(data) != 5 ):
 			raise RuntimeError( "Invalid Opto Sensor Response: " + self._error_to_string(VMC96._ERR_RESPONSE_INVALID_LENGTH) )
 		if( data[0] != VMC96._COMMAND_MOTOR_OPTO_SENSOR_STATUS ):
@@ -192,8 +193,7 @@ class VMC96( object ):
 				ret.append( (byte >> bit) & 0x01 )
 		return ret
 
-	def motor_scan_array( self ):
-		data = self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_SCAN_ARRAY )
+	def _decode_motor_scan_array( self, data ):
 		if( len(data) < 2 ):
 			raise RuntimeError( "Invalid Motor Array Scan Response: " + self._error_to_string(VMC96._ERR_RESPONSE_INVALID_LENGTH) )
 		if( data[0] != VMC96._COMMAND_MOTOR_SCAN_ARRAY ):
@@ -208,9 +208,92 @@ class VMC96( object ):
 		for idx_row, row in enumerate(motor_array):
 			for idx_col, col in enumerate(row):
 				if( motor_array[idx_row][idx_col] != 0 ):
-					status.append( "0x{X}{X}".format( idx_row + 1, idx_col + 1 ) )
+					status.append( "0x{:X}{:X}".format( idx_row + 1, idx_col + 1 ) )
 		current_ma = float(( 500.0 * int(data[1]) ) / 255.0)
 		return { "current_ma": current_ma, "available_motors": status }
 
+	def opto_sensor_read( self ):
+		return self._decode_opto_sensor( self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_OPTO_SENSOR_STATUS ) )
+
+	def motor_scan_array( self ):
+		return self._decode_motor_scan_array( self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_SCAN_ARRAY ) )
+
+
+class AsyncVMC96( VMC96 ):
+
+	# Frame Reader (The Event Loop Keeps Running While a Response is Pending)
+	_ASYNC_RESPONSE_TIMEOUT             = 1.0    # Same budget as 100 polls of 10ms
+	_ASYNC_POLL_INTERVAL                = 0.001  # 1ms between empty reads
+
+	def __init__( self, invertedArray=False ):
+		VMC96.__init__( self, invertedArray )
+		self._lock = asyncio.Lock()
+		# One I/O thread per board: a read abandoned by a timeout completes before the next purge/write
+		self._executor = concurrent.futures.ThreadPoolExecutor( max_workers=1 )
+
+	def __str__( self ):
+		return str("VMC96 Async API")
+
+	async def _io( self, func, *args ):
+		# USB transfers run on the board I/O thread, never on the event loop
+		return await asyncio.get_running_loop().run_in_executor( self._executor, func, *args )
+
+	async def _read_frame( self ):
+		resp = []
+		while( True ):
+			chunk = await self._io( self.ftdi.read_data_bytes, VMC96._MESSAGE_MAX_LENGTH, 1 )
+			if( len(chunk) > 0 ):
+				resp += list(chunk)
+				# Complete as soon as the length byte is satisfied, no fixed sleep
+				if( (len(resp) >= 3) and (len(resp) >= resp[2]) ):
+					return resp
+			else:
+				await asyncio.sleep( AsyncVMC96._ASYNC_POLL_INTERVAL )
+
+	async def _send_request( self, req ):
+		if( self.on_log != None ):
+			self._log( "VMC96 Request: " + self._request_to_string(req) )
+		# Drop a late response to a previous (timed out) request
+		await self._io( self.ftdi.purge_rx_buffer )
+		await self._io( self.ftdi.write_data, bytes(req) )
+		try:
+			resp = await asyncio.wait_for( self._read_frame(), AsyncVMC96._ASYNC_RESPONSE_TIMEOUT )
+		except asyncio.TimeoutError:
+			resp = []
+		if( self.on_log != None ):
+			self._log( "VMC96 Response: " + self._response_to_string(resp) )
+		return resp
+
+	async def _execute_command( self, cntrl, cmd, args=[] ):
+		req = self._prepare_request( cntrl, cmd, args )
+		# One request/response on the bus at a time, across all tasks sharing the board
+		async with self._lock:
+			resp = await self._send_request( req )
+		ret, data = self._parse_response( cntrl, resp )
+		if( ret != VMC96._RESPONSE_VALID ):
+			raise RuntimeError( "Invalid Response: " + self._error_to_string(ret) )
+		return data
+
+	async def motor_run( self, motor_id ):
+		return await self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_RUN, [ motor_id if not self.inverted else self._invert_motor_id( motor_id ) ] )
+
+	async def motor_stop_all( self ):
+		return await self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_STOP_ALL )
+
+	async def motor_reset( self ):
+		return await self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_RESET )
+
+	async def relay_reset( self, relay_id ):
+		return await self._execute_command( VMC96._CONTROLLER_RELAY + relay_id, VMC96._COMMAND_RELAY_RESET )
+
+	async def relay_set_state( self, relay_id, state ):
+		return await self._execute_command( VMC96._CONTROLLER_RELAY + relay_id, VMC96._COMMAND_RELAY_CONTROL, [state] )
+
+	async def opto_sensor_read( self ):
+		return self._decode_opto_sensor( await self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_OPTO_SENSOR_STATUS ) )
+
+	async def motor_scan_array( self ):
+		return self._decode_motor_scan_array( await self._execute_command( VMC96._CONTROLLER_MOTOR, VMC96._COMMAND_MOTOR_SCAN_ARRAY ) )
+
 # end-of-file #
 
@@ -0,0 +1,595 @@
+/*!
+	\file vmc96bench.c
+	\brief VMC96 Host-Side Protocol Micro-Benchmarks
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/*
+	The API and the CLI are compiled into this translation unit so their static
+	functions (frame encoding, checksum, parser, decoders, CLI dispatch) can be
+	measured directly. Heap allocations made by them are counted through the
+	malloc()/calloc()/realloc() macros defined below.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+
+/* ********************************************************************* */
+/* *                        ALLOCATION COUNTING                        * */
+/* ********************************************************************* */
+
+static unsigned long long vmc96bench_allocs = 0;
+
+static __attribute__((unused)) void * vmc96bench_malloc( size_t size )
+{
+	__atomic_add_fetch( &vmc96bench_allocs, 1, __ATOMIC_RELAXED );
+	return malloc( size );
+}
+
+static __attribute__((unused)) void * vmc96bench_calloc( size_t n, size_t size )
+{
+	__atomic_add_fetch( &vmc96bench_allocs, 1, __ATOMIC_RELAXED );
+	return calloc( n, size );
+}
+
+static __attribute__((unused)) void * vmc96bench_realloc( void * ptr, size_t size )
+{
+	__atomic_add_fetch( &vmc96bench_allocs, 1, __ATOMIC_RELAXED );
+	return realloc( ptr, size );
+}
+
+#define malloc( _size )            vmc96bench_malloc( _size )
+#define calloc( _n, _size )        vmc96bench_calloc( _n, _size )
+#define realloc( _ptr, _size )     vmc96bench_realloc( _ptr, _size )
+
+#define main vmc96cli_main
+#include "../vmc96api.c"
+#include "../vmc96cli.c"
+#undef main
+
+
+/* ********************************************************************* */
+/* *                              DEFINES                              * */
+/* ********************************************************************* */
+
+#define VMC96BENCH_DEFAULT_MIN_TIME_MS                    (250)
+#define VMC96BENCH_CALIBRATION_TIME_NS                    (10000000ULL)
+#define VMC96BENCH_DEFAULT_OUTPUT                         "vmc96bench.json"
+#define VMC96BENCH_MAX_RESULTS                            (32)
+
+
+/* ********************************************************************* */
+/* *                        STRUCTS AND DATA TYPES                     * */
+/* ********************************************************************* */
+
+typedef struct vmc96bench_device_s vmc96bench_device_t;
+typedef struct vmc96bench_case_s vmc96bench_case_t;
+typedef struct vmc96bench_result_s vmc96bench_result_t;
+
+/* In-memory board: answers every request instantly with a canned frame */
+struct vmc96bench_device_s
+{
+	unsigned char ack[ VMC96_K1_MESSAGE_MAX_LEN ];
+	unsigned char status[ VMC96_K1_MESSAGE_MAX_LEN ];
+	unsigned char opto[ VMC96_K1_MESSAGE_MAX_LEN ];
+	unsigned char scan[ VMC96_K1_MESSAGE_MAX_LEN ];
+	unsigned char version[ VMC96_K1_MESSAGE_MAX_LEN ];
+	const unsigned char * pending;
+};
+
+struct vmc96bench_case_s
+{
+	const char * name;
+	void (*run)( unsigned long long iterations );
+	unsigned int bytes_per_op;      /* Frame bytes handled per operation (throughput) */
+};
+
+struct vmc96bench_result_s
+{
+	const char * name;
+	unsigned long long iterations;
+	double ns_per_op;
+	double ops_per_sec;
+	double mb_per_sec;
+	double allocs_per_op;
+	unsigned int bytes_per_op;
+};
+
+
+/* ********************************************************************* */
+/* *                             FIXTURES                              * */
+/* ********************************************************************* */
+
+static VMC96_t * vmc96bench_ctx = NULL;
+static vmc96bench_device_t vmc96bench_dev;
+static vmc96_message_t vmc96bench_status_response;
+static vmc96_message_t vmc96bench_opto_response;
+static vmc96_message_t vmc96bench_scan_response;
+static unsigned char vmc96bench_small_frame[ VMC96_K1_MESSAGE_MIN_LEN ] = { VMC96_K1_MESSAGE_STX, 0x30, 0x05, 0x10, 0x00 };
+static unsigned char vmc96bench_large_frame[ VMC96_K1_MESSAGE_MAX_LEN ];
+static volatile int vmc96bench_sink = 0;
+
+
+static void vmc96bench_build_frame( unsigned char * frame, unsigned char id, const unsigned char * data, int length )
+{
+	frame[0] = VMC96_K1_MESSAGE_STX;
+	frame[1] = id;
+	frame[2] = length + 4;
+	memcpy( frame + 3, data, length );
+	frame[ length + 3 ] = vmc96_calculate_checksum( frame, length + 3 );
+}
+
+
+static int vmc96bench_device_purge( void * userdata )
+{
+	((vmc96bench_device_t*) userdata)->pending = NULL;
+	return 0;
+}
+
+
+static int vmc96bench_device_write( void * userdata, const unsigned char * buf, int len )
+{
+	vmc96bench_device_t * dev = (vmc96bench_device_t*) userdata;
+
+	switch( buf[3] )
+	{
+		case VMC96_COMMAND_MOTOR_STATUS_REQUEST   : dev->pending = dev->status; break;
+		case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS : dev->pending = dev->opto; break;
+		case VMC96_COMMAND_KERNEL_VERSION         : dev->pending = dev->version; break;
+		default                                   : dev->pending = dev->ack; break;
+	}
+
+	/* Scan and relay function share a command code: the controller decides */
+	if( (buf[1] == VMC96_CONTROLLER_MOTOR_ARRAY) && (buf[3] == VMC96_COMMAND_MOTOR_SCAN_ARRAY) )
+		dev->pending = dev->scan;
+
+	dev->ack[1] = buf[1];
+	dev->ack[4] = vmc96_calculate_checksum( dev->ack, 4 );
+
+	return len;
+}
+
+
+static int vmc96bench_device_read( void * userdata, unsigned char * buf, int len )
+{
+	vmc96bench_device_t * dev = (vmc96bench_device_t*) userdata;
+	int n = 0;
+
+	if( !dev->pending )
+		return 0;
+
+	n = dev->pending[2];
+	memcpy( buf, dev->pending, n );
+	dev->pending = NULL;
+
+	return n;
+}
+
+
+static int vmc96bench_setup( void )
+{
+	int i = 0;
+	VMC96_transport_t transport;
+	unsigned char status[] = { VMC96_COMMAND_MOTOR_STATUS_REQUEST, 0x40, 0x11, 0x23, 0x45, 0x67 };
+	unsigned char opto[] = { VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS, 0x00, 0x00, 0xF0, 0xFF };
+	unsigned char scan[] = { VMC96_COMMAND_MOTOR_SCAN_ARRAY, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x3F, 0x1F, 0x0F };
+	unsigned char version[] = "VMC96 MOTOR V1.00";
+	unsigned char ack[] = { VMC96_K1_RESPONSE_POSITIVE_ACK };
+
+	vmc96bench_build_frame( vmc96bench_dev.ack, VMC96_CONTROLLER_MOTOR_ARRAY, ack, sizeof(ack) );
+	vmc96bench_build_frame( vmc96bench_dev.status, VMC96_CONTROLLER_MOTOR_ARRAY, status, sizeof(status) );
+	vmc96bench_build_frame( vmc96bench_dev.opto, VMC96_CONTROLLER_MOTOR_ARRAY, opto, sizeof(opto) );
+	vmc96bench_build_frame( vmc96bench_dev.scan, VMC96_CONTROLLER_MOTOR_ARRAY, scan, sizeof(scan) );
+	vmc96bench_build_frame( vmc96bench_dev.version, VMC96_CONTROLLER_MOTOR_ARRAY, version, sizeof(version) - 1 );
+
+	vmc96bench_small_frame[4] = vmc96_calculate_checksum( vmc96bench_small_frame, 4 );
+
+	for( i = 0; i < VMC96_K1_MESSAGE_MAX_LEN; i++ )
+		vmc96bench_large_frame[i] = (unsigned char)( i * 37 + 11 );
+
+	memset( &transport, 0, sizeof(transport) );
+	transport.purge = vmc96bench_device_purge;
+	transport.write = vmc96bench_device_write;
+	transport.read = vmc96bench_device_read;
+	transport.read_delay_ms = 0;
+	transport.userdata = &vmc96bench_dev;
+
+	if( vmc96_initialize_transport( &vmc96bench_ctx, &transport ) != VMC96_SUCCESS )
+		return -1;
+
+	/* Decoded once through the real path, then decoded repeatedly by the decoder benchmarks */
+	if( vmc96_send_message( vmc96bench_ctx, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STATUS_REQUEST, &vmc96bench_status_response ) ||
+		vmc96_send_message( vmc96bench_ctx, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS, &vmc96bench_opto_response ) ||
+		vmc96_send_message( vmc96bench_ctx, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_SCAN_ARRAY, &vmc96bench_scan_response ) )
+		return -1;
+
+	return 0;
+}
+
+
+/* ********************************************************************* */
+/* *                            BENCHMARKS                             * */
+/* ********************************************************************* */
+
+static void vmc96bench_checksum_small( unsigned long long iterations )
+{
+	while( iterations-- )
+		vmc96bench_sink += vmc96_calculate_checksum( vmc96bench_small_frame, sizeof(vmc96bench_small_frame) - 1 );
+}
+
+
+static void vmc96bench_checksum_large( unsigned long long iterations )
+{
+	while( iterations-- )
+		vmc96bench_sink += vmc96_calculate_checksum( vmc96bench_large_frame, sizeof(vmc96bench_large_frame) - 1 );
+}
+
+
+static void vmc96bench_prepare_ping( unsigned long long iterations )
+{
+	vmc96bench_ctx->message.id_controller = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96bench_ctx->message.command = VMC96_COMMAND_SIMPLE_PING;
+	vmc96bench_ctx->message.data_length = 0;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_prepare_k1_message( vmc96bench_ctx );
+}
+
+
+static void vmc96bench_prepare_run( unsigned long long iterations )
+{
+	vmc96bench_ctx->message.id_controller = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96bench_ctx->message.command = VMC96_COMMAND_MOTOR_RUN;
+	vmc96bench_ctx->message.data[0] = 0x11;
+	vmc96bench_ctx->message.data[1] = 0x23;
+	vmc96bench_ctx->message.data[2] = 0x45;
+	vmc96bench_ctx->message.data[3] = 0x67;
+	vmc96bench_ctx->message.data_length = 4;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_prepare_k1_message( vmc96bench_ctx );
+}
+
+
+static void vmc96bench_prepare_run_single( unsigned long long iterations )
+{
+	vmc96bench_ctx->message.id_controller = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96bench_ctx->message.command = VMC96_COMMAND_MOTOR_RUN;
+	vmc96bench_ctx->message.data[0] = VMC96_GET_MOTOR_ID( 2, 5 );
+	vmc96bench_ctx->message.data_length = 1;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_prepare_k1_message( vmc96bench_ctx );
+}
+
+
+/* What the send path does with a frame table entry instead of encoding */
+static void vmc96bench_table_run_single( unsigned long long iterations )
+{
+	const unsigned char * frame = vmc96bench_ctx->frames.motor_run[2][5];
+
+	while( iterations-- )
+	{
+		memcpy( vmc96bench_ctx->message.k1, frame, frame[2] );
+		vmc96bench_ctx->message.k1_length = frame[2];
+		vmc96bench_sink += vmc96bench_ctx->message.k1_length;
+	}
+}
+
+
+static void vmc96bench_parse( unsigned long long iterations, unsigned char command, const unsigned char * frame )
+{
+	vmc96bench_ctx->message.id_controller = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96bench_ctx->message.command = command;
+	vmc96bench_ctx->response.k1_length = frame[2];
+	memcpy( vmc96bench_ctx->response.k1, frame, frame[2] );
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_parse_k1_response( vmc96bench_ctx );
+}
+
+
+static void vmc96bench_parse_ack( unsigned long long iterations )
+{
+	vmc96bench_dev.ack[1] = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96bench_dev.ack[4] = vmc96_calculate_checksum( vmc96bench_dev.ack, 4 );
+
+	vmc96bench_parse( iterations, VMC96_COMMAND_SIMPLE_PING, vmc96bench_dev.ack );
+}
+
+
+static void vmc96bench_parse_status( unsigned long long iterations )
+{
+	vmc96bench_parse( iterations, VMC96_COMMAND_MOTOR_STATUS_REQUEST, vmc96bench_dev.status );
+}
+
+
+static void vmc96bench_parse_scan( unsigned long long iterations )
+{
+	vmc96bench_parse( iterations, VMC96_COMMAND_MOTOR_SCAN_ARRAY, vmc96bench_dev.scan );
+}
+
+
+static void vmc96bench_decode_status( unsigned long long iterations )
+{
+	VMC96_motor_array_status_t status;
+
+	while( iterations-- )
+	{
+		memset( &status, 0, sizeof(status) );
+		vmc96bench_sink += vmc96_decode_motor_status( &vmc96bench_status_response, &status );
+	}
+}
+
+
+static void vmc96bench_decode_opto( unsigned long long iterations )
+{
+	VMC96_opto_line_sample_block_t block;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_decode_opto_line_status( &vmc96bench_opto_response, &block );
+}
+
+
+static void vmc96bench_decode_scan( unsigned long long iterations )
+{
+	VMC96_motor_array_scan_result_t result;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_decode_scan_array( &vmc96bench_scan_response, &result );
+}
+
+
+static void vmc96bench_transaction_ping( unsigned long long iterations )
+{
+	while( iterations-- )
+		vmc96bench_sink += vmc96_motor_ping( vmc96bench_ctx );
+}
+
+
+static void vmc96bench_transaction_status( unsigned long long iterations )
+{
+	VMC96_motor_array_status_t status;
+
+	while( iterations-- )
+		vmc96bench_sink += vmc96_motor_get_status( vmc96bench_ctx, &status );
+}
+
+
+static void vmc96bench_cli_dispatch( unsigned long long iterations )
+{
+	char arg0[] = "vmc96cli";
+	char arg1[] = "--controller=MOTOR_ARRAY";
+	char arg2[] = "--command=RUN";
+	char arg3[] = "--row=2";
+	char arg4[] = "--column=3";
+	char * argv[] = { arg0, arg1, arg2, arg3, arg4, NULL };
+	vmc96cli_arguments_t args;
+
+	while( iterations-- )
+	{
+		optind = 1;
+
+		vmc96cli_proccess_arguments( 5, argv, &args );
+		vmc96bench_sink += vmc96cli_execute( vmc96bench_ctx, &args );
+	}
+}
+
+
+static vmc96bench_case_t vmc96bench_cases[] =
+{
+	{ "checksum_5B",               vmc96bench_checksum_small,      VMC96_K1_MESSAGE_MIN_LEN },
+	{ "checksum_255B",             vmc96bench_checksum_large,      VMC96_K1_MESSAGE_MAX_LEN },
+	{ "prepare_ping",              vmc96bench_prepare_ping,        VMC96_K1_MESSAGE_MIN_LEN },
+	{ "prepare_run_4_motors",      vmc96bench_prepare_run,         VMC96_K1_MESSAGE_MIN_LEN + 4 },
+	{ "prepare_run_1_motor",       vmc96bench_prepare_run_single,  VMC96_K1_MESSAGE_MIN_LEN + 1 },
+	{ "table_run_1_motor",         vmc96bench_table_run_single,    VMC96_K1_MESSAGE_MIN_LEN + 1 },
+	{ "parse_ack",                 vmc96bench_parse_ack,           VMC96_K1_MESSAGE_MIN_LEN },
+	{ "parse_status_4_motors",     vmc96bench_parse_status,        10 },
+	{ "parse_scan",                vmc96bench_parse_scan,          17 },
+	{ "decode_status_4_motors",    vmc96bench_decode_status,       10 },
+	{ "decode_opto_line",          vmc96bench_decode_opto,         9 },
+	{ "decode_scan",               vmc96bench_decode_scan,         17 },
+	{ "transaction_ping",          vmc96bench_transaction_ping,    2 * VMC96_K1_MESSAGE_MIN_LEN },
+	{ "transaction_status",        vmc96bench_transaction_status,  VMC96_K1_MESSAGE_MIN_LEN + 10 },
+	{ "cli_dispatch_run",          vmc96bench_cli_dispatch,        2 * VMC96_K1_MESSAGE_MIN_LEN + 1 },
+	{ NULL,                        NULL,                           0 }
+};
+
+
+/* ********************************************************************* */
+/* *                              HARNESS                              * */
+/* ********************************************************************* */
+
+static void vmc96bench_measure( const vmc96bench_case_t * bc, unsigned int min_time_ms, vmc96bench_result_t * result )
+{
+	unsigned long long iterations = 1;
+	unsigned long long start = 0;
+	unsigned long long elapsed = 0;
+	unsigned long long allocs = 0;
+
+	/* Calibrate: double the iterations until a run is long enough to time */
+	for( ;; )
+	{
+		start = vmc96_monotonic_ns();
+		bc->run( iterations );
+		elapsed = vmc96_monotonic_ns() - start;
+
+		if( elapsed >= VMC96BENCH_CALIBRATION_TIME_NS )
+			break;
+
+		iterations *= 2;
+	}
+
+	iterations = (unsigned long long)( (double) iterations * min_time_ms * 1000000.0 / elapsed ) + 1;
+
+	allocs = vmc96bench_allocs;
+	start = vmc96_monotonic_ns();
+	bc->run( iterations );
+	elapsed = vmc96_monotonic_ns() - start;
+	allocs = vmc96bench_allocs - allocs;
+
+	result->name = bc->name;
+	result->iterations = iterations;
+	result->ns_per_op = (double) elapsed / iterations;
+	result->ops_per_sec = iterations * 1e9 / elapsed;
+	result->mb_per_sec = result->ops_per_sec * bc->bytes_per_op / 1e6;
+	result->allocs_per_op = (double) allocs / iterations;
+	result->bytes_per_op = bc->bytes_per_op;
+}
+
+
+static int vmc96bench_write_results( const char * path, const vmc96bench_result_t * results, int count )
+{
+	FILE * fp = NULL;
+	int i = 0;
+
+	fp = fopen( path, "w" );
+
+	if( !fp )
+		return -1;
+
+	fprintf( fp, "{\n  \"timestamp\": %ld,\n", (long) time( NULL ) );
+	fprintf( fp, "  \"compiler\": \"%s\",\n", __VERSION__ );
+	fprintf( fp, "  \"benchmarks\": [\n" );
+
+	for( i = 0; i < count; i++ )
+	{
+		fprintf( fp, "    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, "
+			"\"bytes_per_op\": %u, \"mb_per_sec\": %.3f, \"allocs_per_op\": %.6f }%s\n",
+			results[i].name, results[i].iterations, results[i].ns_per_op, results[i].ops_per_sec,
+			results[i].bytes_per_op, results[i].mb_per_sec, results[i].allocs_per_op, ( i + 1 < count ) ? "," : "" );
+	}
+
+	fprintf( fp, "  ]\n}\n" );
+
+	return fclose( fp );
+}
+
+
+static void vmc96bench_show_usage( void )
+{
+	printf( "RUN ALL BENCHMARKS:\n\n" );
+	printf( "	vmc96bench [--output=vmc96bench.json] [--min-time-ms=250]\n\n" );
+	printf( "RUN BENCHMARKS WHOSE NAME CONTAINS A STRING:\n\n" );
+	printf( "	vmc96bench --filter=parse\n\n" );
+}
+
+
+/* ********************************************************************* */
+/* *                                MAIN                               * */
+/* ********************************************************************* */
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	int index = 0;
+	int count = 0;
+	int i = 0;
+	int devnull = -1;
+	int saved_stdout = -1;
+	unsigned int min_time_ms = VMC96BENCH_DEFAULT_MIN_TIME_MS;
+	const char * output = VMC96BENCH_DEFAULT_OUTPUT;
+	const char * filter = NULL;
+	vmc96bench_result_t results[ VMC96BENCH_MAX_RESULTS ];
+
+	static struct option options[] =
+	{
+		{ "output",      required_argument, 0,  'a' },
+		{ "filter",      required_argument, 0,  'b' },
+		{ "min-time-ms", required_argument, 0,  'c' },
+		{ "help",        no_argument,       0,  'd' },
+		{ NULL,          no_argument,       0,   0  }
+	};
+
+	while( (ret = getopt_long( argc, argv, "a:b:c:d", options, &index )) != -1 )
+	{
+		switch( ret )
+		{
+			case 'a' : output = optarg; break;
+			case 'b' : filter = optarg; break;
+			case 'c' : min_time_ms = atoi( optarg ); break;
+
+			case 'd' :
+			default :
+				vmc96bench_show_usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if( vmc96bench_setup() != 0 )
+	{
+		fprintf( stderr, "Error: Can not set up the benchmark fixtures.\n" );
+		return EXIT_FAILURE;
+	}
+
+	printf( "%-26s %14s %12s %14s %10s %12s\n", "BENCHMARK", "ITERATIONS", "NS/OP", "OPS/S", "MB/S", "ALLOCS/OP" );
+
+	for( i = 0; vmc96bench_cases[i].name; i++ )
+	{
+		if( filter && !strstr( vmc96bench_cases[i].name, filter ) )
+			continue;
+
+		/* The CLI prints command results: keep them out of the report */
+		fflush( stdout );
+		devnull = open( "/dev/null", O_WRONLY );
+		saved_stdout = dup( STDOUT_FILENO );
+		dup2( devnull, STDOUT_FILENO );
+
+		vmc96bench_measure( &vmc96bench_cases[i], min_time_ms, &results[count] );
+
+		fflush( stdout );
+		dup2( saved_stdout, STDOUT_FILENO );
+		close( saved_stdout );
+		close( devnull );
+
+		printf( "%-26s %14llu %12.2f %14.0f %10.2f %12.4f\n", results[count].name, results[count].iterations,
+			results[count].ns_per_op, results[count].ops_per_sec, results[count].mb_per_sec, results[count].allocs_per_op );
+
+		count++;
+	}
+
+	vmc96_finish( vmc96bench_ctx );
+
+	if( vmc96bench_write_results( output, results, count ) != 0 )
+	{
+		fprintf( stderr, "Error: Can not write results to '%s'.\n", output );
+		return EXIT_FAILURE;
+	}
+
+	printf( "\nResults written to '%s'.\n", output );
+
+	return EXIT_SUCCESS;
+}
+
+/* eof */
@@ -0,0 +1,72 @@
+/*!
+	\file board.cpp
+	\brief Example: C++ Wrapper With Compile-Time Frames
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "vmc96api.hpp"
+
+/* Bytes and checksum computed by the compiler */
+static constexpr auto vend_frame = vmc96::frames::motor_run_v<2, 5>;
+
+static_assert( vend_frame.bytes[4] == 0x36, "row 2, column 5" );
+
+int main( void )
+{
+	try
+	{
+		vmc96::board board;
+		unsigned char response[ VMC96_REQUEST_DATA_MAX_LEN ];
+
+		/* Hot path: the frame is only written */
+		board.send( vend_frame );
+
+		auto status = board.motor_get_status();
+		int running = 0;
+
+		for( auto cell : vmc96::cells( status.array ) )
+			running += cell ? 1 : 0;
+
+		fprintf( stdout, "Running: %d (%umA)\n", running, status.current_ma );
+
+		auto raw = board.send( vmc96::frames::motor_opto_line, response );
+
+		fprintf( stdout, "Opto-Sensor Response: %zu bytes\n", raw.size() );
+
+		board.motor_stop_all();
+	}
+	catch( const vmc96::error & e )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", e.what(), e.code() );
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* eof */
@@ -0,0 +1,93 @@
+/*!
+	\file pulse_train.c
+	\brief Example: Timed Relay and Motor Pulse Train
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vmc96api.h"
+
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	unsigned int i = 0;
+	VMC96_t * vmc96 = NULL;
+
+	VMC96_sequence_step_t steps[] =
+	{
+		/* offset_ms, action, id, row, col, duration_ms, result, sent_us */
+		{    0, VMC96_SEQUENCE_ACTION_RELAY_ON,       0, 0, 0, 0, 0, 0 },  /* Relay 0 On */
+		{  500, VMC96_SEQUENCE_ACTION_MOTOR_RUN,      0, 0, 0, 0, 0, 0 },  /* Motor (0,0) Start */
+		{ 1000, VMC96_SEQUENCE_ACTION_RELAY_OFF,      0, 0, 0, 0, 0, 0 },  /* Relay 0 Off */
+		{ 1300, VMC96_SEQUENCE_ACTION_MOTOR_STOP_ALL, 0, 0, 0, 0, 0, 0 },  /* 800ms Motor Pulse */
+		{ 1500, VMC96_SEQUENCE_ACTION_MOTOR_PULSE,    0, 0, 1, 200, 0, 0 } /* 200ms Motor (0,1) Pulse */
+	};
+
+	unsigned int count = sizeof(steps) / sizeof(steps[0]);
+
+	ret = vmc96_initialize( &vmc96 );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+		return EXIT_FAILURE;
+	}
+
+	/* Start the pulse train in background */
+	ret = vmc96_sequence_start( vmc96, steps, count );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	/* ... the application thread is free here ... */
+
+	/* Wait for the last step */
+	ret = vmc96_sequence_wait( vmc96 );
+
+	/* Display when each frame was actually sent */
+	for( i = 0; i < count; i++ )
+		fprintf( stdout, "Step %u: +%ums sent at +%.03fms (%s)\n", i, steps[i].offset_ms,
+			(steps[i].sent_us - steps[0].sent_us) / 1000.0, vmc96_get_error_code_string( steps[i].result ) );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	vmc96_finish( vmc96 );
+
+	return EXIT_SUCCESS;
+
+error:
+
+	/* Display error details */
+	fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+
+	vmc96_finish( vmc96 );
+
+	return EXIT_FAILURE;
+}
+
+/* eof */
@@ -0,0 +1,105 @@
+/*!
+	\file relay_auto_off.c
+	\brief Example: Relay Auto-Off and Motor Maximum Runtime Using Timers
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vmc96api.h"
+
+void on_expired( VMC96_t * vmc96, unsigned int timer, const VMC96_sequence_step_t * action, void * userdata )
+{
+	fprintf( stdout, "%s: %s\n", (const char *) userdata, vmc96_get_error_code_string( action->result ) );
+}
+
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	unsigned int stop_timer = 0;
+	VMC96_t * vmc96 = NULL;
+	VMC96_sequence_step_t relay_off = { 0, VMC96_SEQUENCE_ACTION_RELAY_OFF, 0, 0, 0, 0, 0, 0 };    /* Relay 0 Off */
+	VMC96_sequence_step_t stop_all = { 0, VMC96_SEQUENCE_ACTION_MOTOR_STOP_ALL, 0, 0, 0, 0, 0, 0 }; /* Stop All Motors */
+
+	ret = vmc96_initialize( &vmc96 );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+		return EXIT_FAILURE;
+	}
+
+	/* Enable Relay, it will be disabled automatically after 1 second */
+	ret = vmc96_relay_control( vmc96, 0, 1 );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	ret = vmc96_timer_schedule( vmc96, 1000, &relay_off, on_expired, "Relay Auto-Off", NULL );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	/* Run Motor, it will be stopped after a maximum runtime of 3 seconds */
+	ret = vmc96_motor_run( vmc96, 0, 0 );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	ret = vmc96_timer_schedule( vmc96, 3000, &stop_all, on_expired, "Motor Maximum Runtime", &stop_timer );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	/* The application would cancel the safety stop when the vend completes in time */
+	sleep( 2 );
+
+	ret = vmc96_timer_cancel( vmc96, stop_timer );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	ret = vmc96_motor_stop_all( vmc96 );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	vmc96_finish( vmc96 );
+
+	return EXIT_SUCCESS;
+
+error:
+
+	/* Display error details */
+	fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+
+	vmc96_finish( vmc96 );
+
+	return EXIT_FAILURE;
+}
+
+/* eof */
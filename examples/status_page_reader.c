@@ -0,0 +1,98 @@
+/*!
+	\file status_page_reader.c
+	\brief Example: Read the Board State Published by Another Process (No Board Access)
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vmc96api.h"
+
+int main( int argc, char ** argv )
+{
+	int i = 0;
+	int row = 0;
+	int col = 0;
+	int ret = 0;
+	const char * name = ( argc > 1 ) ? argv[1] : "/vmc96-0";
+	const VMC96_status_page_t * page = NULL;
+	VMC96_status_page_t snapshot;
+
+	/* Publisher: vmc96cli --watch=10 --publish=/vmc96-0 */
+	ret = vmc96_status_page_open( name, &page );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	ret = vmc96_status_page_read( page, &snapshot );
+
+	if( ret != VMC96_SUCCESS )
+		goto error;
+
+	fprintf( stdout, "STATUS PAGE %s (PUBLISHER PID %d, SEQUENCE %u):\n\n", name, snapshot.publisher_pid, snapshot.sequence );
+
+	if( snapshot.valid & (1 << VMC96_STATUS_PAGE_MOTOR_STATUS) )
+	{
+		fprintf( stdout, "	Active Motors: %d\n", snapshot.motor_status.active_count );
+		fprintf( stdout, "	Current: %dmA\n", snapshot.motor_status.current_ma );
+
+		for( row = 0; row < VMC96_MOTOR_ARRAY_ROWS_COUNT; row++ )
+			for( col = 0; col < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; col++ )
+				if( snapshot.motor_status.array.motor[row][col] )
+					fprintf( stdout, "	Running: row=%d col=%d\n", row, col );
+	}
+
+	if( snapshot.valid & (1 << VMC96_STATUS_PAGE_SCAN) )
+		fprintf( stdout, "	Installed Motors: %d\n", snapshot.scan.count );
+
+	if( snapshot.valid & (1 << VMC96_STATUS_PAGE_OPTO_LINE) )
+	{
+		fprintf( stdout, "	Opto-Sensor: " );
+
+		for( i = 0; i < VMC96_OPTO_LINE_SAMPLES_PER_BLOCK; i++ )
+			fprintf( stdout, "%c",  ( snapshot.opto_line.sample[i] ) ? '-' : '_'  );
+
+		fprintf( stdout, "\n" );
+	}
+
+	for( i = 0; i < 2; i++ )
+		if( snapshot.valid & (1 << (VMC96_STATUS_PAGE_RELAY1 + i)) )
+			fprintf( stdout, "	Relay %d: %s\n", i + 1, snapshot.relay_state[i] ? "ON" : "OFF" );
+
+	fprintf( stdout, "\n" );
+
+	vmc96_status_page_close( page );
+	return EXIT_SUCCESS;
+
+error:
+
+	/* Display error details */
+	fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+	vmc96_status_page_close( page );
+	return EXIT_FAILURE;
+}
+
+/* eof */
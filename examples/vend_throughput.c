@@ -0,0 +1,458 @@
+/*!
+	\file vend_throughput.c
+	\brief Example: End-to-End Vend Throughput Benchmark Against a Simulated Board
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/*
+	Runs the basic_vending.c cycle (reset, run, opto line poll, stop) against
+	a board simulated in-process through vmc96_initialize_transport(). The
+	simulated board models the serial wire (10 bits per byte), its own
+	turnaround, the motor spin time and the product drop latency, so the
+	time the host spends on top of the inherent wire and motor time can be
+	read off the per-phase breakdown.
+
+	Example (fast host overhead run):
+
+		vend_throughput --cycles=2000 --spin-ms=60 --drop-ms=40 --poll-ms=5
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "vmc96api.h"
+
+#define PHASE_RESET      (0)
+#define PHASE_RUN        (1)
+#define PHASE_DETECT     (2)
+#define PHASE_STOP       (3)
+#define PHASE_CYCLE      (4)
+#define PHASES_COUNT     (5)
+
+#define VEND_ERROR       (-2)
+#define VEND_TIMEOUT     (-1)
+#define VEND_OK          (0)
+
+#define K1_STX                      (0x35)
+#define K1_CONTROLLER_MOTOR_ARRAY   (0x30)
+#define K1_COMMAND_MOTOR_RESET      (0x05)
+#define K1_COMMAND_MOTOR_STOP_ALL   (0x12)
+#define K1_COMMAND_MOTOR_RUN        (0x13)
+#define K1_COMMAND_MOTOR_OPTO_LINE  (0x15)
+
+#define K1_FRAME_LEN_OPTO_REQUEST         (5)
+#define K1_FRAME_LEN_OPTO_RESPONSE        (9)
+
+
+typedef struct sim_board_s sim_board_t;
+
+struct sim_board_s
+{
+	unsigned int baud;
+	unsigned long long turnaround_us;   /* Board processing time before answering */
+	unsigned long long spin_us;         /* Motor runs this long, then stops by itself */
+	unsigned long long drop_us;         /* Product crosses the opto line this long after the motor starts */
+	unsigned long long motor_start_us;  /* 0 if idle */
+	unsigned long long drop_at_us;      /* 0 if nothing dropped since the last reset */
+	unsigned char response[ 16 ];
+	int response_length;
+	unsigned long long ready_at_us;     /* Last response byte on the wire */
+	unsigned long long wire_us;         /* Modeled wire + turnaround time (accumulated) */
+};
+
+
+static const char * phase_names[ PHASES_COUNT ] = { "reset", "run", "detect", "stop", "cycle" };
+
+
+static unsigned long long now_us( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ((unsigned long long) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+
+static unsigned long long sim_bytes_us( sim_board_t * sim, int bytes )
+{
+	return (unsigned long long) bytes * 10ULL * 1000000ULL / sim->baud;
+}
+
+
+static void sim_answer( sim_board_t * sim, const unsigned char * data, int length )
+{
+	int i = 0;
+
+	sim->response[0] = K1_STX;
+	sim->response[1] = K1_CONTROLLER_MOTOR_ARRAY;
+	sim->response[2] = length + 4;
+	memcpy( sim->response + 3, data, length );
+	sim->response[ length + 3 ] = 0;
+
+	for( i = 0; i < length + 3; i++ )
+		sim->response[ length + 3 ] ^= sim->response[i];
+
+	sim->response_length = length + 4;
+}
+
+
+static int sim_purge( void * userdata )
+{
+	((sim_board_t*) userdata)->response_length = 0;
+	return 0;
+}
+
+
+static int sim_write( void * userdata, const unsigned char * buf, int len )
+{
+	sim_board_t * sim = (sim_board_t*) userdata;
+	unsigned long long received = now_us() + sim_bytes_us( sim, len );
+	unsigned char ack[] = { 0x00 };
+	unsigned char opto[] = { K1_COMMAND_MOTOR_OPTO_LINE, 0x00, 0x00, 0x00, 0x00 };
+	unsigned long long age = 0;
+	int sample = 0;
+
+	/* Motor stops by itself after one spin; the product drops during the spin */
+	if( sim->motor_start_us && (received >= sim->motor_start_us + sim->spin_us) )
+		sim->motor_start_us = 0;
+
+	switch( buf[3] )
+	{
+		case K1_COMMAND_MOTOR_RESET:
+			sim->motor_start_us = 0;
+			sim->drop_at_us = 0;
+			sim_answer( sim, ack, sizeof(ack) );
+			break;
+
+		case K1_COMMAND_MOTOR_RUN:
+			sim->motor_start_us = received;
+			sim->drop_at_us = ( sim->drop_us < sim->spin_us ) ? received + sim->drop_us : 0;
+			sim_answer( sim, ack, sizeof(ack) );
+			break;
+
+		case K1_COMMAND_MOTOR_STOP_ALL:
+			sim->motor_start_us = 0;
+			sim_answer( sim, ack, sizeof(ack) );
+			break;
+
+		case K1_COMMAND_MOTOR_OPTO_LINE:
+			/* 32 samples of 40ms, sample 0 is the most recent */
+			if( sim->drop_at_us && (received >= sim->drop_at_us) )
+			{
+				age = received - sim->drop_at_us;
+				sample = age / (VMC96_OPTO_LINE_SAMPLE_LENGTH_MS * 1000ULL);
+
+				if( sample < VMC96_OPTO_LINE_SAMPLES_PER_BLOCK )
+					opto[ 1 + sample / 8 ] |= 1 << (sample % 8);
+			}
+
+			sim_answer( sim, opto, sizeof(opto) );
+			break;
+
+		default:
+			sim_answer( sim, ack, sizeof(ack) );
+			break;
+	}
+
+	sim->ready_at_us = received + sim->turnaround_us + sim_bytes_us( sim, sim->response_length );
+	sim->wire_us += sim->ready_at_us - (received - sim_bytes_us( sim, len ));
+
+	return len;
+}
+
+
+static int sim_read( void * userdata, unsigned char * buf, int len )
+{
+	sim_board_t * sim = (sim_board_t*) userdata;
+	int n = sim->response_length;
+
+	/* Like the FTDI chip: nothing until the bytes went through the wire */
+	if( !n || (now_us() < sim->ready_at_us) )
+		return 0;
+
+	if( n > len )
+		n = len;
+
+	memcpy( buf, sim->response, n );
+	sim->response_length = 0;
+
+	return n;
+}
+
+
+static int cmp_ull( const void * a, const void * b )
+{
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return ( x > y ) - ( x < y );
+}
+
+
+int vend( VMC96_t * vmc96, sim_board_t * sim, unsigned int poll_ms, unsigned long long * wall, unsigned long long * wire )
+{
+	int ret = 0;
+	int i = 0;
+	int detected = 0;
+	unsigned long long t = 0;
+	unsigned long long w = 0;
+	unsigned long long deadline = 0;
+	VMC96_opto_line_sample_block_t opto_line;
+
+	t = now_us(); w = sim->wire_us;
+
+	ret = vmc96_motor_reset( vmc96 );
+
+	wall[ PHASE_RESET ] = now_us() - t; wire[ PHASE_RESET ] = sim->wire_us - w;
+
+	if( ret != VMC96_SUCCESS )
+		return VEND_ERROR;
+
+	t = now_us(); w = sim->wire_us;
+
+	ret = vmc96_motor_run( vmc96, 0, 0 );
+
+	wall[ PHASE_RUN ] = now_us() - t; wire[ PHASE_RUN ] = sim->wire_us - w;
+
+	if( ret != VMC96_SUCCESS )
+		return VEND_ERROR;
+
+	/* Poll the opto line until the product drops or the motor spin is over */
+	t = now_us(); w = sim->wire_us;
+	deadline = t + sim->spin_us + VMC96_OPTO_LINE_SAMPLE_LENGTH_MS * 1000ULL;
+	ret = VEND_TIMEOUT;
+
+	while( now_us() < deadline )
+	{
+		if( vmc96_motor_opto_line_status( vmc96, &opto_line ) != VMC96_SUCCESS )
+		{
+			ret = VEND_ERROR;
+			break;
+		}
+
+		for( i = 0, detected = 0; i < VMC96_OPTO_LINE_SAMPLES_PER_BLOCK; i++ )
+			detected |= opto_line.sample[i];
+
+		if( detected )
+		{
+			ret = VEND_OK;
+			break;
+		}
+
+		usleep( poll_ms * 1000L );
+	}
+
+	wall[ PHASE_DETECT ] = now_us() - t; wire[ PHASE_DETECT ] = sim->wire_us - w;
+
+	t = now_us(); w = sim->wire_us;
+
+	vmc96_motor_stop_all( vmc96 );
+
+	wall[ PHASE_STOP ] = now_us() - t; wire[ PHASE_STOP ] = sim->wire_us - w;
+
+	return ret;
+}
+
+
+static void show_usage( void )
+{
+	printf( "vend_throughput [--cycles=N] [--baud=19200] [--turnaround-us=1000] [--spin-ms=1200]\n" );
+	printf( "                [--drop-ms=900] [--poll-ms=40] [--read-delay-ms=10] [--adaptive]\n\n" );
+}
+
+
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	int index = 0;
+	int adaptive = 0;
+	unsigned int cycles = 1000;
+	unsigned int poll_ms = VMC96_OPTO_LINE_SAMPLE_LENGTH_MS;
+	unsigned int read_delay_ms = 10;
+	unsigned int c = 0;
+	unsigned int p = 0;
+	unsigned int ok = 0;
+	unsigned int timeouts = 0;
+	unsigned int errors = 0;
+	unsigned long long start = 0;
+	unsigned long long elapsed = 0;
+	unsigned long long inherent = 0;
+	unsigned long long t = 0;
+	unsigned long long sum_wall = 0;
+	unsigned long long sum_wire = 0;
+	unsigned long long * wall = NULL;
+	unsigned long long * wire = NULL;
+	sim_board_t sim;
+	VMC96_transport_t transport;
+	VMC96_timeout_policy_t policy = { VMC96_TIMEOUT_MODE_ADAPTIVE, 99.9, 2.0, 5, 32 };
+	VMC96_t * vmc96 = NULL;
+
+	static struct option options[] =
+	{
+		{ "cycles",        required_argument, 0,  'a' },
+		{ "baud",          required_argument, 0,  'b' },
+		{ "turnaround-us", required_argument, 0,  'c' },
+		{ "spin-ms",       required_argument, 0,  'd' },
+		{ "drop-ms",       required_argument, 0,  'e' },
+		{ "poll-ms",       required_argument, 0,  'f' },
+		{ "read-delay-ms", required_argument, 0,  'g' },
+		{ "adaptive",      no_argument,       0,  'h' },
+		{ "help",          no_argument,       0,  'i' },
+		{ NULL,            no_argument,       0,   0  }
+	};
+
+	memset( &sim, 0, sizeof(sim) );
+	sim.baud = 19200;
+	sim.turnaround_us = 1000;
+	sim.spin_us = 1200000;
+	sim.drop_us = 900000;
+
+	while( (ret = getopt_long( argc, argv, "a:b:c:d:e:f:g:hi", options, &index )) != -1 )
+	{
+		switch( ret )
+		{
+			case 'a' : cycles = atoi( optarg ); break;
+			case 'b' : sim.baud = atoi( optarg ); break;
+			case 'c' : sim.turnaround_us = atoi( optarg ); break;
+			case 'd' : sim.spin_us = atoi( optarg ) * 1000ULL; break;
+			case 'e' : sim.drop_us = atoi( optarg ) * 1000ULL; break;
+			case 'f' : poll_ms = atoi( optarg ); break;
+			case 'g' : read_delay_ms = atoi( optarg ); break;
+			case 'h' : adaptive = 1; break;
+
+			default :
+				show_usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if( !cycles || !sim.baud )
+	{
+		show_usage();
+		return EXIT_FAILURE;
+	}
+
+	wall = (unsigned long long*) calloc( PHASES_COUNT * cycles, sizeof(unsigned long long) );
+	wire = (unsigned long long*) calloc( PHASES_COUNT * cycles, sizeof(unsigned long long) );
+
+	if( !wall || !wire )
+	{
+		fprintf( stderr, "Error: Out of memory.\n" );
+		return EXIT_FAILURE;
+	}
+
+	memset( &transport, 0, sizeof(transport) );
+	transport.purge = sim_purge;
+	transport.write = sim_write;
+	transport.read = sim_read;
+	transport.read_delay_ms = read_delay_ms;
+	transport.userdata = &sim;
+
+	ret = vmc96_initialize_transport( &vmc96, &transport );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+		return EXIT_FAILURE;
+	}
+
+	if( adaptive )
+		vmc96_set_timeout_policy( vmc96, &policy );
+
+	start = now_us();
+
+	for( c = 0; c < cycles; c++ )
+	{
+		t = now_us();
+
+		ret = vend( vmc96, &sim, poll_ms, &wall[ c * PHASES_COUNT ], &wire[ c * PHASES_COUNT ] );
+
+		wall[ c * PHASES_COUNT + PHASE_CYCLE ] = now_us() - t;
+		wire[ c * PHASES_COUNT + PHASE_CYCLE ] = wire[ c * PHASES_COUNT + PHASE_RESET ] + wire[ c * PHASES_COUNT + PHASE_RUN ] +
+			wire[ c * PHASES_COUNT + PHASE_DETECT ] + wire[ c * PHASES_COUNT + PHASE_STOP ];
+
+		switch( ret )
+		{
+			case VEND_OK      : ok++; break;
+			case VEND_TIMEOUT : timeouts++; break;
+			default           : errors++; break;
+		}
+	}
+
+	elapsed = now_us() - start;
+
+	vmc96_finish( vmc96 );
+
+	printf( "Simulated board: %u baud, turnaround %llu us, spin %llu ms, drop %llu ms\n", sim.baud, sim.turnaround_us, sim.spin_us / 1000, sim.drop_us / 1000 );
+	printf( "Host: opto poll every %u ms, read delay %u ms, %s timeouts\n", poll_ms, read_delay_ms, adaptive ? "adaptive" : "fixed" );
+	printf( "Cycles: %u (ok %u, timeout %u, error %u) in %.2f s\n", cycles, ok, timeouts, errors, elapsed / 1e6 );
+	printf( "Throughput: %.0f vends/hour\n\n", ok * 3600e6 / elapsed );
+
+	printf( "%-8s %10s %10s %10s %10s %10s\n", "PHASE", "MEAN(ms)", "P50(ms)", "P99(ms)", "WIRE(ms)", "HOST(ms)" );
+
+	for( p = 0; p < PHASES_COUNT; p++ )
+	{
+		unsigned long long * samples = (unsigned long long*) malloc( cycles * sizeof(unsigned long long) );
+
+		sum_wall = 0;
+		sum_wire = 0;
+
+		for( c = 0; c < cycles; c++ )
+		{
+			samples[c] = wall[ c * PHASES_COUNT + p ];
+			sum_wall += wall[ c * PHASES_COUNT + p ];
+			sum_wire += wire[ c * PHASES_COUNT + p ];
+		}
+
+		qsort( samples, cycles, sizeof(unsigned long long), cmp_ull );
+
+		/* Detection also waits for the product by design: only the other phases are pure overhead */
+		printf( "%-8s %10.3f %10.3f %10.3f %10.3f %10.3f\n", phase_names[p],
+			sum_wall / 1e3 / cycles, samples[ cycles / 2 ] / 1e3, samples[ (cycles * 99) / 100 ] / 1e3,
+			sum_wire / 1e3 / cycles, ( sum_wall - sum_wire ) / 1e3 / cycles );
+
+		if( (p != PHASE_DETECT) && (p != PHASE_CYCLE) )
+			inherent += sum_wire / cycles;
+
+		free( samples );
+	}
+
+	/* Best case: one opto poll right after the drop, no host overhead */
+	inherent += sim_bytes_us( &sim, K1_FRAME_LEN_OPTO_REQUEST ) + sim.turnaround_us + sim_bytes_us( &sim, K1_FRAME_LEN_OPTO_RESPONSE );
+	inherent += sim.drop_us;
+
+	printf( "\nInherent (wire + drop latency): %.3f ms/vend, %.0f vends/hour\n", inherent / 1e3, 3600e6 / inherent );
+
+	free( wall );
+	free( wire );
+
+	return EXIT_SUCCESS;
+}
+
+/* eof */
@@ -0,0 +1,979 @@
+/*!
+	\file vmc96analyze.c
+	\brief VMC96 Offline K1 Log Analyzer
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/*
+	Two input formats are accepted, detected per file:
+
+	- Capture files written by vmc96_capture_start(): requests and responses
+	  are paired, so error rates, response latency and idle gaps are known.
+	- Raw K1 byte logs: frames are found by STX/length and validated by their
+	  checksum; bytes that do not belong to a valid frame are counted as junk.
+	  A frame that follows a request from the same controller is its response
+	  (a NAK counts as an error), a request followed by a frame from another
+	  controller is counted as a timeout. Raw logs have no timestamps.
+
+	Files are memory-mapped and split into one chunk per thread. Raw chunks
+	start on the first run of chained valid frames and end where the next
+	chunk starts, so every byte is counted once. A chunk does not know if its
+	first frame answers the last request of the previous chunk: it is paired
+	both ways until the two agree, and the right way is kept on merge.
+
+	Capture records have no sync marker either: a capture chunk starts on the
+	first request answered by a response, both well formed and followed by
+	chained records. Its clock starts at zero, and the idle gap before its
+	first request is linked on merge. The walk of each chunk must stop right
+	where the next one starts; if a guess was wrong the file is walked again
+	on one thread.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vmc96api.h"
+
+
+/* ********************************************************************* */
+/* *                              DEFINES                              * */
+/* ********************************************************************* */
+
+#define VMC96ANALYZE_SUCCESS                              (0)
+#define VMC96ANALYZE_ERROR_INVALID_ARGS                   (-1)
+#define VMC96ANALYZE_ERROR_OPEN_FILE                      (-2)
+#define VMC96ANALYZE_ERROR_INVALID_FILE                   (-3)
+#define VMC96ANALYZE_ERROR_OUT_OF_MEMORY                  (-4)
+#define VMC96ANALYZE_ERROR_THREAD                         (-5)
+
+#define VMC96ANALYZE_K1_STX                               (0x35)
+#define VMC96ANALYZE_K1_MIN_LEN                           (5)
+#define VMC96ANALYZE_K1_POSITIVE_ACK                      (0x00)
+#define VMC96ANALYZE_MAX_THREADS                          (256)
+#define VMC96ANALYZE_SYNC_CHAIN                           (3)      /* Valid frames (or records) in a row to trust a chunk start */
+#define VMC96ANALYZE_LATENCY_BUCKETS                      (32)     /* Power of two microseconds */
+#define VMC96ANALYZE_CONTROLLERS                          (5)      /* Global, relay 1, relay 2, motor array, other */
+#define VMC96ANALYZE_CONTROLLER_OTHER                     (4)
+#define VMC96ANALYZE_RAW_PATHS                            (2)      /* First frame of a raw chunk: a request, or a response */
+#define VMC96ANALYZE_RAW_PATH_REQUEST                     (0)
+#define VMC96ANALYZE_RAW_PATH_RESPONSE                    (1)
+
+
+/* ********************************************************************* */
+/* *                        STRUCTS AND DATA TYPES                     * */
+/* ********************************************************************* */
+
+typedef struct vmc96analyze_latency_s vmc96analyze_latency_t;
+typedef struct vmc96analyze_pair_s vmc96analyze_pair_t;
+typedef struct vmc96analyze_raw_state_s vmc96analyze_raw_state_t;
+typedef struct vmc96analyze_raw_count_s vmc96analyze_raw_count_t;
+typedef struct vmc96analyze_raw_path_s vmc96analyze_raw_path_t;
+typedef struct vmc96analyze_capture_state_s vmc96analyze_capture_state_t;
+typedef struct vmc96analyze_totals_s vmc96analyze_totals_t;
+typedef struct vmc96analyze_chunk_s vmc96analyze_chunk_t;
+
+struct vmc96analyze_latency_s
+{
+	unsigned long long count;
+	unsigned long long sum_us;
+	unsigned long long max_us;
+	unsigned long long bucket[ VMC96ANALYZE_LATENCY_BUCKETS ];
+};
+
+/* Per controller/command counters */
+struct vmc96analyze_pair_s
+{
+	unsigned long long frames;
+	unsigned long long bytes;
+	unsigned long long checksum_errors;
+	unsigned long long responses;
+	unsigned long long timeouts;
+	unsigned long long errors;
+	vmc96analyze_latency_t latency;
+};
+
+/* Raw log: the request waiting for its response */
+struct vmc96analyze_raw_state_s
+{
+	int pending;
+	unsigned char controller;
+	unsigned char command;
+};
+
+/* Raw log per controller/command counters (no checksum errors nor latency) */
+struct vmc96analyze_raw_count_s
+{
+	unsigned long long frames;
+	unsigned long long bytes;
+	unsigned long long responses;
+	unsigned long long errors;
+	unsigned long long timeouts;
+};
+
+/* Raw chunk pairing under one guess about its first frame */
+struct vmc96analyze_raw_path_s
+{
+	vmc96analyze_raw_state_t state;
+	vmc96analyze_raw_count_t count[ VMC96ANALYZE_CONTROLLERS ][ 256 ];
+};
+
+/* Capture: the last response before a chunk */
+struct vmc96analyze_capture_state_s
+{
+	int responded;
+	unsigned long long since_rx_us;       /* Time from the last response to the chunk start */
+};
+
+struct vmc96analyze_totals_s
+{
+	unsigned long long bytes;
+	unsigned long long frames;
+	unsigned long long junk_bytes;
+	unsigned long long rejected;          /* STX candidates with a bad checksum or length */
+	unsigned long long malformed;         /* Captured frames that are not valid K1 frames */
+	vmc96analyze_latency_t gap;           /* Idle time between a response and the next request */
+};
+
+struct vmc96analyze_chunk_s
+{
+	pthread_t thread;
+	int capture;
+	const unsigned char * file_start;
+	const unsigned char * file_end;
+	const unsigned char * start;
+	const unsigned char * end;
+	unsigned long long time_us;           /* Capture: time since the chunk start */
+	unsigned long long last_tx_us;        /* Capture: time of the last request */
+	unsigned long long last_rx_us;        /* Capture: time of the last response */
+	unsigned long long head_tx_us;        /* Capture: time of the first request, if sent before any response */
+	int head_tx;
+	int responded;                        /* Capture: a response was seen in the chunk */
+	int truncated;                        /* Capture: the last record runs past the end of the file */
+	int last_controller;                  /* Capture: last request in the chunk (-1 if none) */
+	int last_command;
+	const unsigned char * stop;           /* Capture: record boundary where the walk stopped */
+	const unsigned char * sync;           /* First run of chained valid frames or records in the chunk (NULL if none) */
+	int head_controller;                  /* Raw: controller of the first frame (-1 if the chunk has none) */
+	unsigned char head_code;              /* Raw: first frame command or ACK code */
+	unsigned char head_length;
+	int converged;                        /* Raw: both paths agree, pairing goes on in path[ REQUEST ].state and count */
+	vmc96analyze_raw_path_t path[ VMC96ANALYZE_RAW_PATHS ];
+	vmc96analyze_raw_count_t count[ VMC96ANALYZE_CONTROLLERS ][ 256 ];
+	vmc96analyze_totals_t totals;
+	vmc96analyze_pair_t pair[ VMC96ANALYZE_CONTROLLERS ][ 256 ];
+};
+
+
+/* ********************************************************************* */
+/* *                             PROTOTYPES                            * */
+/* ********************************************************************* */
+
+static const char * vmc96analyze_get_error_code_string( int cod );
+static void vmc96analyze_show_usage( void );
+static unsigned char vmc96analyze_xor( const unsigned char * buf, size_t len );
+static int vmc96analyze_controller_index( unsigned char id );
+static void vmc96analyze_latency_record( vmc96analyze_latency_t * h, unsigned long long us );
+static unsigned long long vmc96analyze_latency_percentile( const vmc96analyze_latency_t * h, double percentile );
+static int vmc96analyze_raw_frame_valid( const unsigned char * p, const unsigned char * file_end );
+static void vmc96analyze_raw_response( vmc96analyze_raw_count_t * n, const vmc96analyze_raw_state_t * s, unsigned char length, unsigned char code );
+static void vmc96analyze_raw_pair( vmc96analyze_raw_state_t * s, vmc96analyze_raw_count_t count[][ 256 ], const unsigned char * q );
+static void * vmc96analyze_raw_sync_thread( void * arg );
+static void * vmc96analyze_raw_thread( void * arg );
+static int vmc96analyze_capture_record_valid( const VMC96_capture_record_t * record, const unsigned char * f, const unsigned char * file_end );
+static void * vmc96analyze_capture_sync_thread( void * arg );
+static void * vmc96analyze_capture_thread( void * arg );
+static int vmc96analyze_run( vmc96analyze_chunk_t * chunks, int threads, void * (*routine)( void * ) );
+static int vmc96analyze_file( const char * path, int threads, vmc96analyze_chunk_t * chunks, vmc96analyze_chunk_t * result );
+static void vmc96analyze_merge( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src );
+static void vmc96analyze_raw_merge( vmc96analyze_chunk_t * dst, const vmc96analyze_raw_count_t count[][ 256 ] );
+static void vmc96analyze_raw_link( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src, vmc96analyze_raw_state_t * entry );
+static void vmc96analyze_capture_link( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src, vmc96analyze_capture_state_t * entry );
+static void vmc96analyze_report( const vmc96analyze_chunk_t * r, double elapsed );
+
+
+/* ********************************************************************* */
+/* *                          IMPLEMENTATION                           * */
+/* ********************************************************************* */
+
+static const char * vmc96analyze_get_error_code_string( int cod )
+{
+	switch(cod)
+	{
+		case VMC96ANALYZE_SUCCESS                 : return "Success."; break;
+		case VMC96ANALYZE_ERROR_INVALID_ARGS      : return "Invalid arguments."; break;
+		case VMC96ANALYZE_ERROR_OPEN_FILE         : return "Can not map log file."; break;
+		case VMC96ANALYZE_ERROR_INVALID_FILE      : return "Invalid or truncated capture file."; break;
+		case VMC96ANALYZE_ERROR_OUT_OF_MEMORY     : return "Out of memory."; break;
+		case VMC96ANALYZE_ERROR_THREAD            : return "Can not start worker thread."; break;
+		default                                   : return "Unknown error."; break;
+	}
+}
+
+
+static void vmc96analyze_show_usage( void )
+{
+	printf( "ANALYZE CAPTURE FILES AND/OR RAW K1 BYTE LOGS:\n\n" );
+	printf( "	vmc96analyze [--threads=N] log1.bin [log2.bin ...]\n\n" );
+}
+
+
+static unsigned char vmc96analyze_xor( const unsigned char * buf, size_t len )
+{
+	unsigned char sum = 0;
+
+	/* K1 frames are 5 to a few tens of bytes: a plain loop, the scan is bound by memchr() and memory */
+	while( len-- )
+		sum ^= *buf++;
+
+	return sum;
+}
+
+
+static int vmc96analyze_controller_index( unsigned char id )
+{
+	switch( id )
+	{
+		case 0x00 : return 0;
+		case 0x26 : return 1;
+		case 0x27 : return 2;
+		case 0x30 : return 3;
+		default   : return VMC96ANALYZE_CONTROLLER_OTHER;
+	}
+}
+
+
+static void vmc96analyze_latency_record( vmc96analyze_latency_t * h, unsigned long long us )
+{
+	int bucket = ( us > 0 ) ? 64 - __builtin_clzll( us ) : 0;
+
+	if( bucket >= VMC96ANALYZE_LATENCY_BUCKETS )
+		bucket = VMC96ANALYZE_LATENCY_BUCKETS - 1;
+
+	h->bucket[ bucket ]++;
+	h->count++;
+	h->sum_us += us;
+
+	if( us > h->max_us )
+		h->max_us = us;
+}
+
+
+static unsigned long long vmc96analyze_latency_percentile( const vmc96analyze_latency_t * h, double percentile )
+{
+	unsigned long long target = (unsigned long long)( h->count * percentile / 100.0 + 0.5 );
+	unsigned long long sum = 0;
+	int i = 0;
+
+	for( i = 0; i < VMC96ANALYZE_LATENCY_BUCKETS; i++ )
+	{
+		sum += h->bucket[i];
+
+		/* Upper limit of the power of two bucket, never above the observed maximum */
+		if( (sum >= target) && (sum > 0) )
+			return ( (1ULL << i) < h->max_us ) ? (1ULL << i) : h->max_us;
+	}
+
+	return h->max_us;
+}
+
+
+static int vmc96analyze_raw_frame_valid( const unsigned char * p, const unsigned char * file_end )
+{
+	if( (file_end - p < VMC96ANALYZE_K1_MIN_LEN) || (p[0] != VMC96ANALYZE_K1_STX) )
+		return 0;
+
+	if( (p[2] < VMC96ANALYZE_K1_MIN_LEN) || (p + p[2] > file_end) )
+		return 0;
+
+	/* The checksum is the XOR of the other bytes: the whole frame XORs to zero */
+	return vmc96analyze_xor( p, p[2] ) == 0;
+}
+
+
+static void vmc96analyze_raw_response( vmc96analyze_raw_count_t * n, const vmc96analyze_raw_state_t * s, unsigned char length, unsigned char code )
+{
+	n->responses++;
+	n->bytes += length;
+
+	/* ACK frame with a non-zero code (a data response echoes the command instead) */
+	if( (length == VMC96ANALYZE_K1_MIN_LEN) && (code != VMC96ANALYZE_K1_POSITIVE_ACK) && (code != s->command) )
+		n->errors++;
+}
+
+
+static void vmc96analyze_raw_pair( vmc96analyze_raw_state_t * s, vmc96analyze_raw_count_t count[][ 256 ], const unsigned char * q )
+{
+	vmc96analyze_raw_count_t * n = NULL;
+
+	/* The frame that follows a request from the same controller is its response */
+	if( s->pending && (s->controller == q[1]) )
+	{
+		vmc96analyze_raw_response( &count[ vmc96analyze_controller_index( s->controller ) ][ s->command ], s, q[2], q[3] );
+		s->pending = 0;
+		return;
+	}
+
+	/* Anything else is a new request: the pending one was never answered (counted as an empty response, like captures) */
+	if( s->pending )
+	{
+		n = &count[ vmc96analyze_controller_index( s->controller ) ][ s->command ];
+		n->responses++;
+		n->timeouts++;
+	}
+
+	n = &count[ vmc96analyze_controller_index( q[1] ) ][ q[3] ];
+	n->frames++;
+	n->bytes += q[2];
+
+	s->pending = 1;
+	s->controller = q[1];
+	s->command = q[3];
+}
+
+
+static void * vmc96analyze_raw_sync_thread( void * arg )
+{
+	vmc96analyze_chunk_t * c = (vmc96analyze_chunk_t*) arg;
+	const unsigned char * p = NULL;
+	const unsigned char * s = NULL;
+	int chain = 0;
+
+	/* Chunks may start mid-frame: find the first run of chained valid frames */
+	for( p = c->start; p < c->end; p++ )
+	{
+		for( s = p, chain = 0; (chain < VMC96ANALYZE_SYNC_CHAIN) && vmc96analyze_raw_frame_valid( s, c->file_end ); chain++ )
+			s += s[2];
+
+		if( (chain == VMC96ANALYZE_SYNC_CHAIN) || ((chain > 0) && (s >= c->file_end)) )
+		{
+			c->sync = p;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void * vmc96analyze_raw_thread( void * arg )
+{
+	vmc96analyze_chunk_t * c = (vmc96analyze_chunk_t*) arg;
+	vmc96analyze_raw_path_t * r = &c->path[ VMC96ANALYZE_RAW_PATH_REQUEST ];
+	vmc96analyze_raw_path_t * a = &c->path[ VMC96ANALYZE_RAW_PATH_RESPONSE ];
+	const unsigned char * p = c->start;
+	const unsigned char * q = NULL;
+
+	c->head_controller = -1;
+
+	while( p < c->end )
+	{
+		q = (const unsigned char *) memchr( p, VMC96ANALYZE_K1_STX, c->end - p );
+
+		if( !q )
+		{
+			c->totals.junk_bytes += c->end - p;
+			break;
+		}
+
+		c->totals.junk_bytes += q - p;
+
+		if( !vmc96analyze_raw_frame_valid( q, c->file_end ) )
+		{
+			c->totals.rejected++;
+			c->totals.junk_bytes++;
+			p = q + 1;
+			continue;
+		}
+
+		c->totals.frames++;
+		c->totals.bytes += q[2];
+
+		if( c->converged )
+		{
+			vmc96analyze_raw_pair( &r->state, c->count, q );
+		}
+		else if( c->head_controller < 0 )
+		{
+			/* In the response path the first frame is paired on merge, once the previous chunk is known */
+			c->head_controller = q[1];
+			c->head_code = q[3];
+			c->head_length = q[2];
+
+			vmc96analyze_raw_pair( &r->state, r->count, q );
+		}
+		else
+		{
+			vmc96analyze_raw_pair( &r->state, r->count, q );
+			vmc96analyze_raw_pair( &a->state, a->count, q );
+		}
+
+		/* Both idle, or both waiting for this same frame's response: the paths can no longer differ */
+		if( !c->converged && (r->state.pending == a->state.pending) && (!r->state.pending || (a->state.controller == q[1])) )
+			c->converged = 1;
+
+		/* A frame may end past the chunk: the next chunk starts after it */
+		p = q + q[2];
+	}
+
+	return NULL;
+}
+
+
+static int vmc96analyze_capture_record_valid( const VMC96_capture_record_t * record, const unsigned char * f, const unsigned char * file_end )
+{
+	if( f + record->length > file_end )
+		return 0;
+
+	if( record->direction == VMC96_TRACE_DIRECTION_RX )
+		return (record->length == 0) || (vmc96analyze_raw_frame_valid( f, f + record->length ) && (f[2] == record->length));
+
+	return (record->direction == VMC96_TRACE_DIRECTION_TX) && vmc96analyze_raw_frame_valid( f, f + record->length ) && (f[2] == record->length);
+}
+
+
+static void * vmc96analyze_capture_sync_thread( void * arg )
+{
+	vmc96analyze_chunk_t * c = (vmc96analyze_chunk_t*) arg;
+	const unsigned char * p = NULL;
+	const unsigned char * s = NULL;
+	VMC96_capture_record_t record;
+	int chain = 0;
+
+	/* Chunks may start mid-record: find a request and its response, both well formed, followed by chained records */
+	for( p = c->start; p < c->end; p++ )
+	{
+		for( s = p, chain = 0; (chain < VMC96ANALYZE_SYNC_CHAIN) && (s + sizeof(record) <= c->file_end); chain++ )
+		{
+			memcpy( &record, s, sizeof(record) );
+
+			if( !vmc96analyze_capture_record_valid( &record, s + sizeof(record), c->file_end ) )
+				break;
+
+			if( (chain < 2) && (record.direction != ( chain == 0 ? VMC96_TRACE_DIRECTION_TX : VMC96_TRACE_DIRECTION_RX )) )
+				break;
+
+			s += sizeof(record) + record.length;
+		}
+
+		if( (chain == VMC96ANALYZE_SYNC_CHAIN) || ((chain >= 2) && (s == c->file_end)) )
+		{
+			c->sync = p;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void * vmc96analyze_capture_thread( void * arg )
+{
+	vmc96analyze_chunk_t * c = (vmc96analyze_chunk_t*) arg;
+	const unsigned char * p = c->start;
+	const unsigned char * f = NULL;
+	VMC96_capture_record_t record;
+	vmc96analyze_pair_t * pair = NULL;
+	unsigned long long now = 0;
+
+	c->last_controller = -1;
+
+	/* A record may end past the chunk: the next chunk starts after it */
+	while( (p < c->end) && (p + sizeof(record) <= c->file_end) )
+	{
+		memcpy( &record, p, sizeof(record) );
+
+		f = p + sizeof(record);
+		p = f + record.length;
+		now += record.delta_us;
+
+		if( p > c->file_end )
+		{
+			c->truncated = 1;
+			break;
+		}
+
+		c->totals.bytes += record.length;
+
+		if( record.direction == VMC96_TRACE_DIRECTION_TX )
+		{
+			if( (record.length < VMC96ANALYZE_K1_MIN_LEN) || (f[0] != VMC96ANALYZE_K1_STX) || (f[2] != record.length) )
+			{
+				c->totals.malformed++;
+				c->last_controller = -1;
+				continue;
+			}
+
+			c->last_controller = f[1];
+			c->last_command = f[3];
+			c->last_tx_us = now;
+
+			pair = &c->pair[ vmc96analyze_controller_index( f[1] ) ][ f[3] ];
+			pair->frames++;
+			pair->bytes += record.length;
+
+			if( vmc96analyze_xor( f, record.length ) != 0 )
+				pair->checksum_errors++;
+
+			/* The gap before the first request depends on the previous chunks: linked on merge */
+			if( c->responded )
+				vmc96analyze_latency_record( &c->totals.gap, now - c->last_rx_us );
+			else if( !c->head_tx )
+			{
+				c->head_tx = 1;
+				c->head_tx_us = now;
+			}
+
+			c->totals.frames++;
+			continue;
+		}
+
+		c->responded = 1;
+		c->last_rx_us = now;
+
+		/* A response without its request (start of the capture) can not be classified */
+		if( c->last_controller < 0 )
+			continue;
+
+		pair = &c->pair[ vmc96analyze_controller_index( c->last_controller ) ][ c->last_command ];
+		pair->responses++;
+		pair->bytes += record.length;
+		c->totals.frames++;
+
+		if( record.length == 0 )
+			pair->timeouts++;
+		else
+			vmc96analyze_latency_record( &pair->latency, now - c->last_tx_us );
+
+		if( (record.length > 0) && (vmc96analyze_xor( f, record.length ) != 0) )
+			pair->checksum_errors++;
+
+		if( record.result != VMC96_SUCCESS )
+			pair->errors++;
+	}
+
+	c->stop = p;
+	c->time_us = now;
+
+	return NULL;
+}
+
+
+static int vmc96analyze_run( vmc96analyze_chunk_t * chunks, int threads, void * (*routine)( void * ) )
+{
+	int ret = VMC96ANALYZE_SUCCESS;
+	int i = 0;
+
+	for( i = 0; i < threads; i++ )
+	{
+		if( pthread_create( &chunks[i].thread, NULL, routine, &chunks[i] ) != 0 )
+		{
+			threads = i;
+			ret = VMC96ANALYZE_ERROR_THREAD;
+			break;
+		}
+	}
+
+	for( i = 0; i < threads; i++ )
+		pthread_join( chunks[i].thread, NULL );
+
+	return ret;
+}
+
+
+static int vmc96analyze_file( const char * path, int threads, vmc96analyze_chunk_t * chunks, vmc96analyze_chunk_t * result )
+{
+	int fd = -1;
+	int i = 0;
+	int capture = 0;
+	int ret = VMC96ANALYZE_SUCCESS;
+	struct stat st;
+	const unsigned char * map = NULL;
+	const unsigned char * end = NULL;
+	const unsigned char * p = NULL;
+	size_t chunk = 0;
+	vmc96analyze_raw_state_t entry;
+	vmc96analyze_capture_state_t capture_entry;
+
+	fd = open( path, O_RDONLY );
+
+	if( (fd < 0) || (fstat( fd, &st ) != 0) )
+	{
+		if( fd >= 0 )
+			close( fd );
+
+		return VMC96ANALYZE_ERROR_OPEN_FILE;
+	}
+
+	if( st.st_size == 0 )
+	{
+		close( fd );
+		return VMC96ANALYZE_SUCCESS;
+	}
+
+	map = (const unsigned char *) mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+
+	if( map == MAP_FAILED )
+		return VMC96ANALYZE_ERROR_OPEN_FILE;
+
+	madvise( (void*) map, st.st_size, MADV_SEQUENTIAL );
+
+	end = map + st.st_size;
+	p = map;
+
+	capture = (st.st_size >= (off_t) sizeof(VMC96_capture_header_t)) && !memcmp( map, VMC96_CAPTURE_MAGIC, 8 );
+
+	if( capture )
+		p = map + sizeof(VMC96_capture_header_t);
+
+	chunk = ( end - p ) / threads + 1;
+
+	memset( chunks, 0, threads * sizeof(vmc96analyze_chunk_t) );
+
+	for( i = 0; i < threads; i++ )
+	{
+		chunks[i].capture = capture;
+		chunks[i].file_start = p;
+		chunks[i].file_end = end;
+		chunks[i].start = ( p + i * chunk < end ) ? p + i * chunk : end;
+		chunks[i].end = ( p + (i + 1) * chunk < end ) ? p + (i + 1) * chunk : end;
+	}
+
+	/* Chunks start on their sync point and end on the next one: nothing before a sync point is skipped */
+	if( threads > 1 )
+	{
+		ret = vmc96analyze_run( chunks + 1, threads - 1, capture ? vmc96analyze_capture_sync_thread : vmc96analyze_raw_sync_thread );
+
+		for( i = threads - 1; (i > 0) && (ret == VMC96ANALYZE_SUCCESS); i-- )
+		{
+			/* No sync point: the previous chunk goes on up to the next one */
+			if( !chunks[i].sync )
+				chunks[i].sync = ( i == threads - 1 ) ? end : chunks[i + 1].start;
+
+			chunks[i].start = chunks[i].sync;
+			chunks[i - 1].end = chunks[i].start;
+		}
+	}
+
+	if( ret == VMC96ANALYZE_SUCCESS )
+		ret = vmc96analyze_run( chunks, threads, capture ? vmc96analyze_capture_thread : vmc96analyze_raw_thread );
+
+	/* A capture sync point that is not where the previous walk stopped was a false match: walk the file on one thread */
+	for( i = 0; capture && (i < threads - 1) && (ret == VMC96ANALYZE_SUCCESS); i++ )
+	{
+		if( !chunks[i].truncated && (chunks[i].stop != chunks[i].end) )
+		{
+			memset( chunks, 0, sizeof(vmc96analyze_chunk_t) );
+
+			chunks[0].capture = capture;
+			chunks[0].file_start = p;
+			chunks[0].file_end = end;
+			chunks[0].start = p;
+			chunks[0].end = end;
+
+			threads = 1;
+			ret = vmc96analyze_run( chunks, threads, vmc96analyze_capture_thread );
+			break;
+		}
+	}
+
+	for( i = 0; capture && (i < threads) && (ret == VMC96ANALYZE_SUCCESS); i++ )
+	{
+		if( chunks[i].truncated )
+			ret = VMC96ANALYZE_ERROR_INVALID_FILE;
+	}
+
+	memset( &entry, 0, sizeof(entry) );
+	memset( &capture_entry, 0, sizeof(capture_entry) );
+
+	for( i = 0; (i < threads) && (ret == VMC96ANALYZE_SUCCESS); i++ )
+	{
+		vmc96analyze_merge( result, &chunks[i] );
+
+		if( capture )
+			vmc96analyze_capture_link( result, &chunks[i], &capture_entry );
+		else
+			vmc96analyze_raw_link( result, &chunks[i], &entry );
+	}
+
+	munmap( (void*) map, st.st_size );
+
+	return ret;
+}
+
+
+static void vmc96analyze_merge( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src )
+{
+	int c = 0;
+	int m = 0;
+	int b = 0;
+
+	dst->totals.bytes += src->totals.bytes;
+	dst->totals.frames += src->totals.frames;
+	dst->totals.junk_bytes += src->totals.junk_bytes;
+	dst->totals.rejected += src->totals.rejected;
+	dst->totals.malformed += src->totals.malformed;
+	dst->totals.gap.count += src->totals.gap.count;
+	dst->totals.gap.sum_us += src->totals.gap.sum_us;
+
+	if( src->totals.gap.max_us > dst->totals.gap.max_us )
+		dst->totals.gap.max_us = src->totals.gap.max_us;
+
+	for( b = 0; b < VMC96ANALYZE_LATENCY_BUCKETS; b++ )
+		dst->totals.gap.bucket[b] += src->totals.gap.bucket[b];
+
+	for( c = 0; c < VMC96ANALYZE_CONTROLLERS; c++ )
+	{
+		for( m = 0; m < 256; m++ )
+		{
+			const vmc96analyze_pair_t * s = &src->pair[c][m];
+			vmc96analyze_pair_t * d = &dst->pair[c][m];
+
+			if( !s->frames && !s->responses )
+				continue;
+
+			d->frames += s->frames;
+			d->bytes += s->bytes;
+			d->checksum_errors += s->checksum_errors;
+			d->responses += s->responses;
+			d->timeouts += s->timeouts;
+			d->errors += s->errors;
+			d->latency.count += s->latency.count;
+			d->latency.sum_us += s->latency.sum_us;
+
+			if( s->latency.max_us > d->latency.max_us )
+				d->latency.max_us = s->latency.max_us;
+
+			for( b = 0; b < VMC96ANALYZE_LATENCY_BUCKETS; b++ )
+				d->latency.bucket[b] += s->latency.bucket[b];
+		}
+	}
+}
+
+
+static void vmc96analyze_raw_merge( vmc96analyze_chunk_t * dst, const vmc96analyze_raw_count_t count[][ 256 ] )
+{
+	int c = 0;
+	int m = 0;
+
+	for( c = 0; c < VMC96ANALYZE_CONTROLLERS; c++ )
+	{
+		for( m = 0; m < 256; m++ )
+		{
+			const vmc96analyze_raw_count_t * s = &count[c][m];
+			vmc96analyze_pair_t * d = &dst->pair[c][m];
+
+			if( !s->frames && !s->responses )
+				continue;
+
+			d->frames += s->frames;
+			d->bytes += s->bytes;
+			d->responses += s->responses;
+			d->errors += s->errors;
+			d->timeouts += s->timeouts;
+		}
+	}
+}
+
+
+static void vmc96analyze_raw_link( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src, vmc96analyze_raw_state_t * entry )
+{
+	vmc96analyze_pair_t * d = NULL;
+	vmc96analyze_raw_count_t n;
+	int path = VMC96ANALYZE_RAW_PATH_REQUEST;
+
+	if( src->head_controller < 0 )
+		return;
+
+	if( entry->pending )
+	{
+		memset( &n, 0, sizeof(n) );
+
+		/* The first frame of the chunk answers the last request of the previous one */
+		if( entry->controller == src->head_controller )
+		{
+			vmc96analyze_raw_response( &n, entry, src->head_length, src->head_code );
+			path = VMC96ANALYZE_RAW_PATH_RESPONSE;
+		}
+		else
+		{
+			n.responses++;
+			n.timeouts++;
+		}
+
+		d = &dst->pair[ vmc96analyze_controller_index( entry->controller ) ][ entry->command ];
+		d->bytes += n.bytes;
+		d->responses += n.responses;
+		d->errors += n.errors;
+		d->timeouts += n.timeouts;
+	}
+
+	vmc96analyze_raw_merge( dst, src->path[ path ].count );
+	vmc96analyze_raw_merge( dst, src->count );
+
+	*entry = src->path[ src->converged ? VMC96ANALYZE_RAW_PATH_REQUEST : path ].state;
+}
+
+
+static void vmc96analyze_capture_link( vmc96analyze_chunk_t * dst, const vmc96analyze_chunk_t * src, vmc96analyze_capture_state_t * entry )
+{
+	/* The first request of the chunk follows the last response of the previous ones */
+	if( src->head_tx && entry->responded )
+		vmc96analyze_latency_record( &dst->totals.gap, entry->since_rx_us + src->head_tx_us );
+
+	if( src->responded )
+	{
+		entry->responded = 1;
+		entry->since_rx_us = src->time_us - src->last_rx_us;
+	}
+	else
+	{
+		entry->since_rx_us += src->time_us;
+	}
+}
+
+
+static void vmc96analyze_report( const vmc96analyze_chunk_t * r, double elapsed )
+{
+	static const char * names[ VMC96ANALYZE_CONTROLLERS ] = { "GLOBAL", "RELAY1", "RELAY2", "MOTOR_ARRAY", "OTHER" };
+	int c = 0;
+	int m = 0;
+
+	printf( "%-12s %-5s %12s %12s %8s %8s %8s %10s %10s %10s\n", "CONTROLLER", "CMD", "FRAMES", "RESPONSES",
+		"CKS_ERR%", "ERR%", "TMOUT%", "P50(us)", "P99(us)", "MAX(us)" );
+
+	for( c = 0; c < VMC96ANALYZE_CONTROLLERS; c++ )
+	{
+		for( m = 0; m < 256; m++ )
+		{
+			const vmc96analyze_pair_t * p = &r->pair[c][m];
+			unsigned long long n = p->frames + p->responses;
+
+			if( !n )
+				continue;
+
+			printf( "%-12s 0x%02X  %12llu %12llu %8.3f %8.3f %8.3f %10llu %10llu %10llu\n", names[c], m, p->frames, p->responses,
+				100.0 * p->checksum_errors / n,
+				p->responses ? 100.0 * p->errors / p->responses : 0.0,
+				p->responses ? 100.0 * p->timeouts / p->responses : 0.0,
+				vmc96analyze_latency_percentile( &p->latency, 50.0 ),
+				vmc96analyze_latency_percentile( &p->latency, 99.0 ),
+				p->latency.max_us );
+		}
+	}
+
+	printf( "\nFrames: %llu, frame bytes: %llu, junk bytes: %llu, rejected STX candidates: %llu, malformed captured frames: %llu\n",
+		r->totals.frames, r->totals.bytes, r->totals.junk_bytes, r->totals.rejected, r->totals.malformed );
+
+	if( r->totals.gap.count )
+		printf( "Idle gap (response to next request): mean %llu us, p50 %llu us, p99 %llu us, max %llu us\n",
+			r->totals.gap.sum_us / r->totals.gap.count,
+			vmc96analyze_latency_percentile( &r->totals.gap, 50.0 ),
+			vmc96analyze_latency_percentile( &r->totals.gap, 99.0 ),
+			r->totals.gap.max_us );
+
+	printf( "Scanned in %.3f s (%.1f MB/s)\n", elapsed, elapsed > 0 ? (r->totals.bytes + r->totals.junk_bytes) / elapsed / 1e6 : 0.0 );
+}
+
+
+/* ********************************************************************* */
+/* *                                MAIN                               * */
+/* ********************************************************************* */
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	int index = 0;
+	int threads = 0;
+	int i = 0;
+	struct timespec t0;
+	struct timespec t1;
+	vmc96analyze_chunk_t * chunks = NULL;
+	vmc96analyze_chunk_t * result = NULL;
+
+	static struct option options[] =
+	{
+		{ "threads",     required_argument, 0,  'a' },
+		{ "help",        no_argument,       0,  'b' },
+		{ NULL,          no_argument,       0,   0  }
+	};
+
+	threads = sysconf( _SC_NPROCESSORS_ONLN );
+
+	while( (ret = getopt_long( argc, argv, "a:b", options, &index )) != -1 )
+	{
+		switch( ret )
+		{
+			case 'a' : threads = atoi( optarg ); break;
+
+			case 'b' :
+			default :
+				vmc96analyze_show_usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if( (optind >= argc) || (threads < 1) || (threads > VMC96ANALYZE_MAX_THREADS) )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96analyze_get_error_code_string( VMC96ANALYZE_ERROR_INVALID_ARGS ) );
+		return EXIT_FAILURE;
+	}
+
+	chunks = (vmc96analyze_chunk_t*) calloc( threads, sizeof(vmc96analyze_chunk_t) );
+	result = (vmc96analyze_chunk_t*) calloc( 1, sizeof(vmc96analyze_chunk_t) );
+
+	if( !chunks || !result )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96analyze_get_error_code_string( VMC96ANALYZE_ERROR_OUT_OF_MEMORY ) );
+		return EXIT_FAILURE;
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+	for( i = optind; i < argc; i++ )
+	{
+		ret = vmc96analyze_file( argv[i], threads, chunks, result );
+
+		if( ret != VMC96ANALYZE_SUCCESS )
+			fprintf( stderr, "Error: %s: %s\n", argv[i], vmc96analyze_get_error_code_string(ret) );
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+	vmc96analyze_report( result, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9 );
+
+	free( chunks );
+	free( result );
+
+	return EXIT_SUCCESS;
+}
+
+/* eof */
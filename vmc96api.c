@@ -28,11 +28,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 
 #ifdef __linux__
 #include <unistd.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
 #elif _WIN32
 #include <windows.h>
+#include <io.h>
 #else
 #error "Unexpected System."
 #endif
@@ -64,9 +76,42 @@
 #define VMC96_K1_RESPONSE_TYPE_DATA                       (2)
 #define VMC96_K1_RESPONSE_TIMEOUT_MS                      (1000)
 #define VMC96_K1_RESPONSE_READ_RETRY_DELAY_MS             (10)
+#define VMC96_K1_RESPONSE_ADAPTIVE_READ_DELAY_MS          (1)
+#define VMC96_K1_RESPONSE_ADAPTIVE_MAX_TIMEOUTS           (2)     /* Consecutive timeouts before a slot falls back to the fixed timeout */
+
+/* K1 PROTOCOL COMMAND SLOTS (ONE PER VALID CONTROLLER/COMMAND PAIR) */
+#define VMC96_K1_SLOT_INVALID                             (-1)
+#define VMC96_K1_SLOT_GLOBAL_BASE                         (0)
+#define VMC96_K1_SLOT_RELAY_BASE                          (1)
+#define VMC96_K1_SLOT_RELAY_COUNT                         (4)
+#define VMC96_K1_SLOT_MOTOR_ARRAY_BASE                    (9)
+#define VMC96_K1_SLOTS_COUNT                              (18)
+
+/* FRAME TABLE (READY-TO-SEND FRAMES, BUILT WITH THE CONTEXT) */
+#define VMC96_FRAME_TABLE_FRAME_MAX_LEN                   (VMC96_K1_MESSAGE_MIN_LEN + 1)   /* At most one data byte */
+#define VMC96_FRAME_TABLE_RELAYS_COUNT                    (2)
+#define VMC96_GLOBAL_RESET_DATA                           (0xFF)
+
+/* LATENCY HISTOGRAMS (LOG-LINEAR, 8 SUB-BUCKETS PER POWER OF TWO NANOSECONDS) */
+#define VMC96_HISTOGRAM_SUB_BUCKET_BITS                   (3)
+#define VMC96_HISTOGRAM_SUB_BUCKETS                       (1 << VMC96_HISTOGRAM_SUB_BUCKET_BITS)
+#define VMC96_HISTOGRAM_DECAY_COUNT                       (1024)   /* Halve counts to follow changes */
+
+/* K1 PROTOCOL RETRY CLASSES */
+#define VMC96_K1_RETRY_CLASS_NONE                         (0)   /* Never resent */
+#define VMC96_K1_RETRY_CLASS_IDEMPOTENT                   (1)   /* Safe to resend */
+#define VMC96_K1_RETRY_CLASS_VERIFY                       (2)   /* Resent only if a status request shows no effect */
+
+/* K1 PROTOCOL RETRY VERIFICATION RESULTS */
+#define VMC96_K1_RETRY_RESEND                             (-1)
+#define VMC96_K1_RETRY_ABORT                              (-2)
+#define VMC96_K1_TRANSIENT_ERROR( _ret )                  (((_ret) == VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM) || \
+                                                           ((_ret) == VMC96_ERROR_K1_RESPONSE_TIMEOUT) || \
+                                                           ((_ret) == VMC96_ERROR_K1_RESPONSE_MALFORMED))
 
 /* DEVICE */
 #define VMC96_MOTOR_MAX_CURRENT_READING_MA                (500)
+#define VMC96_MOTOR_RUN_MAX_MOTORS_PER_FRAME              (VMC96_MOTOR_ARRAY_ROWS_COUNT * VMC96_MOTOR_ARRAY_COLUMNS_COUNT)
 
 /* VMC96 AVAILABLE CONTROLLERS */
 #define VMC96_CONTROLLER_GLOBAL_BROADCAST                 (0x00)
@@ -103,12 +148,68 @@
 /* SLEEP/DELAY */
 #ifdef __linux__
 #define VMC96_SLEEP_MS( _t )    usleep( _t * 1000L )
+#define VMC96_YIELD()           sched_yield()
 #elif _WIN32
 #define VMC96_SLEEP_MS( _t )    Sleep( _t )
+#define VMC96_YIELD()           SwitchToThread()
 #else
 #define VMC96_SLEEP_MS( _t )
+#define VMC96_YIELD()
 #endif
 
+/* RAW FILE DESCRIPTOR WRITE */
+#ifdef _WIN32
+#define VMC96_WRITE_FD( _fd, _buf, _len )    _write( _fd, _buf, (unsigned int)(_len) )
+#else
+#define VMC96_WRITE_FD( _fd, _buf, _len )    write( _fd, _buf, _len )
+#endif
+
+/* TRACE RING AND CAPTURE */
+#define VMC96_TRACE_MAX_RECORDS                           (1 << 20)
+#define VMC96_TRACE_FLAG_RING                             (0x01)
+#define VMC96_TRACE_FLAG_CAPTURE                          (0x02)
+
+/* Tracing and capture cost a single well-predicted branch while disabled */
+#define VMC96_TRACE( _vmc96, _dir, _frame, _len, _res )   do { if( __builtin_expect( (_vmc96)->trace.flags, 0 ) ) vmc96_trace_frame( _vmc96, _dir, _frame, _len, _res ); } while( 0 )
+
+/* STATUS PAGE */
+#define VMC96_STATUS_PAGE_NAME_MAX_LEN                    (256)
+#define VMC96_STATUS_PAGE_READ_SPINS                      (1 << 16)   /* Publisher died mid-write */
+
+/* Publishing costs a single well-predicted branch while disabled */
+#define VMC96_STATUS_PAGE_UPDATE( _vmc96, _field, _val, _us )  do { if( __builtin_expect( (_vmc96)->status_page != NULL, 0 ) ) vmc96_status_page_update( _vmc96, _field, _val, sizeof(*(_val)), _us ); } while( 0 )
+
+/* STATISTICS SEQLOCK */
+#define VMC96_STATS_READ_ATTEMPTS                         (16)   /* Lock-free copies tried before yielding the CPU to the writer */
+
+/* TIMER WHEEL */
+#define VMC96_TIMER_WHEEL_LEVELS                          (4)
+#define VMC96_TIMER_WHEEL_SLOT_BITS                       (6)
+#define VMC96_TIMER_WHEEL_SLOTS                           (1 << VMC96_TIMER_WHEEL_SLOT_BITS)
+#define VMC96_TIMER_WHEEL_SLOT_MASK                       (VMC96_TIMER_WHEEL_SLOTS - 1)
+#define VMC96_TIMER_WHEEL_MAX_TICKS                       ((1ULL << (VMC96_TIMER_WHEEL_LEVELS * VMC96_TIMER_WHEEL_SLOT_BITS)) - 1)
+#define VMC96_TIMER_WHEEL_INDEX( _tick, _level )          (((_tick) >> ((_level) * VMC96_TIMER_WHEEL_SLOT_BITS)) & VMC96_TIMER_WHEEL_SLOT_MASK)
+#define VMC96_TIMER_HANDLE( _idx, _gen )                  (((unsigned int)(_gen) << 16) | (_idx))
+#define VMC96_TIMER_HANDLE_INDEX( _h )                    ((_h) & 0xFFFF)
+#define VMC96_TIMER_HANDLE_GENERATION( _h )               ((_h) >> 16)
+
+/* CONTEXT LOCK (PRIORITY BUS QUEUE) */
+#define VMC96_BUS_CLASS_READ                              VMC96_COMMAND_CLASS_READ     /* Canceled by a safety command */
+#define VMC96_BUS_CLASS_NORMAL                            VMC96_COMMAND_CLASS_NORMAL
+#define VMC96_BUS_CLASS_URGENT                            VMC96_COMMAND_CLASS_SAFETY   /* Head of the queue */
+#define VMC96_LOCK( _vmc96 )                              vmc96_bus_acquire( _vmc96, VMC96_BUS_CLASS_NORMAL )
+#define VMC96_UNLOCK( _vmc96 )                            vmc96_bus_release( _vmc96 )
+#define VMC96_BUS_URGENT_PENDING( _vmc96 )                ( __atomic_load_n( &(_vmc96)->bus.urgent, __ATOMIC_RELAXED ) != 0 )
+
+/* SINGLE-FLIGHT READS (IDENTICAL CONCURRENT REQUESTS SHARE ONE ROUND TRIP) */
+#define VMC96_FLIGHT_NONE                                 (-1)
+#define VMC96_FLIGHT_MOTOR_STATUS                         (0)
+#define VMC96_FLIGHT_MOTOR_OPTO_LINE                      (1)
+#define VMC96_FLIGHT_MOTOR_SCAN                           (2)
+#define VMC96_FLIGHT_MOTOR_VERSION                        (3)
+#define VMC96_FLIGHT_RELAY_VERSION                        (4)   /* + Relay index */
+#define VMC96_FLIGHT_SLOTS_COUNT                          (6)
+
 /* DEBUG */
 #ifdef _DEBUG
 #define VMC96_DEBUG_MSG( _str )                      fprintf( stdout, _str )
@@ -126,6 +227,14 @@
 /* ********************************************************************* */
 
 typedef struct vmc96_message_s vmc96_message_t;
+typedef struct vmc96_sequencer_s vmc96_sequencer_t;
+typedef struct vmc96_timer_s vmc96_timer_t;
+typedef struct vmc96_timer_wheel_s vmc96_timer_wheel_t;
+typedef struct vmc96_trace_s vmc96_trace_t;
+typedef struct vmc96_health_monitor_s vmc96_health_monitor_t;
+typedef struct vmc96_bus_s vmc96_bus_t;
+typedef struct vmc96_flight_s vmc96_flight_t;
+typedef struct vmc96_frame_table_s vmc96_frame_table_t;
 
 
 struct vmc96_message_s
@@ -136,15 +245,148 @@ struct vmc96_message_s
 	unsigned char data_length;
 	unsigned char k1[ VMC96_K1_MESSAGE_MAX_LEN ];
 	unsigned char k1_length;
+	unsigned long long timestamp_us;
+};
+
+
+struct vmc96_sequencer_s
+{
+	pthread_mutex_t lock;
+	pthread_t thread;
+	int running;
+	int joining;
+	int timer_fd;
+	int cancel_fd;
+	VMC96_sequence_step_t * steps;
+	unsigned int count;
+	int result;
+};
+
+
+struct vmc96_timer_s
+{
+	vmc96_timer_t * next;
+	vmc96_timer_t * prev;
+	unsigned long long expires;         /* Expiration tick */
+	unsigned short generation;          /* Bumped on every reuse, invalidates old handles */
+	unsigned char pending;
+	VMC96_sequence_step_t action;
+	VMC96_timer_callback_t callback;
+	void * userdata;
+};
+
+
+struct vmc96_timer_wheel_s
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	int running;
+	int stop;
+	int timer_fd;
+	int wake_fd;
+	unsigned long long start_us;        /* Tick zero */
+	unsigned long long base;            /* Next tick to be processed */
+	unsigned long long armed;           /* Tick the timerfd is armed to */
+	unsigned long long level0_bitmap;   /* Non-empty level 0 slots */
+	vmc96_timer_t * slot[ VMC96_TIMER_WHEEL_LEVELS ][ VMC96_TIMER_WHEEL_SLOTS ];
+	vmc96_timer_t * pool;
+	vmc96_timer_t * free_list;
+};
+
+
+struct vmc96_trace_s
+{
+	int flags;                          /* VMC96_TRACE_FLAG_* */
+	unsigned int mask;                  /* Ring size - 1 */
+	unsigned int head;                  /* Sequence of the newest record (single writer: the context lock holder) */
+	VMC96_trace_record_t * ring;
+	VMC96_trace_callback_t callback;
+	void * userdata;
+	int capture_fd;
+	int capture_error;
+	unsigned long long capture_last_us;
+};
+
+
+struct vmc96_health_monitor_s
+{
+	pthread_t thread;
+	pthread_mutex_t lock;               /* Guards the state, never held during a transaction */
+	int running;
+	int joining;
+	int cancel_fd;
+	VMC96_health_policy_t policy;
+	VMC96_health_callback_t callback;
+	void * userdata;
+	VMC96_health_t state;
+	unsigned long long last_ping_us[ VMC96_HEALTH_CONTROLLERS_COUNT ];
+	unsigned int next;                  /* Round robin: controller checked first on the next idle slot */
+};
+
+
+struct vmc96_bus_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t owner;
+	unsigned int depth;                 /* Owner recursion depth (0: bus free) */
+	unsigned int urgent;                /* Safety commands waiting for the bus */
+	unsigned int generation;            /* Bumped by every safety command: cancels the reads queued before it */
+};
+
+
+struct vmc96_flight_s
+{
+	int active;                         /* A leader is waiting for the bus or on the wire */
+	unsigned int generation;            /* Bumped when the leader completes */
+	unsigned int followers;             /* Callers waiting for the leader's response */
+	int result;
+	vmc96_message_t response;
+};
+
+
+struct vmc96_frame_table_s
+{
+	unsigned char command[ VMC96_K1_SLOTS_COUNT ][ VMC96_FRAME_TABLE_FRAME_MAX_LEN ];   /* By K1 slot, empty if the payload varies */
+	unsigned char motor_run[ VMC96_MOTOR_ARRAY_ROWS_COUNT ][ VMC96_MOTOR_ARRAY_COLUMNS_COUNT ][ VMC96_FRAME_TABLE_FRAME_MAX_LEN ];
+	unsigned char relay[ VMC96_FRAME_TABLE_RELAYS_COUNT ][ 2 ][ VMC96_FRAME_TABLE_FRAME_MAX_LEN ];  /* [Relay][State] */
 };
 
 
 struct VMC96_s
 {
+	vmc96_bus_t bus;
 	struct ftdi_context * ftdi;
 	struct ftdi_version_info ftdi_version;
+	VMC96_transport_t transport;
 	vmc96_message_t message;
 	vmc96_message_t response;
+	unsigned char motor_run_max_accepted;   /* Largest MOTOR_RUN frame (motors count) accepted so far */
+	unsigned char motor_run_max_per_frame;  /* Largest MOTOR_RUN frame (motors count) not refused yet, the limit once accepted */
+	vmc96_sequencer_t sequencer;
+	vmc96_timer_wheel_t wheel;
+	VMC96_retry_policy_t retry_policy;
+	VMC96_retry_stats_t retry_stats;
+	VMC96_timeout_policy_t timeout_policy;
+	VMC96_histogram_t response_time[ VMC96_K1_SLOTS_COUNT ];
+	unsigned char response_timeouts[ VMC96_K1_SLOTS_COUNT ];  /* Consecutive timeouts per slot (adaptive mode) */
+	unsigned int response_timeout_ms;                       /* Deadline of the current transaction */
+	int retrying;                                           /* Retry on the wire: the fixed timeout applies */
+	unsigned long long timing[ VMC96_STATS_PHASES_COUNT ];  /* Phases of the current transaction */
+	unsigned int timing_valid;                              /* Bitmask of the measured phases */
+	VMC96_stats_t stats;
+	unsigned int stats_sequence;                            /* Seqlock of stats (odd while the lock holder updates it) */
+	vmc96_trace_t trace;
+	VMC96_status_page_t * status_page;
+	pthread_mutex_t status_page_lock;       /* Page writer: never held across a K1 transaction */
+	char status_page_name[ VMC96_STATUS_PAGE_NAME_MAX_LEN ];
+	unsigned long long last_seen_us[ VMC96_HEALTH_CONTROLLERS_COUNT ];  /* Last successful transaction per monitored controller */
+	unsigned long long bus_idle_us;         /* End of the last transaction */
+	unsigned int bus_waiters;               /* Callers waiting for the context lock */
+	unsigned int ping_timeout_ms;           /* Health ping in progress: short timeout, never retried */
+	vmc96_health_monitor_t health;
+	vmc96_flight_t flight[ VMC96_FLIGHT_SLOTS_COUNT ];  /* Guarded by bus.lock */
+	vmc96_frame_table_t frames;                         /* Read only after vmc96_context_new() */
 };
 
 
@@ -169,7 +411,7 @@ static void vmc96_dump_buffer( FILE * fp, const char * desc, unsigned char * buf
 	\param buflen
 	\return
 */
-static unsigned char vmc96_calculate_checksum( unsigned char * buf, size_t buflen );
+static unsigned char vmc96_calculate_checksum( const unsigned char * buf, size_t buflen );
 
 /*!
 	\brief Send K1 Message
@@ -185,6 +427,33 @@ static int vmc96_send_k1_message( VMC96_t * vmc96 );
 */
 static int vmc96_prepare_k1_message( VMC96_t * vmc96 );
 
+/*!
+	\brief Encode a K1 Frame
+	\param k1 Buffer of at least data_length + VMC96_K1_MESSAGE_MIN_LEN bytes
+	\param id_controller
+	\param command
+	\param data
+	\param data_length
+	\return
+*/
+static void vmc96_k1_encode( unsigned char * k1, unsigned char id_controller, unsigned char command, const unsigned char * data, unsigned char data_length );
+
+/*!
+	\brief Encode Every Constant and Per-Motor Frame
+	\param table
+	\return
+*/
+static void vmc96_frame_table_build( vmc96_frame_table_t * table );
+
+/*!
+	\brief Ready-to-Send Frame of a Request Without Data
+	\param vmc96
+	\param id_controller
+	\param command
+	\return Frame, or NULL if the request is not in the table
+*/
+static const unsigned char * vmc96_frame_table_lookup( VMC96_t * vmc96, unsigned char id_controller, unsigned char command );
+
 /*!
 	\brief Parse K1 Message Response
 	\param vmc96
@@ -199,19 +468,301 @@ static int vmc96_parse_k1_response( VMC96_t * vmc96 );
 */
 static int vmc96_k1_parse_response_type( VMC96_t * vmc96 );
 
+/*!
+	\brief Index of a Controller/Command Pair in Per-Command Tables
+	\param id_controller
+	\param command
+	\return Slot index or VMC96_K1_SLOT_INVALID
+*/
+static int vmc96_k1_command_slot( unsigned char id_controller, unsigned char command );
+
+/*!
+	\brief Current CLOCK_MONOTONIC time
+	\return Nanoseconds
+*/
+static unsigned long long vmc96_monotonic_ns( void );
+
+/*!
+	\brief Account a K1 Transaction in the Statistics
+	\param vmc96
+	\param ret Transaction result
+	\param busy_ns Time the transaction held the bus
+	\return
+*/
+static void vmc96_stats_record( VMC96_t * vmc96, int ret, unsigned long long busy_ns );
+
+/*!
+	\brief Open a Statistics Update (Seqlock Write Side, Context Lock Held)
+	\param vmc96
+	\return
+*/
+static void vmc96_stats_write_begin( VMC96_t * vmc96 );
+
+/*!
+	\brief Close a Statistics Update
+	\param vmc96
+	\return
+*/
+static void vmc96_stats_write_end( VMC96_t * vmc96 );
+
+/*!
+	\brief Append a Frame to the Trace Ring
+	\param vmc96
+	\param direction VMC96_TRACE_DIRECTION_TX or VMC96_TRACE_DIRECTION_RX
+	\param frame
+	\param length
+	\param result
+	\return
+*/
+static void vmc96_trace_frame( VMC96_t * vmc96, int direction, const unsigned char * frame, int length, int result );
+
+/*!
+	\brief Append a Frame to the Capture File
+	\param vmc96
+	\param timestamp_ns
+	\param direction
+	\param frame
+	\param length
+	\param result
+	\return
+*/
+static void vmc96_capture_frame( VMC96_t * vmc96, unsigned long long timestamp_ns, int direction, const unsigned char * frame, int length, int result );
+
+/*!
+	\brief Write a Decoded Field into the Published Status Page
+	\param vmc96
+	\param field VMC96_STATUS_PAGE_*
+	\param value
+	\param size
+	\param response_us Response Timestamp (Older Than the Published Field: Dropped)
+	\return
+*/
+static void vmc96_status_page_update( VMC96_t * vmc96, int field, const void * value, size_t size, unsigned long long response_us );
+
+#ifdef __linux__
+
+/*!
+	\brief Check Whether a Status Page Name Belongs to a Running Publisher
+	\param vmc96
+	\param name
+	\return 1 if a running publisher (other than this context) owns the page, 0 otherwise
+*/
+static int vmc96_status_page_in_use( VMC96_t * vmc96, const char * name );
+
+/*!
+	\brief Start Time of a Process (Told Apart From a Later Process Reusing its Pid)
+	\param pid
+	\return Clock ticks since boot, 0 if unknown
+*/
+static unsigned long long vmc96_process_start_time( int pid );
+
+#endif
+
+/*!
+	\brief Allocate a Context With Default Policies (No Transport)
+	\return Context or NULL if out of memory
+*/
+static VMC96_t * vmc96_context_new( void );
+
+/*!
+	\brief Release a Context Allocated by vmc96_context_new()
+	\param vmc96
+	\return
+*/
+static void vmc96_context_free( VMC96_t * vmc96 );
+
+/*!
+	\brief Response Timeout of the Current K1 Message
+	\param vmc96
+	\return Timeout in milliseconds
+*/
+static unsigned int vmc96_k1_response_timeout( VMC96_t * vmc96 );
+
+/*!
+	\brief Send Prepared K1 Message and Parse its Response
+	\param vmc96
+	\return
+*/
+static int vmc96_k1_transaction( VMC96_t * vmc96 );
+
+/*!
+	\brief Retry Class of the Current K1 Message
+	\param vmc96
+	\return
+*/
+static int vmc96_k1_retry_class( VMC96_t * vmc96 );
+
+/*!
+	\brief Retry a K1 Message After a Transient Error
+	\param vmc96
+	\param ret Transient error of the first attempt
+	\return
+*/
+static int vmc96_k1_retry( VMC96_t * vmc96, int ret );
+
+/*!
+	\brief Take the Bus (Context Lock), Recursive, Safety Commands First
+	\param vmc96
+	\param cls VMC96_BUS_CLASS_*
+	\return VMC96_SUCCESS, or VMC96_ERROR_COMMAND_PREEMPTED if a read was canceled by a safety command
+*/
+static int vmc96_bus_acquire( VMC96_t * vmc96, int cls );
+
+/*!
+	\brief Take the Bus Only if it is Free and No Safety Command is Waiting
+	\param vmc96
+	\return VMC96_SUCCESS or VMC96_ERROR_COMMAND_PREEMPTED
+*/
+static int vmc96_bus_try_acquire( VMC96_t * vmc96 );
+
+/*!
+	\brief Release the Bus
+	\param vmc96
+	\return
+*/
+static void vmc96_bus_release( VMC96_t * vmc96 );
+
+/*!
+	\brief Single-Flight Slot of a Read Request
+	\param id_controller
+	\param command
+	\return VMC96_FLIGHT_* or VMC96_FLIGHT_NONE if the request is not coalesced
+*/
+static int vmc96_flight_index( unsigned char id_controller, unsigned char command );
+
+/*!
+	\brief Wait for an Identical Request Already in Flight, or Become its Leader
+	\param vmc96
+	\param slot VMC96_FLIGHT_*
+	\param response Buffer to receive a copy of the shared response (may be NULL)
+	\param result Result of the shared request (followers only)
+	\return 1 if the caller is a follower (result and response are set), 0 if it is the leader, -1 if it must send the request alone
+*/
+static int vmc96_flight_join( VMC96_t * vmc96, int slot, vmc96_message_t * response, int * result );
+
+/*!
+	\brief Hand the Leader's Result and Response to its Followers
+	\param vmc96
+	\param slot VMC96_FLIGHT_*
+	\param result
+	\return
+*/
+static void vmc96_flight_complete( VMC96_t * vmc96, int slot, int result );
+
 /*!
 	\brief Send Message
 	\param vmc96
+	\param response Buffer to receive a copy of the parsed response (may be NULL)
 	\return
 */
-static int vmc96_send_message( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd );
+static int vmc96_send_message( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, vmc96_message_t * response );
 
 /*!
 	\brief Send Message With Data
 	\param vmc96
+	\param response Buffer to receive a copy of the parsed response (may be NULL)
+	\return
+*/
+static int vmc96_send_message_ex( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, unsigned char * data, unsigned char datalen, vmc96_message_t * response );
+
+/*!
+	\brief Send Message, Optionally From an Already Encoded K1 Frame
+	\param vmc96
+	\param frame Encoded frame matching id_cntlr/cmd/data (NULL: encoded here)
+	\param response Buffer to receive a copy of the parsed response (may be NULL)
+	\return
+*/
+static int vmc96_send_k1( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, const unsigned char * data, unsigned char datalen, const unsigned char * frame, vmc96_message_t * response );
+
+/*!
+	\brief Decode a Motor Status Response
+	\param response
+	\param status
+	\return
+*/
+static int vmc96_decode_motor_status( const vmc96_message_t * response, VMC96_motor_array_status_t * status );
+
+/*!
+	\brief Decode an Opto Line Status Response
+	\param response
+	\param status_block
+	\return
+*/
+static int vmc96_decode_opto_line_status( const vmc96_message_t * response, VMC96_opto_line_sample_block_t * status_block );
+
+/*!
+	\brief Decode a Motor Array Scan Response
+	\param response
+	\param result
+	\return
+*/
+static int vmc96_decode_scan_array( const vmc96_message_t * response, VMC96_motor_array_scan_result_t * result );
+
+/*!
+	\brief Current CLOCK_MONOTONIC time
+	\return Microseconds
+*/
+static unsigned long long vmc96_monotonic_us( void );
+
+#ifdef __linux__
+
+/*!
+	\brief Sequencer Thread
+	\param arg
+	\return
+*/
+static void * vmc96_sequencer_thread( void * arg );
+
+/*!
+	\brief Execute a Sequence Step / Timer Action
+	\param vmc96
+	\param step
+	\return
+*/
+static int vmc96_execute_action( VMC96_t * vmc96, VMC96_sequence_step_t * step );
+static void vmc96_execute_step( VMC96_t * vmc96, VMC96_sequence_step_t * step );
+
+/*!
+	\brief Timer Wheel Thread
+	\param arg
+	\return
+*/
+static void * vmc96_timer_wheel_thread( void * arg );
+
+#endif
+
+/*!
+	\brief Stop Timer Wheel Thread and Release its Resources
+	\param vmc96
+	\return
+*/
+static void vmc96_timer_wheel_destroy( VMC96_t * vmc96 );
+
+/*!
+	\brief Health Monitor Index of a Controller
+	\param id_controller
+	\return VMC96_HEALTH_* or -1 if not monitored
+*/
+static int vmc96_health_index( unsigned char id_controller );
+
+#ifdef __linux__
+
+/*!
+	\brief Check the Controllers and Ping at Most One of Them if the Bus is Idle
+	\param vmc96
+	\param changed Buffer to store the controllers whose liveness changed
+	\return Number of controllers stored in changed
+*/
+static int vmc96_health_tick( VMC96_t * vmc96, VMC96_controller_health_t * changed );
+
+/*!
+	\brief Health Monitor Thread
+	\param arg
 	\return
 */
-static int vmc96_send_message_ex( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, unsigned char * data, unsigned char datalen );
+static void * vmc96_health_thread( void * arg );
+
+#endif
 
 
 /* ********************************************************************* */
@@ -241,6 +792,8 @@ const char * vmc96_get_error_code_string( int cod )
 	{
 		case VMC96_SUCCESS                            : return "Success."; break;
 		case VMC96_ERROR_OUT_OF_MEMORY                : return "Out of memory."; break;
+		case VMC96_ERROR_SYSTEM_CALL                  : return "System call failed."; break;
+		case VMC96_ERROR_NOT_SUPPORTED                : return "Not supported on this platform."; break;
 		case VMC96_ERROR_FTDI_INITIALIZE              : return "Can not initialize libftdi."; break;
 		case VMC96_ERROR_FTDI_SET_INTERFACE           : return "libftdi can not de interface."; break;
 		case VMC96_ERROR_FTDI_OPEN_USB_DEVICE         : return "libftdi can not open USB device (not found or permission denied)."; break;
@@ -258,6 +811,25 @@ const char * vmc96_get_error_code_string( int cod )
 		case VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH   : return "Invalid response length."; break;
 		case VMC96_ERROR_K1_RESPONSE_TIMEOUT          : return "Device took too long to respond (timeout)."; break;
 		case VMC96_ERROR_INVALID_MOTOR_COORDINATES    : return "Invalid motor coordinates."; break;
+		case VMC96_ERROR_INVALID_RETRY_POLICY         : return "Invalid retry policy."; break;
+		case VMC96_ERROR_INVALID_TIMEOUT_POLICY       : return "Invalid timeout policy."; break;
+		case VMC96_ERROR_INVALID_TRANSPORT            : return "Invalid transport."; break;
+		case VMC96_ERROR_INVALID_REQUEST              : return "Invalid request."; break;
+		case VMC96_ERROR_INVALID_HEALTH_POLICY        : return "Invalid health policy."; break;
+		case VMC96_ERROR_SEQUENCE_BUSY                : return "A sequence is already running."; break;
+		case VMC96_ERROR_SEQUENCE_INVALID             : return "Invalid sequence steps."; break;
+		case VMC96_ERROR_SEQUENCE_CANCELED            : return "Sequence canceled."; break;
+		case VMC96_ERROR_TIMER_POOL_EXHAUSTED         : return "Too many pending timers."; break;
+		case VMC96_ERROR_TIMER_NOT_PENDING            : return "Timer not pending (expired or canceled)."; break;
+		case VMC96_ERROR_TIMER_INVALID_DELAY          : return "Timer delay too long."; break;
+		case VMC96_ERROR_TRACE_INVALID_SIZE           : return "Trace ring size must be a power of two."; break;
+		case VMC96_ERROR_TRACE_NOT_ALLOCATED          : return "Trace ring not allocated."; break;
+		case VMC96_ERROR_CAPTURE_WRITE                : return "Can not write capture file."; break;
+		case VMC96_ERROR_STATUS_PAGE_INVALID          : return "Invalid status page (not published or incompatible version)."; break;
+		case VMC96_ERROR_STATUS_PAGE_BUSY             : return "Status page is being written (publisher stalled)."; break;
+		case VMC96_ERROR_STATUS_PAGE_IN_USE           : return "Status page is published by a running process."; break;
+		case VMC96_ERROR_HEALTH_BUSY                  : return "Health monitor already running."; break;
+		case VMC96_ERROR_COMMAND_PREEMPTED            : return "Command canceled by a safety command (stop all/reset)."; break;
 		default                                       : return "Unknown error."; break;
 
 	}
@@ -270,25 +842,26 @@ const char * vmc96_get_error_code_string( int cod )
 
 int vmc96_relay_ping( VMC96_t * vmc96, unsigned char id )
 {
-	return vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_SIMPLE_PING );
+	return vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_SIMPLE_PING, NULL );
 }
 
 
 int vmc96_relay_get_version( VMC96_t * vmc96, unsigned char id, char * version )
 {
 	int ret = 0;
+	vmc96_message_t response;
 
 	*version = '\0';
 
-	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_KERNEL_VERSION );
+	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_KERNEL_VERSION, &response );
 
 	if( ret != VMC96_SUCCESS )
 		return ret;
 
-	if( vmc96->response.data_length > 0 )
+	if( response.data_length > 0 )
 	{
-		memcpy( version, vmc96->response.data + 1, vmc96->response.data_length - 1 );
-		version[ vmc96->response.data_length - 1 ] = '\0';
+		memcpy( version, response.data + 1, response.data_length - 1 );
+		version[ response.data_length - 1 ] = '\0';
 	}
 
 	return VMC96_SUCCESS;
@@ -297,14 +870,23 @@ int vmc96_relay_get_version( VMC96_t * vmc96, unsigned char id, char * version )
 
 int vmc96_relay_reset( VMC96_t * vmc96, unsigned char id )
 {
-	return vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_RESET );
+	return vmc96_send_message( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_RESET, NULL );
 }
 
 
 int vmc96_relay_control( VMC96_t * vmc96, unsigned char id, unsigned char state )
 {
+	int ret = 0;
 	unsigned char data = ( state ) ? 1 : 0;
-	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_RELAY_FUNCTION, &data, 1 );
+	vmc96_message_t response;
+
+	ret = vmc96_send_k1( vmc96, VMC96_CONTROLLER_RELAY_BASE_ADDRESS + id, VMC96_COMMAND_RELAY_FUNCTION, &data, 1,
+		( id < VMC96_FRAME_TABLE_RELAYS_COUNT ) ? vmc96->frames.relay[ id ][ data ] : NULL, &response );
+
+	if( (ret == VMC96_SUCCESS) && (id <= 1) )
+		VMC96_STATUS_PAGE_UPDATE( vmc96, VMC96_STATUS_PAGE_RELAY1 + id, &data, response.timestamp_us );
+
+	return ret;
 }
 
 
@@ -314,25 +896,26 @@ int vmc96_relay_control( VMC96_t * vmc96, unsigned char id, unsigned char state
 
 int vmc96_motor_ping( VMC96_t * vmc96 )
 {
-	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_SIMPLE_PING );
+	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_SIMPLE_PING, NULL );
 }
 
 
 int vmc96_motor_get_version( VMC96_t * vmc96, char * version )
 {
 	int ret = 0;
+	vmc96_message_t response;
 
 	*version = '\0';
 
-	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_KERNEL_VERSION );
+	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_KERNEL_VERSION, &response );
 
 	if( ret != VMC96_SUCCESS )
 		return ret;
 
-	if( vmc96->response.data_length > 0 )
+	if( response.data_length > 0 )
 	{
-		memcpy( version, vmc96->response.data + 1, vmc96->response.data_length - 1 );
-		version[ vmc96->response.data_length - 1 ] = '\0';
+		memcpy( version, response.data + 1, response.data_length - 1 );
+		version[ response.data_length - 1 ] = '\0';
 	}
 
 	return VMC96_SUCCESS;
@@ -341,49 +924,34 @@ int vmc96_motor_get_version( VMC96_t * vmc96, char * version )
 
 int vmc96_motor_reset( VMC96_t * vmc96 )
 {
-	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_RESET );
+	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_RESET, NULL );
 }
 
 
 int vmc96_motor_get_status( VMC96_t * vmc96, VMC96_motor_array_status_t * status )
 {
 	int ret = 0;
-	int i = 0;
+	vmc96_message_t response;
 
 	memset( status, 0, sizeof(VMC96_motor_array_status_t) );
 
-	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STATUS_REQUEST );
+	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STATUS_REQUEST, &response );
 
 	if( ret != VMC96_SUCCESS )
 		return ret;
 
-	if( vmc96->response.data_length >= 2 )
-	{
-		if( vmc96->response.data[0] != VMC96_COMMAND_MOTOR_STATUS_REQUEST )
-			return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
-
-		status->current_ma = VMC96_GET_MOTOR_CURRENT_MA( vmc96->response.data[1] );
-
-		status->active_count = vmc96->response.data_length - 2;
-
-		memset( &status->array, 0, sizeof(VMC96_motor_array_t) );
-
-		for( i = 0; i < vmc96->response.data_length - 2; i++ )
-		{
-			unsigned char row = VMC96_GET_MOTOR_ROW( vmc96->response.data[ i + 2 ] );
-			unsigned char col = VMC96_GET_MOTOR_COL( vmc96->response.data[ i + 2 ] );
+	ret = vmc96_decode_motor_status( &response, status );
 
-			status->array.motor[ row ][ col ] = 1;
-		}
-	}
+	if( ret == VMC96_SUCCESS )
+		VMC96_STATUS_PAGE_UPDATE( vmc96, VMC96_STATUS_PAGE_MOTOR_STATUS, status, response.timestamp_us );
 
-	return VMC96_SUCCESS;
+	return ret;
 }
 
 
 int vmc96_motor_stop_all( VMC96_t * vmc96 )
 {
-	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STOP_ALL );
+	return vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STOP_ALL, NULL );
 }
 
 
@@ -394,7 +962,7 @@ int vmc96_motor_run( VMC96_t * vmc96, unsigned char row, unsigned char col )
 	if( !VMC96_VALIDATE_MOTOR_COORDINATE( row, col) )
 		return VMC96_ERROR_INVALID_MOTOR_COORDINATES;
 
-	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, &data, 1 );
+	return vmc96_send_k1( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, &data, 1, vmc96->frames.motor_run[ row ][ col ], NULL );
 }
 
 
@@ -405,349 +973,3176 @@ int vmc96_motor_pair_run( VMC96_t * vmc96, unsigned char row, unsigned char col1
 	if( !VMC96_VALIDATE_MOTOR_COORDINATE( row, col1 ) || !VMC96_VALIDATE_MOTOR_COORDINATE( row, col2 ) )
 		return VMC96_ERROR_INVALID_MOTOR_COORDINATES;
 
-	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, data, 2 );
+	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, data, 2, NULL );
 }
 
 
-int vmc96_motor_opto_line_status( VMC96_t * vmc96, VMC96_opto_line_sample_block_t * status_block )
+int vmc96_motor_run_set( VMC96_t * vmc96, const VMC96_motor_array_t * set )
 {
 	int ret = 0;
-	int i = 0;
-	int j = 0;
-	int k = 0;
-
-	memset( status_block, 0, sizeof(VMC96_opto_line_sample_block_t) );
+	int count = 0;
+	int sent = 0;
+	int chunk = 0;
+	int limit = 0;
+	unsigned char row = 0;
+	unsigned char col = 0;
+	unsigned char data[ VMC96_MOTOR_RUN_MAX_MOTORS_PER_FRAME ];
 
-	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS );
+	for( row = 0; row < VMC96_MOTOR_ARRAY_ROWS_COUNT; row++ )
+		for( col = 0; col < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; col++ )
+			if( set->motor[ row ][ col ] )
+				data[ count++ ] = VMC96_GET_MOTOR_ID( row, col );
 
-	if( ret != VMC96_SUCCESS )
-		return ret;
+	/* Keep the whole set (and the frame size discovery) atomic to other threads */
+	VMC96_LOCK( vmc96 );
 
-	for( i = 0; i < 4; i++ )
+	while( sent < count )
 	{
-		for( j = 0; j < 8; j++ )
+		limit = vmc96->motor_run_max_per_frame;
+
+		/* After a refusal the limit lies between the largest accepted and the smallest refused length: bisect */
+		if( (limit < VMC96_MOTOR_RUN_MAX_MOTORS_PER_FRAME) && (vmc96->motor_run_max_accepted < limit) )
+			limit = ( vmc96->motor_run_max_accepted + limit + 1 ) / 2;
+
+		/* Motors must not start after a stop: the rest of the set gives way */
+		if( VMC96_BUS_URGENT_PENDING( vmc96 ) )
+		{
+			ret = VMC96_ERROR_COMMAND_PREEMPTED;
+			break;
+		}
+
+		chunk = count - sent;
+
+		if( chunk > limit )
+			chunk = limit;
+
+		ret = vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, data + sent, chunk, NULL );
+
+		if( ret == VMC96_SUCCESS )
 		{
-			status_block->sample[ k++ ] = (vmc96->response.data[ i + 1 ] >> j) & 0x01;
+			if( chunk > vmc96->motor_run_max_accepted )
+				vmc96->motor_run_max_accepted = chunk;
+
+			sent += chunk;
+			continue;
 		}
+
+		/*
+		 * Only a NAK proves the motors were not started, anything else
+		 * (timeout, unreadable response) may follow a frame the board
+		 * already executed: only the retry engine, after a status read,
+		 * may resend it.
+		 */
+		if( ret != VMC96_ERROR_K1_RESPONSE_NEGATIVE_ACK )
+			break;
+
+		/* A frame length that was already accepted once can not be rejected because of its size */
+		if( (chunk == 1) || (chunk <= vmc96->motor_run_max_accepted) )
+			break;
+
+		/* Maybe too long for the firmware: no longer frame is tried, the next one bisects */
+		vmc96->motor_run_max_per_frame = chunk - 1;
 	}
 
-	return VMC96_SUCCESS;
+	VMC96_UNLOCK( vmc96 );
+
+	return ( sent < count ) ? ret : VMC96_SUCCESS;
 }
 
 
-int vmc96_motor_scan_array( VMC96_t * vmc96, VMC96_motor_array_scan_result_t * result )
+int vmc96_motor_opto_line_status( VMC96_t * vmc96, VMC96_opto_line_sample_block_t * status_block )
 {
 	int ret = 0;
+	vmc96_message_t response;
+
+	memset( status_block, 0, sizeof(VMC96_opto_line_sample_block_t) );
+
+	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS, &response );
+
+	if( ret != VMC96_SUCCESS )
+		return ret;
+
+	ret = vmc96_decode_opto_line_status( &response, status_block );
+
+	if( ret == VMC96_SUCCESS )
+		VMC96_STATUS_PAGE_UPDATE( vmc96, VMC96_STATUS_PAGE_OPTO_LINE, status_block, response.timestamp_us );
+
+	return ret;
+}
+
+
+int vmc96_motor_scan_array( VMC96_t * vmc96, VMC96_motor_array_scan_result_t * result )
+{
+	int ret = 0;
+	vmc96_message_t response;
+
+	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_SCAN_ARRAY, &response );
+
+	if( ret != VMC96_SUCCESS )
+		return ret;
+
+	ret = vmc96_decode_scan_array( &response, result );
+
+	if( ret == VMC96_SUCCESS )
+		VMC96_STATUS_PAGE_UPDATE( vmc96, VMC96_STATUS_PAGE_SCAN, result, response.timestamp_us );
+
+	return ret;
+}
+
+
+int vmc96_motor_give_pulse( VMC96_t * vmc96, unsigned char row, unsigned char col, unsigned char duration_ms )
+{
+	unsigned char data[2] = { VMC96_GET_MOTOR_ID( row, col ), duration_ms };
+
+	if( !VMC96_VALIDATE_MOTOR_COORDINATE( row, col) )
+		return VMC96_ERROR_INVALID_MOTOR_COORDINATES;
+
+	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_GIVE_PULSE, data, 2, NULL );
+}
+
+
+/* ********************************************************************* */
+/* *                         RESPONSE DECODERS                         * */
+/* ********************************************************************* */
+
+static int vmc96_decode_motor_status( const vmc96_message_t * response, VMC96_motor_array_status_t * status )
+{
+	int i = 0;
+
+	if( response->data_length >= 2 )
+	{
+		if( response->data[0] != VMC96_COMMAND_MOTOR_STATUS_REQUEST )
+			return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+
+		status->current_ma = VMC96_GET_MOTOR_CURRENT_MA( response->data[1] );
+
+		status->active_count = response->data_length - 2;
+
+		memset( &status->array, 0, sizeof(VMC96_motor_array_t) );
+
+		for( i = 0; i < response->data_length - 2; i++ )
+		{
+			unsigned char row = VMC96_GET_MOTOR_ROW( response->data[ i + 2 ] );
+			unsigned char col = VMC96_GET_MOTOR_COL( response->data[ i + 2 ] );
+
+			status->array.motor[ row ][ col ] = 1;
+		}
+	}
+
+	return VMC96_SUCCESS;
+}
+
+
+static int vmc96_decode_opto_line_status( const vmc96_message_t * response, VMC96_opto_line_sample_block_t * status_block )
+{
+	int i = 0;
+	int j = 0;
+	int k = 0;
+
+	for( i = 0; i < 4; i++ )
+	{
+		for( j = 0; j < 8; j++ )
+		{
+			status_block->sample[ k++ ] = (response->data[ i + 1 ] >> j) & 0x01;
+		}
+	}
+
+	return VMC96_SUCCESS;
+}
+
+
+static int vmc96_decode_scan_array( const vmc96_message_t * response, VMC96_motor_array_scan_result_t * result )
+{
 	unsigned char row = 0;
 	unsigned char col = 0;
 
-	ret = vmc96_send_message( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_SCAN_ARRAY );
+	if( response->data[0] != VMC96_COMMAND_MOTOR_SCAN_ARRAY )
+		return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+
+	memset( &result->array, 0, sizeof(VMC96_motor_array_scan_result_t) );
+
+	for( row = 0; row < VMC96_MOTOR_ARRAY_ROWS_COUNT; row++ )
+	{
+		for( col = 0; col < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; col++ )
+		{
+			result->array.motor[ row ][ col ] = ( response->data[ 1 + col ] >> row ) & 0x1;
+
+			if( result->array.motor[ row ][ col ] )
+				result->count++;
+		}
+	}
+
+	return VMC96_SUCCESS;
+}
+
+
+/* ********************************************************************* */
+/* *                 GLOBAL COMMANDS CONTROL FUNCTION                  * */
+/* ********************************************************************* */
+
+int vmc96_global_reset( VMC96_t * vmc96 )
+{
+	unsigned char data = VMC96_GLOBAL_RESET_DATA;
+	return vmc96_send_k1( vmc96, VMC96_CONTROLLER_GLOBAL_BROADCAST, VMC96_COMMAND_GLOBAL_RESET, &data, 1, vmc96->frames.command[ VMC96_K1_SLOT_GLOBAL_BASE ], NULL );
+}
+
+
+/* ********************************************************************* */
+/* *                          RETRY POLICY                             * */
+/* ********************************************************************* */
+
+int vmc96_set_retry_policy( VMC96_t * vmc96, const VMC96_retry_policy_t * policy )
+{
+	if( (policy->max_attempts == 0) || (policy->backoff_multiplier == 0) || (policy->backoff_max_ms < policy->backoff_ms) )
+		return VMC96_ERROR_INVALID_RETRY_POLICY;
+
+	VMC96_LOCK( vmc96 );
+	vmc96->retry_policy = *policy;
+	VMC96_UNLOCK( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_get_retry_stats( VMC96_t * vmc96, VMC96_retry_stats_t * stats )
+{
+	VMC96_LOCK( vmc96 );
+	*stats = vmc96->retry_stats;
+	VMC96_UNLOCK( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+static int vmc96_k1_retry_class( VMC96_t * vmc96 )
+{
+	switch( vmc96->message.id_controller )
+	{
+		case VMC96_CONTROLLER_GLOBAL_BROADCAST:
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_GLOBAL_RESET : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				default                         : return VMC96_K1_RETRY_CLASS_NONE;
+			}
+		}
+
+		case VMC96_CONTROLLER_RELAY_1 :
+		case VMC96_CONTROLLER_RELAY_2 :
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_RESET          : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_SIMPLE_PING    : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_KERNEL_VERSION : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_RELAY_FUNCTION : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				default                           : return VMC96_K1_RETRY_CLASS_NONE;
+			}
+		}
+
+		case VMC96_CONTROLLER_MOTOR_ARRAY:
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_RESET                  : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_SIMPLE_PING            : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_KERNEL_VERSION         : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_MOTOR_RUN              : return VMC96_K1_RETRY_CLASS_VERIFY;
+				case VMC96_COMMAND_MOTOR_STOP_ALL         : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_MOTOR_STATUS_REQUEST   : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				case VMC96_COMMAND_MOTOR_GIVE_PULSE       : return VMC96_K1_RETRY_CLASS_VERIFY;
+				case VMC96_COMMAND_MOTOR_SCAN_ARRAY       : return VMC96_K1_RETRY_CLASS_IDEMPOTENT;
+				default                                   : return VMC96_K1_RETRY_CLASS_NONE;
+			}
+		}
+
+		default:
+		{
+			return VMC96_K1_RETRY_CLASS_NONE;
+		}
+	}
+}
+
+
+static int vmc96_k1_retry_verify( VMC96_t * vmc96, vmc96_message_t * request )
+{
+	int ret = 0;
+	int i = 0;
+	int j = 0;
+	int running = 0;
+	unsigned char length = 0;
+
+	/* Ask the motor array what is running right now */
+	vmc96->message.id_controller = VMC96_CONTROLLER_MOTOR_ARRAY;
+	vmc96->message.command = VMC96_COMMAND_MOTOR_STATUS_REQUEST;
+	vmc96->message.data_length = 0;
+
+	vmc96_prepare_k1_message( vmc96 );
+
+	vmc96->retry_stats.status_checks++;
+
+	ret = vmc96_k1_transaction( vmc96 );
+
+	/* Restore the original request before anything else */
+	memcpy( &vmc96->message, request, sizeof(vmc96_message_t) );
+
+	if( ret != VMC96_SUCCESS )
+		return ret;
+
+	if( (vmc96->response.data_length < 2) || (vmc96->response.data[0] != VMC96_COMMAND_MOTOR_STATUS_REQUEST) )
+		return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+
+	if( request->command == VMC96_COMMAND_MOTOR_GIVE_PULSE )
+	{
+		for( i = 2; i < vmc96->response.data_length; i++ )
+			if( vmc96->response.data[i] == request->data[0] )
+				return VMC96_SUCCESS;
+
+		/* Not running: only proves the pulse never started while it would still be running */
+		if( vmc96->response.timestamp_us - request->timestamp_us < request->data[1] * 1000ULL )
+			return VMC96_K1_RETRY_RESEND;
+
+		return VMC96_K1_RETRY_ABORT;
+	}
+
+	/* Motor run: resend only the motors that did not start */
+	for( i = 0; i < request->data_length; i++ )
+	{
+		running = 0;
+
+		for( j = 2; j < vmc96->response.data_length; j++ )
+			if( vmc96->response.data[j] == request->data[i] )
+				running = 1;
+
+		if( !running )
+			vmc96->message.data[ length++ ] = request->data[i];
+	}
+
+	if( length == 0 )
+		return VMC96_SUCCESS;
+
+	vmc96->message.data_length = length;
+
+	vmc96_prepare_k1_message( vmc96 );
+
+	return VMC96_K1_RETRY_RESEND;
+}
+
+
+static int vmc96_k1_retry( VMC96_t * vmc96, int ret )
+{
+	vmc96_message_t request;
+	unsigned int attempt = 1;
+	unsigned int backoff = vmc96->retry_policy.backoff_ms;
+	int cls = vmc96_k1_retry_class( vmc96 );
+	int verify = 0;
+	int slot = 0;
+	int error = ret;
+
+	if( cls == VMC96_K1_RETRY_CLASS_NONE )
+		return ret;
+
+	memcpy( &request, &vmc96->message, sizeof(vmc96_message_t) );
+
+	while( VMC96_K1_TRANSIENT_ERROR( ret ) && (attempt < vmc96->retry_policy.max_attempts) )
+	{
+		/* A waiting safety command gets the bus after one frame, not after the retries */
+		if( VMC96_BUS_URGENT_PENDING( vmc96 ) &&
+			(vmc96_k1_command_class( vmc96->message.id_controller, vmc96->message.command ) != VMC96_BUS_CLASS_URGENT) )
+			break;
+
+		attempt++;
+		error = ret;
+
+		if( backoff > 0 )
+		{
+			VMC96_SLEEP_MS( backoff );
+
+			/* Clamp before multiplying so the delay never wraps */
+			if( backoff > vmc96->retry_policy.backoff_max_ms / vmc96->retry_policy.backoff_multiplier )
+				backoff = vmc96->retry_policy.backoff_max_ms;
+			else
+				backoff *= vmc96->retry_policy.backoff_multiplier;
+		}
+
+		if( cls == VMC96_K1_RETRY_CLASS_VERIFY )
+		{
+			verify = vmc96_k1_retry_verify( vmc96, &request );
+
+			if( verify == VMC96_K1_RETRY_ABORT )
+			{
+				ret = error;
+				break;
+			}
+
+			if( verify == VMC96_SUCCESS )
+				vmc96->retry_stats.verified++;
+
+			if( verify != VMC96_K1_RETRY_RESEND )
+			{
+				ret = verify;
+				continue;
+			}
+
+			/* Later verifications compare against the frame actually resent */
+			memcpy( &request, &vmc96->message, sizeof(vmc96_message_t) );
+		}
+
+		vmc96->retry_stats.retries++;
+
+		slot = vmc96_k1_command_slot( vmc96->message.id_controller, vmc96->message.command );
+
+		if( slot != VMC96_K1_SLOT_INVALID )
+		{
+			vmc96_stats_write_begin( vmc96 );
+			vmc96->stats.command[ slot ].retries++;
+			vmc96_stats_write_end( vmc96 );
+		}
+
+		VMC96_DEBUG_BUFFER( "K1-RETRY", vmc96->message.k1, vmc96->message.k1_length );
+
+		vmc96->retrying = 1;
+		ret = vmc96_k1_transaction( vmc96 );
+		vmc96->retrying = 0;
+
+		if( cls == VMC96_K1_RETRY_CLASS_VERIFY )
+			request.timestamp_us = vmc96->message.timestamp_us;
+	}
+
+	if( ret == VMC96_SUCCESS )
+		vmc96->retry_stats.recovered++;
+	else
+		vmc96->retry_stats.exhausted++;
+
+	return ret;
+}
+
+
+/* ********************************************************************* */
+/* *                            STATISTICS                             * */
+/* ********************************************************************* */
+
+static const int vmc96_stats_error_codes[ VMC96_STATS_ERRORS_COUNT ] =
+{
+	VMC96_ERROR_FTDI_WRITE_DATA,
+	VMC96_ERROR_FTDI_READ_DATA,
+	VMC96_ERROR_FTDI_PURGE_BUFFERS,
+	VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM,
+	VMC96_ERROR_K1_RESPONSE_NEGATIVE_ACK,
+	VMC96_ERROR_K1_RESPONSE_MALFORMED,
+	VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE,
+	VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH,
+	VMC96_ERROR_K1_RESPONSE_TIMEOUT
+};
+
+/* Controller/command pair of each K1 slot, in vmc96_k1_command_slot() order */
+static const unsigned char vmc96_stats_command_slots[ VMC96_K1_SLOTS_COUNT ][ 2 ] =
+{
+	{ VMC96_CONTROLLER_GLOBAL_BROADCAST, VMC96_COMMAND_GLOBAL_RESET },
+	{ VMC96_CONTROLLER_RELAY_1, VMC96_COMMAND_RESET },
+	{ VMC96_CONTROLLER_RELAY_1, VMC96_COMMAND_SIMPLE_PING },
+	{ VMC96_CONTROLLER_RELAY_1, VMC96_COMMAND_KERNEL_VERSION },
+	{ VMC96_CONTROLLER_RELAY_1, VMC96_COMMAND_RELAY_FUNCTION },
+	{ VMC96_CONTROLLER_RELAY_2, VMC96_COMMAND_RESET },
+	{ VMC96_CONTROLLER_RELAY_2, VMC96_COMMAND_SIMPLE_PING },
+	{ VMC96_CONTROLLER_RELAY_2, VMC96_COMMAND_KERNEL_VERSION },
+	{ VMC96_CONTROLLER_RELAY_2, VMC96_COMMAND_RELAY_FUNCTION },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_RESET },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_SIMPLE_PING },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_KERNEL_VERSION },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STOP_ALL },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_STATUS_REQUEST },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_GIVE_PULSE },
+	{ VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_SCAN_ARRAY }
+};
+
+/* VMC96_stats_t.command[] is filled from this table slot by slot */
+_Static_assert( VMC96_STATS_COMMANDS_COUNT == VMC96_K1_SLOTS_COUNT, "VMC96_STATS_COMMANDS_COUNT must match VMC96_K1_SLOTS_COUNT" );
+
+
+static unsigned long long vmc96_monotonic_ns( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ((unsigned long long) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+
+static int vmc96_histogram_bucket( unsigned long long ns )
+{
+	int msb = 0;
+	int bucket = 0;
+
+	if( ns < VMC96_HISTOGRAM_SUB_BUCKETS )
+		return (int) ns;
+
+	msb = 63 - __builtin_clzll( ns );
+	bucket = (msb - VMC96_HISTOGRAM_SUB_BUCKET_BITS + 1) * VMC96_HISTOGRAM_SUB_BUCKETS +
+		(int)((ns >> (msb - VMC96_HISTOGRAM_SUB_BUCKET_BITS)) & (VMC96_HISTOGRAM_SUB_BUCKETS - 1));
+
+	return ( bucket < VMC96_HISTOGRAM_BUCKETS ) ? bucket : VMC96_HISTOGRAM_BUCKETS - 1;
+}
+
+
+static unsigned long long vmc96_histogram_bucket_limit( int bucket )
+{
+	int shift = bucket / VMC96_HISTOGRAM_SUB_BUCKETS - 1;
+	unsigned long long sub = bucket % VMC96_HISTOGRAM_SUB_BUCKETS;
+
+	/* Upper (exclusive) limit of the bucket */
+	if( bucket < VMC96_HISTOGRAM_SUB_BUCKETS )
+		return bucket + 1;
+
+	return ( VMC96_HISTOGRAM_SUB_BUCKETS + sub + 1 ) << shift;
+}
+
+
+static void vmc96_histogram_record( VMC96_histogram_t * h, unsigned long long ns )
+{
+	h->bucket[ vmc96_histogram_bucket( ns ) ]++;
+
+	if( (h->count == 0) || (ns < h->min_ns) )
+		h->min_ns = ns;
+
+	if( ns > h->max_ns )
+		h->max_ns = ns;
+
+	h->sum_ns += ns;
+	h->count++;
+}
+
+
+static void vmc96_histogram_decay( VMC96_histogram_t * h )
+{
+	int i = 0;
+
+	if( h->count < VMC96_HISTOGRAM_DECAY_COUNT )
+		return;
+
+	/* Old samples weigh half: the distribution follows cable/board changes */
+	h->count = 0;
+	h->sum_ns >>= 1;
+
+	for( i = 0; i < VMC96_HISTOGRAM_BUCKETS; i++ )
+	{
+		h->bucket[i] >>= 1;
+		h->count += h->bucket[i];
+	}
+}
+
+
+unsigned long long vmc96_histogram_percentile( const VMC96_histogram_t * h, double percentile )
+{
+	unsigned long long target = (unsigned long long)( h->count * percentile / 100.0 + 0.5 );
+	unsigned long long sum = 0;
+	int i = 0;
+
+	for( i = 0; i < VMC96_HISTOGRAM_BUCKETS; i++ )
+	{
+		sum += h->bucket[i];
+
+		if( (sum >= target) && (sum > 0) )
+			return vmc96_histogram_bucket_limit( i );
+	}
+
+	return vmc96_histogram_bucket_limit( VMC96_HISTOGRAM_BUCKETS - 1 );
+}
+
+
+unsigned long long vmc96_histogram_count_below( const VMC96_histogram_t * h, unsigned long long ns )
+{
+	unsigned long long sum = 0;
+	int i = 0;
+
+	for( i = 0; (i < VMC96_HISTOGRAM_BUCKETS) && (vmc96_histogram_bucket_limit( i ) <= ns); i++ )
+		sum += h->bucket[i];
+
+	return sum;
+}
+
+
+static void vmc96_stats_write_begin( VMC96_t * vmc96 )
+{
+	__atomic_store_n( &vmc96->stats_sequence, vmc96->stats_sequence + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+
+static void vmc96_stats_write_end( VMC96_t * vmc96 )
+{
+	__atomic_store_n( &vmc96->stats_sequence, vmc96->stats_sequence + 1, __ATOMIC_RELEASE );
+}
+
+
+static void vmc96_stats_record( VMC96_t * vmc96, int ret, unsigned long long busy_ns )
+{
+	VMC96_command_stats_t * cs = NULL;
+	unsigned long long total = 0;
+	int slot = 0;
+	int i = 0;
+
+	vmc96_stats_write_begin( vmc96 );
+
+	vmc96->stats.busy_ns += busy_ns;
+
+	if( vmc96->timing_valid & (1 << VMC96_STATS_PHASE_WRITE) )
+		vmc96->stats.bytes_tx += vmc96->message.k1_length;
+
+	if( vmc96->timing_valid & (1 << VMC96_STATS_PHASE_LAST_BYTE) )
+		vmc96->stats.bytes_rx += vmc96->response.k1_length;
+
+	if( ret != VMC96_SUCCESS )
+	{
+		for( i = 0; i < VMC96_STATS_ERRORS_COUNT; i++ )
+			if( vmc96->stats.error[i].code == ret )
+				vmc96->stats.error[i].count++;
+	}
+
+	slot = vmc96_k1_command_slot( vmc96->message.id_controller, vmc96->message.command );
+
+	if( slot == VMC96_K1_SLOT_INVALID )
+	{
+		vmc96_stats_write_end( vmc96 );
+		return;
+	}
+
+	cs = &vmc96->stats.command[ slot ];
+
+	cs->requests++;
+
+	if( vmc96->timing_valid & (1 << VMC96_STATS_PHASE_WRITE) )
+		cs->bytes_tx += vmc96->message.k1_length;
+
+	if( vmc96->timing_valid & (1 << VMC96_STATS_PHASE_LAST_BYTE) )
+		cs->bytes_rx += vmc96->response.k1_length;
+
+	/* Latency histograms only hold complete transactions */
+	if( ret != VMC96_SUCCESS )
+	{
+		cs->errors++;
+		vmc96_stats_write_end( vmc96 );
+
+		/* A timeout took at least the deadline: without the sample a slower board could never raise the adaptive timeout */
+		if( (ret == VMC96_ERROR_K1_RESPONSE_TIMEOUT) && !vmc96->ping_timeout_ms )
+		{
+			vmc96_histogram_record( &vmc96->response_time[ slot ], vmc96->response_timeout_ms * 1000000ULL );
+			vmc96_histogram_decay( &vmc96->response_time[ slot ] );
+
+			if( vmc96->response_timeouts[ slot ] < VMC96_K1_RESPONSE_ADAPTIVE_MAX_TIMEOUTS )
+				vmc96->response_timeouts[ slot ]++;
+		}
+
+		return;
+	}
+
+	/* Any answer proves the controller alive, the health monitor skips its ping */
+	i = vmc96_health_index( vmc96->message.id_controller );
+
+	if( i >= 0 )
+		__atomic_store_n( &vmc96->last_seen_us[i], vmc96->response.timestamp_us, __ATOMIC_RELAXED );
+
+	for( i = 0; i < VMC96_STATS_PHASES_COUNT; i++ )
+	{
+		if( vmc96->timing_valid & (1 << i) )
+		{
+			vmc96_histogram_record( &cs->phase[i], vmc96->timing[i] );
+			total += vmc96->timing[i];
+		}
+	}
+
+	vmc96_histogram_record( &cs->total, total );
+
+	vmc96_stats_write_end( vmc96 );
+
+	/* Adaptive timeouts learn from write to last response byte */
+	vmc96_histogram_record( &vmc96->response_time[ slot ], ( vmc96->response.timestamp_us - vmc96->message.timestamp_us ) * 1000ULL );
+	vmc96_histogram_decay( &vmc96->response_time[ slot ] );
+	vmc96->response_timeouts[ slot ] = 0;
+}
+
+
+static void vmc96_stats_clear( VMC96_t * vmc96 )
+{
+	int i = 0;
+
+	vmc96_stats_write_begin( vmc96 );
+
+	memset( &vmc96->stats, 0, sizeof(VMC96_stats_t) );
+
+	for( i = 0; i < VMC96_K1_SLOTS_COUNT; i++ )
+	{
+		vmc96->stats.command[i].id_controller = vmc96_stats_command_slots[i][0];
+		vmc96->stats.command[i].command = vmc96_stats_command_slots[i][1];
+	}
+
+	for( i = 0; i < VMC96_STATS_ERRORS_COUNT; i++ )
+		vmc96->stats.error[i].code = vmc96_stats_error_codes[i];
+
+	vmc96->stats.since_us = vmc96_monotonic_us();
+
+	vmc96_stats_write_end( vmc96 );
+}
+
+
+int vmc96_get_stats( VMC96_t * vmc96, VMC96_stats_t * stats )
+{
+	unsigned int sequence = 0;
+	int i = 0;
+
+	/* Scrapers and pollers copy while the bus keeps running, a torn copy is simply retried */
+	for( i = 1; ; i++ )
+	{
+		sequence = __atomic_load_n( &vmc96->stats_sequence, __ATOMIC_ACQUIRE );
+
+		if( !(sequence & 1) )
+		{
+			memcpy( stats, &vmc96->stats, sizeof(VMC96_stats_t) );
+			__atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+			if( __atomic_load_n( &vmc96->stats_sequence, __ATOMIC_RELAXED ) == sequence )
+				return VMC96_SUCCESS;
+		}
+
+		/* Never the context lock (a transaction may hold it for up to a second): let the writer finish */
+		if( !(i % VMC96_STATS_READ_ATTEMPTS) )
+			VMC96_YIELD();
+	}
+}
+
+
+void vmc96_reset_stats( VMC96_t * vmc96 )
+{
+	VMC96_LOCK( vmc96 );
+	vmc96_stats_clear( vmc96 );
+	VMC96_UNLOCK( vmc96 );
+}
+
+
+/* ********************************************************************* */
+/* *                              TRACING                              * */
+/* ********************************************************************* */
+
+static void vmc96_trace_frame( VMC96_t * vmc96, int direction, const unsigned char * frame, int length, int result )
+{
+	unsigned long long now = vmc96_monotonic_ns();
+	unsigned int sequence = 0;
+	VMC96_trace_record_t * r = NULL;
+
+	if( vmc96->trace.flags & VMC96_TRACE_FLAG_CAPTURE )
+		vmc96_capture_frame( vmc96, now, direction, frame, length, result );
+
+	if( !(vmc96->trace.flags & VMC96_TRACE_FLAG_RING) )
+		return;
+
+	sequence = vmc96->trace.head + 1;
+	r = &vmc96->trace.ring[ (sequence - 1) & vmc96->trace.mask ];
+
+	/* Seqlock-style: a zero sequence marks the record as being rewritten */
+	__atomic_store_n( &r->sequence, 0, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+	r->timestamp_ns = now;
+	r->result = result;
+	r->direction = direction;
+	r->id_controller = vmc96->message.id_controller;
+	r->command = vmc96->message.command;
+	r->length = length;
+	memcpy( r->frame, frame, length );
+
+	__atomic_store_n( &r->sequence, sequence, __ATOMIC_RELEASE );
+	__atomic_store_n( &vmc96->trace.head, sequence, __ATOMIC_RELEASE );
+
+	if( vmc96->trace.callback )
+		vmc96->trace.callback( vmc96, r, vmc96->trace.userdata );
+}
+
+
+int vmc96_trace_start( VMC96_t * vmc96, unsigned int records, VMC96_trace_callback_t callback, void * userdata )
+{
+	VMC96_trace_record_t * ring = NULL;
+
+	if( records && ( (records & (records - 1)) || (records > VMC96_TRACE_MAX_RECORDS) ) )
+		return VMC96_ERROR_TRACE_INVALID_SIZE;
+
+	VMC96_LOCK( vmc96 );
+
+	/* vmc96_trace_dump() reads the ring without locking: once allocated it is never freed nor resized */
+	if( records && vmc96->trace.ring && (records != vmc96->trace.mask + 1) )
+	{
+		VMC96_UNLOCK( vmc96 );
+		return VMC96_ERROR_TRACE_INVALID_SIZE;
+	}
+
+	if( records && !vmc96->trace.ring )
+	{
+		ring = (VMC96_trace_record_t*) calloc( records, sizeof(VMC96_trace_record_t) );
+
+		if( !ring )
+		{
+			VMC96_UNLOCK( vmc96 );
+			return VMC96_ERROR_OUT_OF_MEMORY;
+		}
+
+		vmc96->trace.mask = records - 1;
+		vmc96->trace.head = 0;
+
+		/* Readers see the mask before the ring */
+		__atomic_store_n( &vmc96->trace.ring, ring, __ATOMIC_RELEASE );
+	}
+
+	if( !vmc96->trace.ring )
+	{
+		VMC96_UNLOCK( vmc96 );
+		return VMC96_ERROR_TRACE_NOT_ALLOCATED;
+	}
+
+	vmc96->trace.callback = callback;
+	vmc96->trace.userdata = userdata;
+	vmc96->trace.flags |= VMC96_TRACE_FLAG_RING;
+
+	VMC96_UNLOCK( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+void vmc96_trace_stop( VMC96_t * vmc96 )
+{
+	VMC96_LOCK( vmc96 );
+	vmc96->trace.flags &= ~VMC96_TRACE_FLAG_RING;
+	VMC96_UNLOCK( vmc96 );
+}
+
+
+int vmc96_trace_dump( VMC96_t * vmc96, int fd )
+{
+	VMC96_trace_dump_header_t header;
+	VMC96_trace_record_t record;
+	const VMC96_trace_record_t * ring = NULL;
+	unsigned int mask = 0;
+	unsigned int head = 0;
+	unsigned int count = 0;
+	unsigned int sequence = 0;
+	unsigned int i = 0;
+
+	ring = __atomic_load_n( &vmc96->trace.ring, __ATOMIC_ACQUIRE );
+
+	if( !ring )
+		return VMC96_ERROR_TRACE_NOT_ALLOCATED;
+
+	mask = vmc96->trace.mask;
+	head = __atomic_load_n( &vmc96->trace.head, __ATOMIC_ACQUIRE );
+	count = ( head > mask ) ? mask + 1 : head;
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, VMC96_TRACE_DUMP_MAGIC, sizeof(header.magic) );
+	header.version = VMC96_TRACE_DUMP_VERSION;
+	header.record_size = sizeof(VMC96_trace_record_t);
+	header.records = count;
+	header.dropped = head - count;
+
+	if( VMC96_WRITE_FD( fd, &header, sizeof(header) ) != sizeof(header) )
+		return VMC96_ERROR_SYSTEM_CALL;
+
+	for( i = head - count + 1; count > 0; i++, count-- )
+	{
+		const VMC96_trace_record_t * r = &ring[ (i - 1) & mask ];
+
+		sequence = __atomic_load_n( &r->sequence, __ATOMIC_ACQUIRE );
+		memcpy( &record, r, sizeof(record) );
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+		/* Overwritten while dumping: keep the layout, mark the record invalid */
+		if( (sequence != i) || (__atomic_load_n( &r->sequence, __ATOMIC_RELAXED ) != i) )
+			memset( &record, 0, sizeof(record) );
+
+		if( VMC96_WRITE_FD( fd, &record, sizeof(record) ) != sizeof(record) )
+			return VMC96_ERROR_SYSTEM_CALL;
+	}
+
+	return VMC96_SUCCESS;
+}
+
+
+static void vmc96_capture_frame( VMC96_t * vmc96, unsigned long long timestamp_ns, int direction, const unsigned char * frame, int length, int result )
+{
+	unsigned char buf[ sizeof(VMC96_capture_record_t) + VMC96_K1_MESSAGE_MAX_LEN ];
+	VMC96_capture_record_t * record = (VMC96_capture_record_t*) buf;
+	unsigned long long now_us = timestamp_ns / 1000;
+	unsigned long long delta_us = now_us - vmc96->trace.capture_last_us;
+	int size = sizeof(VMC96_capture_record_t) + length;
+
+	record->delta_us = ( delta_us > 0xFFFFFFFFULL ) ? 0xFFFFFFFF : (unsigned int) delta_us;
+	record->result = result;
+	record->direction = direction;
+	record->length = length;
+	memcpy( buf + sizeof(VMC96_capture_record_t), frame, length );
+
+	vmc96->trace.capture_last_us = now_us;
+
+	/* A failing capture must not break the command path: stop recording */
+	if( VMC96_WRITE_FD( vmc96->trace.capture_fd, buf, size ) != size )
+	{
+		vmc96->trace.capture_error = 1;
+		vmc96->trace.flags &= ~VMC96_TRACE_FLAG_CAPTURE;
+	}
+}
+
+
+int vmc96_capture_start( VMC96_t * vmc96, int fd, const char * board_id )
+{
+	VMC96_capture_header_t header;
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, VMC96_CAPTURE_MAGIC, sizeof(header.magic) );
+	header.version = VMC96_CAPTURE_VERSION;
+	header.start_us = vmc96_monotonic_us();
+
+	if( board_id )
+		strncpy( header.board_id, board_id, VMC96_CAPTURE_BOARD_ID_MAX_LEN - 1 );
+
+	VMC96_LOCK( vmc96 );
+
+	if( VMC96_WRITE_FD( fd, &header, sizeof(header) ) != sizeof(header) )
+	{
+		VMC96_UNLOCK( vmc96 );
+		return VMC96_ERROR_CAPTURE_WRITE;
+	}
+
+	vmc96->trace.capture_fd = fd;
+	vmc96->trace.capture_error = 0;
+	vmc96->trace.capture_last_us = header.start_us;
+	vmc96->trace.flags |= VMC96_TRACE_FLAG_CAPTURE;
+
+	VMC96_UNLOCK( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_capture_stop( VMC96_t * vmc96 )
+{
+	int ret = VMC96_SUCCESS;
+
+	VMC96_LOCK( vmc96 );
+
+	vmc96->trace.flags &= ~VMC96_TRACE_FLAG_CAPTURE;
+
+	if( vmc96->trace.capture_error )
+		ret = VMC96_ERROR_CAPTURE_WRITE;
+
+	VMC96_UNLOCK( vmc96 );
+
+	return ret;
+}
+
+
+/* ********************************************************************* */
+/* *                            STATUS PAGE                            * */
+/* ********************************************************************* */
+
+static void vmc96_status_page_update( VMC96_t * vmc96, int field, const void * value, size_t size, unsigned long long response_us )
+{
+	VMC96_status_page_t * page = NULL;
+	void * dest = NULL;
+	unsigned int sequence = 0;
+
+	/* Its own lock: reads never queue behind the bus just to copy their result */
+	pthread_mutex_lock( &vmc96->status_page_lock );
+
+	page = vmc96->status_page;
+
+	if( !page )
+	{
+		pthread_mutex_unlock( &vmc96->status_page_lock );
+		return;
+	}
+
+	switch( field )
+	{
+		case VMC96_STATUS_PAGE_MOTOR_STATUS : dest = &page->motor_status; break;
+		case VMC96_STATUS_PAGE_OPTO_LINE    : dest = &page->opto_line; break;
+		case VMC96_STATUS_PAGE_SCAN         : dest = &page->scan; break;
+		case VMC96_STATUS_PAGE_RELAY1       : dest = &page->relay_state[0]; break;
+		case VMC96_STATUS_PAGE_RELAY2       : dest = &page->relay_state[1]; break;
+		default                             : dest = NULL; break;
+	}
+
+	/* Pollers publish after the bus is released: a response older than the published one lost the race */
+	if( !dest || (response_us < page->updated_us[ field ]) )
+	{
+		pthread_mutex_unlock( &vmc96->status_page_lock );
+		return;
+	}
+
+	/* Seqlock: an odd sequence tells readers a write is in progress (single writer: the page lock holder) */
+	sequence = page->sequence;
+
+	__atomic_store_n( &page->sequence, sequence + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+	memcpy( dest, value, size );
+	page->updated_us[ field ] = response_us;
+	page->valid |= ( 1U << field );
+
+	__atomic_store_n( &page->sequence, sequence + 2, __ATOMIC_RELEASE );
+
+	pthread_mutex_unlock( &vmc96->status_page_lock );
+}
+
+
+/* Shared memory, pids and /proc: the status page is only published on Linux */
+#ifdef __linux__
+
+static unsigned long long vmc96_process_start_time( int pid )
+{
+	char path[ 64 ];
+	char stat[ 1024 ];
+	char * p = NULL;
+	unsigned long long start = 0;
+	size_t n = 0;
+	int field = 0;
+	FILE * fp = NULL;
+
+	snprintf( path, sizeof(path), "/proc/%d/stat", pid );
+
+	fp = fopen( path, "r" );
+
+	if( !fp )
+		return 0;
+
+	n = fread( stat, 1, sizeof(stat) - 1, fp );
+	fclose( fp );
+	stat[n] = '\0';
+
+	/* The command name may hold spaces and parentheses: fields are counted after the last ')' */
+	p = strrchr( stat, ')' );
+
+	/* Field 3 (state) follows the name, the start time is field 22 */
+	for( field = 2; p && (field < 22); field++ )
+		p = strchr( p + 1, ' ' );
+
+	if( p )
+		start = strtoull( p + 1, NULL, 10 );
+
+	return start;
+}
+
+
+static int vmc96_status_page_in_use( VMC96_t * vmc96, const char * name )
+{
+	const VMC96_status_page_t * page = NULL;
+	unsigned long long start = 0;
+	unsigned long long now = 0;
+	int pid = 0;
+
+	if( vmc96_status_page_open( name, &page ) != VMC96_SUCCESS )
+		return 0;
+
+	pid = __atomic_load_n( &page->publisher_pid, __ATOMIC_RELAXED );
+	start = __atomic_load_n( &page->publisher_start, __ATOMIC_RELAXED );
+
+	vmc96_status_page_close( page );
+
+	/* Republished by this same context */
+	if( (pid == (int) getpid()) && vmc96->status_page && !strcmp( vmc96->status_page_name, name ) )
+		return 0;
+
+	if( (pid <= 0) || ((kill( (pid_t) pid, 0 ) < 0) && (errno != EPERM)) )
+		return 0;
+
+	/* A live pid with another start time is a later process that reused it */
+	now = vmc96_process_start_time( pid );
+
+	return !start || !now || (start == now);
+}
+
+
+int vmc96_status_page_publish( VMC96_t * vmc96, const char * name )
+{
+	VMC96_status_page_t * page = NULL;
+	int fd = -1;
+
+	if( !name || (strlen( name ) >= VMC96_STATUS_PAGE_NAME_MAX_LEN) )
+		return VMC96_ERROR_STATUS_PAGE_INVALID;
+
+	if( vmc96_status_page_in_use( vmc96, name ) )
+		return VMC96_ERROR_STATUS_PAGE_IN_USE;
+
+	/* Before the unlink below: republishing the same name must not remove the new page */
+	vmc96_status_page_unpublish( vmc96 );
+
+	/* A page left by a crashed publisher is replaced, not reused (its readers keep the old mapping) */
+	shm_unlink( name );
+
+	fd = shm_open( name, O_CREAT | O_EXCL | O_RDWR, 0644 );
+
+	if( fd < 0 )
+		return VMC96_ERROR_SYSTEM_CALL;
+
+	if( ftruncate( fd, sizeof(VMC96_status_page_t) ) < 0 )
+	{
+		close( fd );
+		shm_unlink( name );
+		return VMC96_ERROR_SYSTEM_CALL;
+	}
+
+	page = (VMC96_status_page_t*) mmap( NULL, sizeof(VMC96_status_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+	close( fd );
+
+	if( page == MAP_FAILED )
+	{
+		shm_unlink( name );
+		return VMC96_ERROR_SYSTEM_CALL;
+	}
+
+	page->version = VMC96_STATUS_PAGE_VERSION;
+	page->publisher_pid = (int) getpid();
+	page->publisher_start = vmc96_process_start_time( page->publisher_pid );
+
+	/* Readers validate the magic last */
+	__atomic_store_n( &page->magic, VMC96_STATUS_PAGE_MAGIC, __ATOMIC_RELEASE );
+
+	pthread_mutex_lock( &vmc96->status_page_lock );
+	strcpy( vmc96->status_page_name, name );
+	vmc96->status_page = page;
+	pthread_mutex_unlock( &vmc96->status_page_lock );
+
+	return VMC96_SUCCESS;
+}
+
+
+void vmc96_status_page_unpublish( VMC96_t * vmc96 )
+{
+	VMC96_status_page_t * page = NULL;
+
+	/* Once cleared under the page lock no writer can still hold the mapping */
+	pthread_mutex_lock( &vmc96->status_page_lock );
+	page = vmc96->status_page;
+	vmc96->status_page = NULL;
+	pthread_mutex_unlock( &vmc96->status_page_lock );
+
+	if( !page )
+		return;
+
+	munmap( page, sizeof(VMC96_status_page_t) );
+	shm_unlink( vmc96->status_page_name );
+}
+
+
+int vmc96_status_page_open( const char * name, const VMC96_status_page_t ** page )
+{
+	VMC96_status_page_t * p = NULL;
+	struct stat st;
+	int fd = -1;
+
+	*page = NULL;
+
+	fd = shm_open( name, O_RDONLY, 0 );
+
+	if( fd < 0 )
+		return VMC96_ERROR_STATUS_PAGE_INVALID;
+
+	if( (fstat( fd, &st ) < 0) || (st.st_size < (off_t) sizeof(VMC96_status_page_t)) )
+	{
+		close( fd );
+		return VMC96_ERROR_STATUS_PAGE_INVALID;
+	}
+
+	p = (VMC96_status_page_t*) mmap( NULL, sizeof(VMC96_status_page_t), PROT_READ, MAP_SHARED, fd, 0 );
+
+	close( fd );
+
+	if( p == MAP_FAILED )
+		return VMC96_ERROR_SYSTEM_CALL;
+
+	if( (__atomic_load_n( &p->magic, __ATOMIC_ACQUIRE ) != VMC96_STATUS_PAGE_MAGIC) || (p->version != VMC96_STATUS_PAGE_VERSION) )
+	{
+		munmap( p, sizeof(VMC96_status_page_t) );
+		return VMC96_ERROR_STATUS_PAGE_INVALID;
+	}
+
+	*page = p;
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_status_page_read( const VMC96_status_page_t * page, VMC96_status_page_t * snapshot )
+{
+	unsigned int sequence = 0;
+	unsigned int i = 0;
+
+	for( i = 0; i < VMC96_STATUS_PAGE_READ_SPINS; i++ )
+	{
+		sequence = __atomic_load_n( &page->sequence, __ATOMIC_ACQUIRE );
+
+		if( sequence & 1 )
+			continue;
+
+		memcpy( snapshot, page, sizeof(VMC96_status_page_t) );
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+		if( __atomic_load_n( &page->sequence, __ATOMIC_RELAXED ) == sequence )
+		{
+			snapshot->sequence = sequence;
+			return VMC96_SUCCESS;
+		}
+	}
+
+	return VMC96_ERROR_STATUS_PAGE_BUSY;
+}
+
+
+void vmc96_status_page_close( const VMC96_status_page_t * page )
+{
+	if( page )
+		munmap( (void*) page, sizeof(VMC96_status_page_t) );
+}
+
+#else
+
+int vmc96_status_page_publish( VMC96_t * vmc96, const char * name )
+{
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
+
+
+void vmc96_status_page_unpublish( VMC96_t * vmc96 )
+{
+}
+
+
+int vmc96_status_page_open( const char * name, const VMC96_status_page_t ** page )
+{
+	*page = NULL;
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
+
+
+int vmc96_status_page_read( const VMC96_status_page_t * page, VMC96_status_page_t * snapshot )
+{
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
+
+
+void vmc96_status_page_close( const VMC96_status_page_t * page )
+{
+}
+
+#endif
+
+
+/* ********************************************************************* */
+/* *                        ADAPTIVE TIMEOUTS                          * */
+/* ********************************************************************* */
+
+static int vmc96_k1_command_slot( unsigned char id_controller, unsigned char command )
+{
+	int relay = 0;
+
+	switch( id_controller )
+	{
+		case VMC96_CONTROLLER_GLOBAL_BROADCAST:
+		{
+			switch( command )
+			{
+				case VMC96_COMMAND_GLOBAL_RESET : return VMC96_K1_SLOT_GLOBAL_BASE;
+				default                         : return VMC96_K1_SLOT_INVALID;
+			}
+		}
+
+		case VMC96_CONTROLLER_RELAY_1 :
+		case VMC96_CONTROLLER_RELAY_2 :
+		{
+			relay = VMC96_K1_SLOT_RELAY_BASE + (id_controller - VMC96_CONTROLLER_RELAY_1) * VMC96_K1_SLOT_RELAY_COUNT;
+
+			switch( command )
+			{
+				case VMC96_COMMAND_RESET          : return relay + 0;
+				case VMC96_COMMAND_SIMPLE_PING    : return relay + 1;
+				case VMC96_COMMAND_KERNEL_VERSION : return relay + 2;
+				case VMC96_COMMAND_RELAY_FUNCTION : return relay + 3;
+				default                           : return VMC96_K1_SLOT_INVALID;
+			}
+		}
+
+		case VMC96_CONTROLLER_MOTOR_ARRAY:
+		{
+			switch( command )
+			{
+				case VMC96_COMMAND_RESET                  : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 0;
+				case VMC96_COMMAND_SIMPLE_PING            : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 1;
+				case VMC96_COMMAND_KERNEL_VERSION         : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 2;
+				case VMC96_COMMAND_MOTOR_RUN              : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 3;
+				case VMC96_COMMAND_MOTOR_STOP_ALL         : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 4;
+				case VMC96_COMMAND_MOTOR_STATUS_REQUEST   : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 5;
+				case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 6;
+				case VMC96_COMMAND_MOTOR_GIVE_PULSE       : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 7;
+				case VMC96_COMMAND_MOTOR_SCAN_ARRAY       : return VMC96_K1_SLOT_MOTOR_ARRAY_BASE + 8;
+				default                                   : return VMC96_K1_SLOT_INVALID;
+			}
+		}
+
+		default:
+		{
+			return VMC96_K1_SLOT_INVALID;
+		}
+	}
+}
+
+
+static unsigned int vmc96_k1_response_timeout( VMC96_t * vmc96 )
+{
+	int slot = 0;
+	unsigned long long timeout_us = 0;
+	const VMC96_histogram_t * h = NULL;
+
+	if( vmc96->ping_timeout_ms )
+		return vmc96->ping_timeout_ms;
+
+	/* A retry never reuses the deadline that just expired */
+	if( (vmc96->timeout_policy.mode != VMC96_TIMEOUT_MODE_ADAPTIVE) || vmc96->retrying )
+		return VMC96_K1_RESPONSE_TIMEOUT_MS;
+
+	slot = vmc96_k1_command_slot( vmc96->message.id_controller, vmc96->message.command );
+
+	if( slot == VMC96_K1_SLOT_INVALID )
+		return VMC96_K1_RESPONSE_TIMEOUT_MS;
+
+	/* The slot keeps the fixed timeout until it answers again */
+	if( vmc96->response_timeouts[ slot ] >= VMC96_K1_RESPONSE_ADAPTIVE_MAX_TIMEOUTS )
+		return VMC96_K1_RESPONSE_TIMEOUT_MS;
+
+	h = &vmc96->response_time[ slot ];
+
+	if( h->count < vmc96->timeout_policy.min_samples )
+		return VMC96_K1_RESPONSE_TIMEOUT_MS;
+
+	timeout_us = vmc96_histogram_percentile( h, vmc96->timeout_policy.percentile ) / 1000 * vmc96->timeout_policy.safety_factor;
+
+	if( timeout_us >= VMC96_K1_RESPONSE_TIMEOUT_MS * 1000ULL )
+		return VMC96_K1_RESPONSE_TIMEOUT_MS;
+
+	if( timeout_us < vmc96->timeout_policy.floor_ms * 1000ULL )
+		return vmc96->timeout_policy.floor_ms;
+
+	return (unsigned int)( ( timeout_us + 999 ) / 1000 );
+}
+
+
+int vmc96_set_timeout_policy( VMC96_t * vmc96, const VMC96_timeout_policy_t * policy )
+{
+	if( (policy->mode != VMC96_TIMEOUT_MODE_FIXED) && (policy->mode != VMC96_TIMEOUT_MODE_ADAPTIVE) )
+		return VMC96_ERROR_INVALID_TIMEOUT_POLICY;
+
+	if( (policy->mode == VMC96_TIMEOUT_MODE_ADAPTIVE) &&
+		((policy->percentile <= 0.0) || (policy->percentile > 100.0) || (policy->safety_factor < 1.0) || (policy->min_samples == 0)) )
+		return VMC96_ERROR_INVALID_TIMEOUT_POLICY;
+
+	/* A floor above the fixed timeout would make adaptive mode slower than fixed mode */
+	if( (policy->mode == VMC96_TIMEOUT_MODE_ADAPTIVE) && (policy->floor_ms > VMC96_K1_RESPONSE_TIMEOUT_MS) )
+		return VMC96_ERROR_INVALID_TIMEOUT_POLICY;
+
+	VMC96_LOCK( vmc96 );
+	vmc96->timeout_policy = *policy;
+	VMC96_UNLOCK( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+/* ********************************************************************* */
+/* *                    MESSAGE CONTROL FUNCTIONS                      * */
+/* ********************************************************************* */
+
+static unsigned char vmc96_calculate_checksum( const unsigned char * buf, size_t buflen )
+{
+	unsigned char sum = 0;
+	unsigned long i = 0;
+
+	for( i = 0; i < buflen; i++ )
+		sum ^= buf[i];
+
+	return sum;
+}
+
+
+static void vmc96_k1_encode( unsigned char * k1, unsigned char id_controller, unsigned char command, const unsigned char * data, unsigned char data_length )
+{
+	unsigned char length = data_length + VMC96_K1_MESSAGE_MIN_LEN;
+
+	/* K1 Message STX Header Field */
+	k1[0] = VMC96_K1_MESSAGE_STX;
+
+	/* K1 Message: Controller Address/ID Field */
+	k1[1] = id_controller;
+
+	/* K1 Message: Total Length Field */
+	k1[2] = length;
+
+	/* K1 Message: Command Code Field */
+	k1[3] = command;
+
+	/* K1 Message: Data Field */
+	if( data_length > 0 )
+		memcpy( &k1[4], data, data_length );
+
+	/* K1 Message: Checksum Field */
+	k1[ length - 1 ] = vmc96_calculate_checksum( k1, length - 1 );
+}
+
+
+static void vmc96_frame_table_build( vmc96_frame_table_t * table )
+{
+	static const unsigned char controllers[] = { VMC96_CONTROLLER_RELAY_1, VMC96_CONTROLLER_RELAY_2, VMC96_CONTROLLER_MOTOR_ARRAY };
+	static const unsigned char commands[] = { VMC96_COMMAND_SIMPLE_PING, VMC96_COMMAND_KERNEL_VERSION, VMC96_COMMAND_RESET,
+		VMC96_COMMAND_MOTOR_STATUS_REQUEST, VMC96_COMMAND_MOTOR_SCAN_ARRAY, VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS, VMC96_COMMAND_MOTOR_STOP_ALL };
+	unsigned char data = 0;
+	unsigned int i = 0;
+	unsigned int j = 0;
+	int slot = 0;
+
+	memset( table, 0, sizeof(vmc96_frame_table_t) );
+
+	/* Requests without data (RELAY_FUNCTION shares 0x11 with SCAN_ARRAY: relays only take it with a state) */
+	for( i = 0; i < sizeof(controllers); i++ )
+	{
+		for( j = 0; j < sizeof(commands); j++ )
+		{
+			slot = vmc96_k1_command_slot( controllers[i], commands[j] );
+
+			if( (slot == VMC96_K1_SLOT_INVALID) || ((controllers[i] != VMC96_CONTROLLER_MOTOR_ARRAY) && (commands[j] == VMC96_COMMAND_RELAY_FUNCTION)) )
+				continue;
+
+			vmc96_k1_encode( table->command[ slot ], controllers[i], commands[j], NULL, 0 );
+		}
+	}
+
+	data = VMC96_GLOBAL_RESET_DATA;
+	vmc96_k1_encode( table->command[ VMC96_K1_SLOT_GLOBAL_BASE ], VMC96_CONTROLLER_GLOBAL_BROADCAST, VMC96_COMMAND_GLOBAL_RESET, &data, 1 );
+
+	for( i = 0; i < VMC96_MOTOR_ARRAY_ROWS_COUNT; i++ )
+	{
+		for( j = 0; j < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; j++ )
+		{
+			data = VMC96_GET_MOTOR_ID( i, j );
+			vmc96_k1_encode( table->motor_run[i][j], VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_RUN, &data, 1 );
+		}
+	}
+
+	for( i = 0; i < VMC96_FRAME_TABLE_RELAYS_COUNT; i++ )
+	{
+		for( data = 0; data < 2; data++ )
+			vmc96_k1_encode( table->relay[i][data], VMC96_CONTROLLER_RELAY_BASE_ADDRESS + i, VMC96_COMMAND_RELAY_FUNCTION, &data, 1 );
+	}
+}
+
+
+static const unsigned char * vmc96_frame_table_lookup( VMC96_t * vmc96, unsigned char id_controller, unsigned char command )
+{
+	int slot = vmc96_k1_command_slot( id_controller, command );
+
+	if( slot == VMC96_K1_SLOT_INVALID )
+		return NULL;
+
+	/* Empty entries and frames with a payload are not requests without data */
+	if( vmc96->frames.command[ slot ][2] != VMC96_K1_MESSAGE_MIN_LEN )
+		return NULL;
+
+	return vmc96->frames.command[ slot ];
+}
+
+
+static int vmc96_prepare_k1_message( VMC96_t * vmc96 )
+{
+	unsigned long long start = vmc96_monotonic_ns();
+
+	vmc96->message.k1_length = vmc96->message.data_length + VMC96_K1_MESSAGE_MIN_LEN;
+
+	vmc96_k1_encode( vmc96->message.k1, vmc96->message.id_controller, vmc96->message.command, vmc96->message.data, vmc96->message.data_length );
+
+	vmc96->timing[ VMC96_STATS_PHASE_ENCODE ] = vmc96_monotonic_ns() - start;
+	vmc96->timing_valid = 1 << VMC96_STATS_PHASE_ENCODE;
+
+	return VMC96_SUCCESS;
+}
+
+
+static int vmc96_k1_parse_response_type( VMC96_t * vmc96 )
+{
+	switch( vmc96->message.id_controller )
+	{
+		case VMC96_CONTROLLER_GLOBAL_BROADCAST:
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_GLOBAL_RESET : return VMC96_K1_RESPONSE_TYPE_ACK;
+				default                         : return VMC96_K1_RESPONSE_TYPE_INVALID;
+			}
+		}
+
+		case VMC96_CONTROLLER_RELAY_1 :
+		case VMC96_CONTROLLER_RELAY_2 :
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_RESET          : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_SIMPLE_PING    : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_KERNEL_VERSION : return VMC96_K1_RESPONSE_TYPE_DATA;
+				case VMC96_COMMAND_RELAY_FUNCTION : return VMC96_K1_RESPONSE_TYPE_ACK;
+				default                           : return VMC96_K1_RESPONSE_TYPE_INVALID;
+			}
+		}
+
+		case VMC96_CONTROLLER_MOTOR_ARRAY:
+		{
+			switch( vmc96->message.command )
+			{
+				case VMC96_COMMAND_RESET                  : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_SIMPLE_PING            : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_KERNEL_VERSION         : return VMC96_K1_RESPONSE_TYPE_DATA;
+				case VMC96_COMMAND_MOTOR_RUN              : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_MOTOR_STOP_ALL         : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_MOTOR_STATUS_REQUEST   : return VMC96_K1_RESPONSE_TYPE_DATA;
+				case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS : return VMC96_K1_RESPONSE_TYPE_DATA;
+				case VMC96_COMMAND_MOTOR_GIVE_PULSE       : return VMC96_K1_RESPONSE_TYPE_ACK;
+				case VMC96_COMMAND_MOTOR_SCAN_ARRAY       : return VMC96_K1_RESPONSE_TYPE_DATA;
+				default                                   : return VMC96_K1_RESPONSE_TYPE_INVALID;
+			}
+		}
+
+		default:
+		{
+			return VMC96_K1_RESPONSE_TYPE_INVALID;
+		}
+	}
+}
+
+
+static int vmc96_parse_k1_response( VMC96_t * vmc96 )
+{
+	switch( vmc96_k1_parse_response_type( vmc96 ) )
+	{
+		case VMC96_K1_RESPONSE_TYPE_ACK:
+		{
+			/* K1 Response: Validate Positive ACK Message Len */
+			if( vmc96->response.k1_length != VMC96_K1_MESSAGE_MIN_LEN )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+
+			/* K1 Response: Parse Source Controller ID/Address Field */
+			vmc96->response.id_controller = vmc96->response.k1[1];
+
+			/* K1 Response: Data Field Empty */
+			memset( vmc96->response.data, 0, VMC96_K1_MESSAGE_DATA_MAX_LEN );
+			vmc96->response.data_length = 0;
+
+			/* K1 Response: Validating STX Header Field */
+			if( vmc96->response.k1[0] != VMC96_K1_MESSAGE_STX )
+				return VMC96_ERROR_K1_RESPONSE_MALFORMED;
+
+			/* K1 Response: Validate Source Controller ID/Address Field */
+			if( vmc96->response.k1[1] != vmc96->message.id_controller )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+
+			/* K1 Response: Validate Positive ACK Message Len */
+			if( vmc96->response.k1[2] != VMC96_K1_MESSAGE_MIN_LEN )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+
+			/* K1 Response: Validate Checksum */
+			if( vmc96->response.k1[4] != vmc96_calculate_checksum( vmc96->response.k1, vmc96->response.k1_length - 1 ) )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM;
+
+			/* K1 Response: Validate Positive ACK Field */
+			if( vmc96->response.k1[3] != VMC96_K1_RESPONSE_POSITIVE_ACK )
+				return VMC96_ERROR_K1_RESPONSE_NEGATIVE_ACK;
+
+			return VMC96_SUCCESS;
+		}
+
+		case VMC96_K1_RESPONSE_TYPE_DATA:
+		{
+			/* K1 Response: Validating Message Length */
+			if( vmc96->response.k1_length < VMC96_K1_MESSAGE_MIN_LEN )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+
+			/* K1 Response: Parse Source Controller ID/Address Field */
+			vmc96->response.id_controller = vmc96->response.k1[1];
+
+			/* K1 Response: Parse Total Data Length Field */
+			vmc96->response.data_length = vmc96->response.k1[2] - 4;
+
+			/* K1 Response: Parse Data Field */
+			memcpy( vmc96->response.data, &vmc96->response.k1[3], vmc96->response.data_length );
+
+			/* K1 Response: Validating STX Header Field */
+			if( vmc96->response.k1[0] != VMC96_K1_MESSAGE_STX )
+				return VMC96_ERROR_K1_RESPONSE_MALFORMED;
+
+			/* K1 Response: Validate Source Controller ID/Address Field */
+			if( vmc96->response.k1[1] != vmc96->message.id_controller )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+
+			/* K1 Response: Validate Total Length Field */
+			if( vmc96->response.k1[2] != vmc96->response.k1_length )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+
+			/* K1 Response: Validate Checksum */
+			if( vmc96->response.k1[ vmc96->response.k1_length - 1 ] != vmc96_calculate_checksum( vmc96->response.k1, vmc96->response.k1_length - 1 ) )
+				return VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM;
+
+			return VMC96_SUCCESS;
+		}
+
+		default:
+		{
+			return VMC96_ERROR_K1_RESPONSE_MALFORMED;
+		}
+	}
+}
+
+
+static int vmc96_send_k1_message( VMC96_t * vmc96 )
+{
+	int ret = 0;
+	int length = 0;
+	unsigned int timeout_ms = vmc96_k1_response_timeout( vmc96 );
+	unsigned int delay_ms = vmc96->transport.read_delay_ms;
+	unsigned long long deadline = 0;
+	unsigned long long t0 = 0;
+	unsigned long long t1 = 0;
+	unsigned long long t2 = 0;
+
+	if( (vmc96->timeout_policy.mode == VMC96_TIMEOUT_MODE_ADAPTIVE) && (delay_ms > VMC96_K1_RESPONSE_ADAPTIVE_READ_DELAY_MS) )
+		delay_ms = VMC96_K1_RESPONSE_ADAPTIVE_READ_DELAY_MS;
+
+	vmc96->response_timeout_ms = timeout_ms;
+
+	t0 = vmc96_monotonic_ns();
+
+	ret = vmc96->transport.purge( vmc96->transport.userdata );
+
+	if( ret < 0 )
+		return VMC96_ERROR_FTDI_PURGE_BUFFERS;
+
+	t1 = vmc96_monotonic_ns();
+
+	ret = vmc96->transport.write( vmc96->transport.userdata, vmc96->message.k1, vmc96->message.k1_length );
+
+	VMC96_TRACE( vmc96, VMC96_TRACE_DIRECTION_TX, vmc96->message.k1, vmc96->message.k1_length, ( ret < 0 ) ? VMC96_ERROR_FTDI_WRITE_DATA : VMC96_SUCCESS );
+
+	if( ret < 0 )
+		return VMC96_ERROR_FTDI_WRITE_DATA;
+
+	/* Only frames that reached the transport get a send timestamp */
+	vmc96->message.timestamp_us = t1 / 1000;
+
+	t2 = vmc96_monotonic_ns();
+
+	vmc96->timing[ VMC96_STATS_PHASE_PURGE ] = t1 - t0;
+	vmc96->timing[ VMC96_STATS_PHASE_WRITE ] = t2 - t1;
+	vmc96->timing_valid |= (1 << VMC96_STATS_PHASE_PURGE) | (1 << VMC96_STATS_PHASE_WRITE);
+
+	deadline = vmc96->message.timestamp_us + timeout_ms * 1000ULL;
+
+	do
+	{
+		if( delay_ms )
+			VMC96_SLEEP_MS( delay_ms );
+
+		ret = vmc96->transport.read( vmc96->transport.userdata, vmc96->response.k1 + length, VMC96_K1_MESSAGE_MAX_LEN - length );
+
+		if( ret < 0 )
+			return VMC96_ERROR_FTDI_READ_DATA;
+
+		if( ret == 0 )
+			continue;
+
+		if( length == 0 )
+		{
+			t1 = vmc96_monotonic_ns();
+			vmc96->timing[ VMC96_STATS_PHASE_FIRST_BYTE ] = t1 - t2;
+
+			/* The rest of the frame is at most a few bytes times away */
+			if( delay_ms > VMC96_K1_RESPONSE_ADAPTIVE_READ_DELAY_MS )
+				delay_ms = VMC96_K1_RESPONSE_ADAPTIVE_READ_DELAY_MS;
+		}
+
+		length += ret;
+
+		/* Frame complete once the length field is satisfied (or can not be) */
+		if( (length >= 3) && ((length >= vmc96->response.k1[2]) || (vmc96->response.k1[2] < VMC96_K1_MESSAGE_MIN_LEN)) )
+			break;
+	}
+	while( vmc96_monotonic_us() < deadline );
+
+	if( length == 0 )
+		return VMC96_ERROR_K1_RESPONSE_TIMEOUT;
+
+	t2 = vmc96_monotonic_ns();
+
+	/* An incomplete frame is left for the parser to reject */
+	vmc96->response.timestamp_us = t2 / 1000;
+	vmc96->response.k1_length = length;
+	vmc96->timing[ VMC96_STATS_PHASE_LAST_BYTE ] = t2 - t1;
+	vmc96->timing_valid |= (1 << VMC96_STATS_PHASE_FIRST_BYTE) | (1 << VMC96_STATS_PHASE_LAST_BYTE);
+
+	return VMC96_SUCCESS;
+}
+
+
+static int vmc96_k1_transaction( VMC96_t * vmc96 )
+{
+	int ret = 0;
+	unsigned long long start = 0;
+	unsigned long long begin = vmc96_monotonic_ns();
+	unsigned long long end = 0;
+
+	ret = vmc96_send_k1_message( vmc96 );
+
+	if( ret == VMC96_SUCCESS )
+	{
+		VMC96_DEBUG_BUFFER( "K1-RESPONSE", vmc96->response.k1, vmc96->response.k1_length );
+
+		start = vmc96_monotonic_ns();
+
+		ret = vmc96_parse_k1_response( vmc96 );
+
+		vmc96->timing[ VMC96_STATS_PHASE_PARSE ] = vmc96_monotonic_ns() - start;
+		vmc96->timing_valid |= 1 << VMC96_STATS_PHASE_PARSE;
+
+		VMC96_TRACE( vmc96, VMC96_TRACE_DIRECTION_RX, vmc96->response.k1, vmc96->response.k1_length, ret );
+	}
+	else if( (ret == VMC96_ERROR_K1_RESPONSE_TIMEOUT) || (ret == VMC96_ERROR_FTDI_READ_DATA) )
+	{
+		VMC96_TRACE( vmc96, VMC96_TRACE_DIRECTION_RX, vmc96->response.k1, 0, ret );
+	}
+
+	end = vmc96_monotonic_ns();
+
+	vmc96_stats_record( vmc96, ret, end - begin );
+
+	__atomic_store_n( &vmc96->bus_idle_us, end / 1000, __ATOMIC_RELAXED );
+
+	/* A resend of the same frame has nothing left to encode */
+	vmc96->timing_valid = 0;
+
+	return ret;
+}
+
+
+static int vmc96_send_message( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, vmc96_message_t * response )
+{
+	return vmc96_send_k1( vmc96, id_cntlr, cmd, NULL, 0, vmc96_frame_table_lookup( vmc96, id_cntlr, cmd ), response );
+}
+
+
+int vmc96_k1_request( VMC96_t * vmc96, unsigned char id_controller, unsigned char command, const unsigned char * data, unsigned int data_length, unsigned char * response, unsigned int * response_length )
+{
+	int ret = 0;
+	vmc96_message_t resp;
+
+	if( data_length > VMC96_REQUEST_DATA_MAX_LEN )
+		return VMC96_ERROR_INVALID_REQUEST;
+
+	ret = vmc96_send_k1( vmc96, id_controller, command, data, data_length, data_length ? NULL : vmc96_frame_table_lookup( vmc96, id_controller, command ), &resp );
+
+	if( ret != VMC96_SUCCESS )
+		return ret;
+
+	if( response )
+		memcpy( response, resp.data, resp.data_length );
+
+	if( response_length )
+		*response_length = resp.data_length;
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_k1_request_frame( VMC96_t * vmc96, const unsigned char * frame, unsigned int length, unsigned char * response, unsigned int * response_length )
+{
+	int ret = 0;
+	vmc96_message_t resp;
+
+	if( !frame || (length < VMC96_K1_MESSAGE_MIN_LEN) || (length > VMC96_K1_MESSAGE_MAX_LEN) || (frame[0] != VMC96_K1_MESSAGE_STX) || (frame[2] != length) )
+		return VMC96_ERROR_INVALID_REQUEST;
+
+	/* A corrupted frame could still parse as a valid command on the board */
+	if( frame[ length - 1 ] != vmc96_calculate_checksum( frame, length - 1 ) )
+		return VMC96_ERROR_INVALID_REQUEST;
+
+	ret = vmc96_send_k1( vmc96, frame[1], frame[3], frame + 4, length - VMC96_K1_MESSAGE_MIN_LEN, frame, &resp );
+
+	if( ret != VMC96_SUCCESS )
+		return ret;
+
+	if( response )
+		memcpy( response, resp.data, resp.data_length );
+
+	if( response_length )
+		*response_length = resp.data_length;
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_k1_command_class( unsigned char id_controller, unsigned char command )
+{
+	if( (id_controller == VMC96_CONTROLLER_GLOBAL_BROADCAST) && (command == VMC96_COMMAND_GLOBAL_RESET) )
+		return VMC96_BUS_CLASS_URGENT;
+
+	if( (command == VMC96_COMMAND_SIMPLE_PING) || (command == VMC96_COMMAND_KERNEL_VERSION) )
+		return VMC96_BUS_CLASS_READ;
+
+	if( id_controller != VMC96_CONTROLLER_MOTOR_ARRAY )
+		return VMC96_BUS_CLASS_NORMAL;
+
+	switch( command )
+	{
+		case VMC96_COMMAND_MOTOR_STOP_ALL           : return VMC96_BUS_CLASS_URGENT;
+		case VMC96_COMMAND_MOTOR_RESET              : return VMC96_BUS_CLASS_URGENT;
+		case VMC96_COMMAND_MOTOR_STATUS_REQUEST     : return VMC96_BUS_CLASS_READ;
+		case VMC96_COMMAND_MOTOR_SCAN_ARRAY         : return VMC96_BUS_CLASS_READ;
+		case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS   : return VMC96_BUS_CLASS_READ;
+		default                                     : return VMC96_BUS_CLASS_NORMAL;
+	}
+}
+
+
+static int vmc96_bus_acquire( VMC96_t * vmc96, int cls )
+{
+	vmc96_bus_t * bus = &vmc96->bus;
+	unsigned int generation = 0;
+	int ret = VMC96_SUCCESS;
+
+	pthread_mutex_lock( &bus->lock );
+
+	/* Background engines and multi-frame calls hold the bus across a whole API call */
+	if( bus->depth && pthread_equal( bus->owner, pthread_self() ) )
+	{
+		bus->depth++;
+		pthread_mutex_unlock( &bus->lock );
+		return VMC96_SUCCESS;
+	}
+
+	if( cls == VMC96_BUS_CLASS_URGENT )
+	{
+		bus->urgent++;
+		bus->generation++;
+
+		/* Queued reads wake up to find themselves canceled */
+		pthread_cond_broadcast( &bus->cond );
+	}
+
+	generation = bus->generation;
+
+	/* Safety commands wait for the frame in flight only, everything else waits for them too */
+	while( bus->depth || ((cls != VMC96_BUS_CLASS_URGENT) && bus->urgent) )
+	{
+		if( (cls == VMC96_BUS_CLASS_READ) && (bus->generation != generation) )
+		{
+			ret = VMC96_ERROR_COMMAND_PREEMPTED;
+			break;
+		}
+
+		pthread_cond_wait( &bus->cond, &bus->lock );
+	}
+
+	if( ret == VMC96_SUCCESS )
+	{
+		if( cls == VMC96_BUS_CLASS_URGENT )
+			bus->urgent--;
+
+		bus->owner = pthread_self();
+		bus->depth = 1;
+	}
+
+	pthread_mutex_unlock( &bus->lock );
+
+	return ret;
+}
+
+
+static int vmc96_bus_try_acquire( VMC96_t * vmc96 )
+{
+	vmc96_bus_t * bus = &vmc96->bus;
+	int ret = VMC96_ERROR_COMMAND_PREEMPTED;
+
+	pthread_mutex_lock( &bus->lock );
+
+	if( !bus->depth && !bus->urgent )
+	{
+		bus->owner = pthread_self();
+		bus->depth = 1;
+		ret = VMC96_SUCCESS;
+	}
+
+	pthread_mutex_unlock( &bus->lock );
+
+	return ret;
+}
+
+
+static void vmc96_bus_release( VMC96_t * vmc96 )
+{
+	vmc96_bus_t * bus = &vmc96->bus;
+
+	pthread_mutex_lock( &bus->lock );
+
+	if( --bus->depth == 0 )
+		pthread_cond_broadcast( &bus->cond );
+
+	pthread_mutex_unlock( &bus->lock );
+}
+
+
+static int vmc96_flight_index( unsigned char id_controller, unsigned char command )
+{
+	if( command == VMC96_COMMAND_KERNEL_VERSION )
+	{
+		if( id_controller == VMC96_CONTROLLER_MOTOR_ARRAY )
+			return VMC96_FLIGHT_MOTOR_VERSION;
+
+		if( (id_controller == VMC96_CONTROLLER_RELAY_1) || (id_controller == VMC96_CONTROLLER_RELAY_2) )
+			return VMC96_FLIGHT_RELAY_VERSION + (id_controller - VMC96_CONTROLLER_RELAY_BASE_ADDRESS);
+
+		return VMC96_FLIGHT_NONE;
+	}
+
+	if( id_controller != VMC96_CONTROLLER_MOTOR_ARRAY )
+		return VMC96_FLIGHT_NONE;
+
+	switch( command )
+	{
+		case VMC96_COMMAND_MOTOR_STATUS_REQUEST     : return VMC96_FLIGHT_MOTOR_STATUS;
+		case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS   : return VMC96_FLIGHT_MOTOR_OPTO_LINE;
+		case VMC96_COMMAND_MOTOR_SCAN_ARRAY         : return VMC96_FLIGHT_MOTOR_SCAN;
+		default                                     : return VMC96_FLIGHT_NONE;
+	}
+}
+
+
+static int vmc96_flight_join( VMC96_t * vmc96, int slot, vmc96_message_t * response, int * result )
+{
+	vmc96_bus_t * bus = &vmc96->bus;
+	vmc96_flight_t * flight = &vmc96->flight[ slot ];
+	unsigned int generation = 0;
+
+	pthread_mutex_lock( &bus->lock );
+
+	/* The bus owner (sequencer, multi-frame calls) sends its own requests: a leader may be waiting for it */
+	if( bus->depth && pthread_equal( bus->owner, pthread_self() ) )
+	{
+		pthread_mutex_unlock( &bus->lock );
+		return -1;
+	}
+
+	if( !flight->active )
+	{
+		flight->active = 1;
+		pthread_mutex_unlock( &bus->lock );
+		return 0;
+	}
+
+	generation = flight->generation;
+	flight->followers++;
+
+	/* Completions are broadcast on the bus condition */
+	while( flight->generation == generation )
+		pthread_cond_wait( &bus->cond, &bus->lock );
+
+	*result = flight->result;
+
+	if( (*result == VMC96_SUCCESS) && (response != NULL) )
+		memcpy( response, &flight->response, sizeof(vmc96_message_t) );
+
+	pthread_mutex_unlock( &bus->lock );
+
+	return 1;
+}
+
+
+static void vmc96_flight_complete( VMC96_t * vmc96, int slot, int result )
+{
+	vmc96_bus_t * bus = &vmc96->bus;
+	vmc96_flight_t * flight = &vmc96->flight[ slot ];
+	unsigned int followers = 0;
+
+	pthread_mutex_lock( &bus->lock );
+
+	followers = flight->followers;
+
+	flight->result = result;
+
+	if( followers && (result == VMC96_SUCCESS) )
+		memcpy( &flight->response, &vmc96->response, sizeof(vmc96_message_t) );
+
+	flight->active = 0;
+	flight->followers = 0;
+	flight->generation++;
+
+	pthread_cond_broadcast( &bus->cond );
+	pthread_mutex_unlock( &bus->lock );
+
+	/* Bus holder (or canceled before taking it): counted like the other statistics, under the seqlock */
+	if( followers && (result != VMC96_ERROR_COMMAND_PREEMPTED) )
+	{
+		vmc96_stats_write_begin( vmc96 );
+		vmc96->stats.coalesced += followers;
+		vmc96_stats_write_end( vmc96 );
+	}
+}
+
+
+static int vmc96_send_message_ex( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, unsigned char * data, unsigned char datalen, vmc96_message_t * response )
+{
+	return vmc96_send_k1( vmc96, id_cntlr, cmd, data, datalen, NULL, response );
+}
+
+
+static int vmc96_send_k1( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, const unsigned char * data, unsigned char datalen, const unsigned char * frame, vmc96_message_t * response )
+{
+	unsigned long long start = 0;
+	int ret = 0;
+	int slot = VMC96_FLIGHT_NONE;
+	int role = 0;
+
+	/* Identical read already in flight: share its round trip */
+	if( !datalen )
+		slot = vmc96_flight_index( id_cntlr, cmd );
+
+	if( slot != VMC96_FLIGHT_NONE )
+	{
+		role = vmc96_flight_join( vmc96, slot, response, &ret );
+
+		if( role > 0 )
+			return ret;
+
+		if( role < 0 )
+			slot = VMC96_FLIGHT_NONE;
+	}
+
+	/* Announce the command: the health monitor gives up its idle slots */
+	__atomic_add_fetch( &vmc96->bus_waiters, 1, __ATOMIC_RELAXED );
+
+	ret = vmc96_bus_acquire( vmc96, vmc96_k1_command_class( id_cntlr, cmd ) );
+
+	__atomic_sub_fetch( &vmc96->bus_waiters, 1, __ATOMIC_RELAXED );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		/* Canceled by a safety command: so are the followers */
+		if( slot != VMC96_FLIGHT_NONE )
+			vmc96_flight_complete( vmc96, slot, ret );
+
+		return ret;
+	}
+
+	vmc96->message.id_controller = id_cntlr;
+	vmc96->message.command = cmd;
+
+	memset( vmc96->message.data, 0, VMC96_K1_MESSAGE_DATA_MAX_LEN );
+	vmc96->message.data_length = 0;
+
+	if( (data != NULL) && (datalen > 0) )
+	{
+		memcpy( vmc96->message.data, data, datalen );
+		vmc96->message.data_length = datalen;
+	}
+
+	if( frame != NULL )
+	{
+		/* Encoded by the caller (frame tables, compile-time frames): the checksum is trusted */
+		start = vmc96_monotonic_ns();
+
+		memcpy( vmc96->message.k1, frame, frame[2] );
+		vmc96->message.k1_length = frame[2];
+
+		vmc96->timing[ VMC96_STATS_PHASE_ENCODE ] = vmc96_monotonic_ns() - start;
+		vmc96->timing_valid = 1 << VMC96_STATS_PHASE_ENCODE;
+	}
+	else
+	{
+		ret = vmc96_prepare_k1_message( vmc96 );
+
+		if( ret != VMC96_SUCCESS )
+			goto unlock;
+	}
+
+	VMC96_DEBUG_BUFFER( "K1-MESSAGE", vmc96->message.k1, vmc96->message.k1_length );
+
+	ret = vmc96_k1_transaction( vmc96 );
+
+	if( VMC96_K1_TRANSIENT_ERROR( ret ) && (vmc96->retry_policy.max_attempts > 1) && !vmc96->ping_timeout_ms )
+		ret = vmc96_k1_retry( vmc96, ret );
+
+	/* Response is copied while locked, so concurrent callers never see each other's data */
+	if( (ret == VMC96_SUCCESS) && (response != NULL) )
+		memcpy( response, &vmc96->response, sizeof(vmc96_message_t) );
+
+unlock:
+
+	if( slot != VMC96_FLIGHT_NONE )
+		vmc96_flight_complete( vmc96, slot, ret );
+
+	VMC96_UNLOCK( vmc96 );
+
+	return ret;
+}
+
+
+/* ********************************************************************* */
+/* *                         TIMED SEQUENCER                           * */
+/* ********************************************************************* */
+
+static unsigned long long vmc96_monotonic_us( void )
+{
+	return vmc96_monotonic_ns() / 1000;
+}
+
+
+/* timerfd, eventfd and poll: the sequencer and the timer wheel are only available on Linux */
+#ifdef __linux__
+
+static int vmc96_execute_action( VMC96_t * vmc96, VMC96_sequence_step_t * step )
+{
+	switch( step->action )
+	{
+		case VMC96_SEQUENCE_ACTION_NONE           : return VMC96_SUCCESS;
+		case VMC96_SEQUENCE_ACTION_RELAY_ON       : return vmc96_relay_control( vmc96, step->id, 1 );
+		case VMC96_SEQUENCE_ACTION_RELAY_OFF      : return vmc96_relay_control( vmc96, step->id, 0 );
+		case VMC96_SEQUENCE_ACTION_MOTOR_RUN      : return vmc96_motor_run( vmc96, step->row, step->col );
+		case VMC96_SEQUENCE_ACTION_MOTOR_PULSE    : return vmc96_motor_give_pulse( vmc96, step->row, step->col, step->duration_ms );
+		case VMC96_SEQUENCE_ACTION_MOTOR_STOP_ALL : return vmc96_motor_stop_all( vmc96 );
+		case VMC96_SEQUENCE_ACTION_MOTOR_RESET    : return vmc96_motor_reset( vmc96 );
+		default                                   : return VMC96_ERROR_SEQUENCE_INVALID;
+	}
+}
+
+
+static void vmc96_execute_step( VMC96_t * vmc96, VMC96_sequence_step_t * step )
+{
+	/* Hold the context so the timestamp belongs to this step's frame */
+	VMC96_LOCK( vmc96 );
+
+	/* Stays zero when the action fails before a frame is written */
+	vmc96->message.timestamp_us = 0;
+
+	step->result = vmc96_execute_action( vmc96, step );
+	step->sent_us = vmc96->message.timestamp_us;
+
+	VMC96_UNLOCK( vmc96 );
+}
+
+
+static void * vmc96_sequencer_thread( void * arg )
+{
+	VMC96_t * vmc96 = (VMC96_t*) arg;
+	vmc96_sequencer_t * seq = &vmc96->sequencer;
+	struct itimerspec its;
+	struct pollfd fds[2];
+	struct timespec start;
+	unsigned long long expirations = 0;
+	unsigned int i = 0;
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+
+	memset( &its, 0, sizeof(its) );
+
+	fds[0].fd = seq->timer_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = seq->cancel_fd;
+	fds[1].events = POLLIN;
+
+	for( i = 0; i < seq->count; i++ )
+	{
+		VMC96_sequence_step_t * step = &seq->steps[i];
+
+		/* Absolute deadlines from the sequence start: late steps never push the next ones */
+		its.it_value.tv_sec = start.tv_sec + step->offset_ms / 1000;
+		its.it_value.tv_nsec = start.tv_nsec + (step->offset_ms % 1000) * 1000000L;
+
+		if( its.it_value.tv_nsec >= 1000000000L )
+		{
+			its.it_value.tv_sec++;
+			its.it_value.tv_nsec -= 1000000000L;
+		}
+
+		timerfd_settime( seq->timer_fd, TFD_TIMER_ABSTIME, &its, NULL );
+
+		while( poll( fds, 2, -1 ) < 0 )
+			continue;
+
+		if( fds[1].revents & POLLIN )
+			break;
+
+		if( read( seq->timer_fd, &expirations, sizeof(expirations) ) < 0 )
+		{
+			VMC96_DEBUG_MSG( "[DEBUG] Sequencer timer read failed.\n" );
+		}
+
+		vmc96_execute_step( vmc96, step );
+
+		if( (step->result != VMC96_SUCCESS) && (seq->result == VMC96_SUCCESS) )
+			seq->result = step->result;
+	}
+
+	for( ; i < seq->count; i++ )
+	{
+		seq->steps[i].result = VMC96_ERROR_SEQUENCE_CANCELED;
+
+		if( seq->result == VMC96_SUCCESS )
+			seq->result = VMC96_ERROR_SEQUENCE_CANCELED;
+	}
+
+	return NULL;
+}
+
+
+int vmc96_sequence_start( VMC96_t * vmc96, VMC96_sequence_step_t * steps, unsigned int count )
+{
+	vmc96_sequencer_t * seq = &vmc96->sequencer;
+	unsigned int i = 0;
+	int ret = VMC96_SUCCESS;
+
+	if( (steps == NULL) || (count == 0) )
+		return VMC96_ERROR_SEQUENCE_INVALID;
+
+	for( i = 1; i < count; i++ )
+	{
+		if( steps[i].offset_ms < steps[i - 1].offset_ms )
+			return VMC96_ERROR_SEQUENCE_INVALID;
+	}
+
+	/* Claim the sequencer before touching anything a running sequence owns */
+	pthread_mutex_lock( &seq->lock );
+
+	if( seq->running )
+	{
+		pthread_mutex_unlock( &seq->lock );
+		return VMC96_ERROR_SEQUENCE_BUSY;
+	}
+
+	seq->running = 1;
+
+	pthread_mutex_unlock( &seq->lock );
+
+	for( i = 0; i < count; i++ )
+	{
+		steps[i].result = VMC96_ERROR_SEQUENCE_CANCELED;
+		steps[i].sent_us = 0;
+	}
+
+	seq->timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+
+	if( seq->timer_fd < 0 )
+	{
+		ret = VMC96_ERROR_SYSTEM_CALL;
+		goto error_release;
+	}
+
+	seq->cancel_fd = eventfd( 0, EFD_CLOEXEC );
+
+	if( seq->cancel_fd < 0 )
+	{
+		close( seq->timer_fd );
+		ret = VMC96_ERROR_SYSTEM_CALL;
+		goto error_release;
+	}
+
+	seq->steps = steps;
+	seq->count = count;
+	seq->result = VMC96_SUCCESS;
+
+	if( pthread_create( &seq->thread, NULL, vmc96_sequencer_thread, vmc96 ) != 0 )
+	{
+		close( seq->timer_fd );
+		close( seq->cancel_fd );
+		ret = VMC96_ERROR_SYSTEM_CALL;
+		goto error_release;
+	}
+
+	return VMC96_SUCCESS;
+
+error_release:
+
+	pthread_mutex_lock( &seq->lock );
+	seq->running = 0;
+	pthread_mutex_unlock( &seq->lock );
+
+	return ret;
+}
+
+
+int vmc96_sequence_wait( VMC96_t * vmc96 )
+{
+	vmc96_sequencer_t * seq = &vmc96->sequencer;
+	int ret = VMC96_SUCCESS;
+
+	pthread_mutex_lock( &seq->lock );
+
+	/* Only one caller joins the thread */
+	if( !seq->running || seq->joining )
+	{
+		pthread_mutex_unlock( &seq->lock );
+		return VMC96_SUCCESS;
+	}
+
+	seq->joining = 1;
+
+	pthread_mutex_unlock( &seq->lock );
+
+	pthread_join( seq->thread, NULL );
+
+	ret = seq->result;
+
+	pthread_mutex_lock( &seq->lock );
+
+	close( seq->timer_fd );
+	close( seq->cancel_fd );
+
+	seq->joining = 0;
+	seq->running = 0;
+
+	pthread_mutex_unlock( &seq->lock );
+
+	return ret;
+}
+
+
+int vmc96_sequence_cancel( VMC96_t * vmc96 )
+{
+	vmc96_sequencer_t * seq = &vmc96->sequencer;
+	unsigned long long one = 1;
+	ssize_t ret = 0;
+
+	pthread_mutex_lock( &seq->lock );
+
+	if( !seq->running )
+	{
+		pthread_mutex_unlock( &seq->lock );
+		return VMC96_SUCCESS;
+	}
+
+	/* The descriptors are closed under the same lock */
+	ret = write( seq->cancel_fd, &one, sizeof(one) );
+
+	pthread_mutex_unlock( &seq->lock );
+
+	if( ret < 0 )
+		return VMC96_ERROR_SYSTEM_CALL;
+
+	vmc96_sequence_wait( vmc96 );
+
+	return VMC96_SUCCESS;
+}
+
+
+/* ********************************************************************* */
+/* *                           TIMER WHEEL                             * */
+/* ********************************************************************* */
+
+static unsigned long long vmc96_timer_wheel_now( vmc96_timer_wheel_t * wheel )
+{
+	return ( vmc96_monotonic_us() - wheel->start_us ) / ( VMC96_TIMER_RESOLUTION_MS * 1000ULL );
+}
+
+
+static void vmc96_timer_wheel_insert( vmc96_timer_wheel_t * wheel, vmc96_timer_t * t )
+{
+	unsigned long long delta = 0;
+	vmc96_timer_t ** head = NULL;
+	int level = 0;
+
+	if( t->expires < wheel->base )
+		t->expires = wheel->base;
+
+	/* Never beyond VMC96_TIMER_WHEEL_MAX_TICKS: vmc96_timer_schedule() rejects longer delays */
+	delta = t->expires - wheel->base;
+
+	/* Level N holds the timers expiring within the next 64^(N+1) ticks */
+	while( (level < VMC96_TIMER_WHEEL_LEVELS - 1) && (delta >> ((level + 1) * VMC96_TIMER_WHEEL_SLOT_BITS)) )
+		level++;
+
+	head = &wheel->slot[ level ][ VMC96_TIMER_WHEEL_INDEX( t->expires, level ) ];
+
+	t->prev = NULL;
+	t->next = *head;
+
+	if( *head )
+		(*head)->prev = t;
+
+	*head = t;
+
+	if( level == 0 )
+		wheel->level0_bitmap |= 1ULL << VMC96_TIMER_WHEEL_INDEX( t->expires, 0 );
+}
+
+
+static void vmc96_timer_wheel_unlink( vmc96_timer_wheel_t * wheel, vmc96_timer_t * t )
+{
+	int level = 0;
+	int idx = 0;
+
+	if( t->next )
+		t->next->prev = t->prev;
+
+	if( t->prev )
+	{
+		t->prev->next = t->next;
+		return;
+	}
+
+	/* Head of its slot: find the slot from the expiration tick */
+	for( level = 0; level < VMC96_TIMER_WHEEL_LEVELS; level++ )
+	{
+		idx = VMC96_TIMER_WHEEL_INDEX( t->expires, level );
+
+		if( wheel->slot[ level ][ idx ] == t )
+		{
+			wheel->slot[ level ][ idx ] = t->next;
+
+			if( (level == 0) && !t->next )
+				wheel->level0_bitmap &= ~(1ULL << idx);
+
+			return;
+		}
+	}
+}
+
+
+static void vmc96_timer_wheel_cascade( vmc96_timer_wheel_t * wheel, int level )
+{
+	int idx = VMC96_TIMER_WHEEL_INDEX( wheel->base, level );
+	vmc96_timer_t * t = wheel->slot[ level ][ idx ];
+	vmc96_timer_t * next = NULL;
+
+	wheel->slot[ level ][ idx ] = NULL;
+
+	for( ; t; t = next )
+	{
+		next = t->next;
+		vmc96_timer_wheel_insert( wheel, t );
+	}
+
+	/* Upper level slot wrapped as well */
+	if( (idx == 0) && (level < VMC96_TIMER_WHEEL_LEVELS - 1) )
+		vmc96_timer_wheel_cascade( wheel, level + 1 );
+}
+
+
+static vmc96_timer_t * vmc96_timer_wheel_advance( vmc96_timer_wheel_t * wheel, unsigned long long now )
+{
+	vmc96_timer_t * expired = NULL;
+	vmc96_timer_t * t = NULL;
+	int idx = 0;
+
+	while( wheel->base <= now )
+	{
+		idx = VMC96_TIMER_WHEEL_INDEX( wheel->base, 0 );
+
+		if( (idx == 0) && (wheel->base > 0) )
+			vmc96_timer_wheel_cascade( wheel, 1 );
+
+		/* Move the whole slot to the expired list */
+		while( (t = wheel->slot[0][ idx ]) != NULL )
+		{
+			wheel->slot[0][ idx ] = t->next;
+			t->pending = 0;
+			t->prev = NULL;
+			t->next = expired;
+			expired = t;
+		}
+
+		wheel->level0_bitmap &= ~(1ULL << idx);
+		wheel->base++;
+	}
+
+	return expired;
+}
+
+
+static unsigned long long vmc96_timer_wheel_next( vmc96_timer_wheel_t * wheel )
+{
+	int idx = VMC96_TIMER_WHEEL_INDEX( wheel->base, 0 );
+	unsigned long long pending = 0;
+
+	/* Nearest non-empty level 0 slot before the level 0 wrap */
+	pending = wheel->level0_bitmap >> idx;
+
+	if( pending )
+		return wheel->base + __builtin_ctzll( pending );
+
+	/* Otherwise wake up on the next cascade (right now if base itself is a cascade tick) */
+	return wheel->base + ( ( VMC96_TIMER_WHEEL_SLOTS - idx ) & VMC96_TIMER_WHEEL_SLOT_MASK );
+}
+
+
+static void vmc96_timer_wheel_arm( vmc96_timer_wheel_t * wheel, unsigned long long tick )
+{
+	struct itimerspec its;
+	unsigned long long us = wheel->start_us + tick * VMC96_TIMER_RESOLUTION_MS * 1000ULL;
+
+	memset( &its, 0, sizeof(its) );
+
+	its.it_value.tv_sec = us / 1000000ULL;
+	its.it_value.tv_nsec = ( us % 1000000ULL ) * 1000L;
+
+	/* Absolute zero would disarm the timer */
+	if( !its.it_value.tv_sec && !its.it_value.tv_nsec )
+		its.it_value.tv_nsec = 1;
+
+	timerfd_settime( wheel->timer_fd, TFD_TIMER_ABSTIME, &its, NULL );
+
+	wheel->armed = tick;
+}
+
+
+static void * vmc96_timer_wheel_thread( void * arg )
+{
+	VMC96_t * vmc96 = (VMC96_t*) arg;
+	vmc96_timer_wheel_t * wheel = &vmc96->wheel;
+	vmc96_timer_t * expired = NULL;
+	vmc96_timer_t * t = NULL;
+	struct pollfd fds[2];
+	unsigned long long value = 0;
+
+	fds[0].fd = wheel->timer_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = wheel->wake_fd;
+	fds[1].events = POLLIN;
+
+	pthread_mutex_lock( &wheel->lock );
+
+	while( !wheel->stop )
+	{
+		expired = vmc96_timer_wheel_advance( wheel, vmc96_timer_wheel_now( wheel ) );
+
+		/* Actions run unlocked so they can schedule or cancel other timers */
+		while( expired )
+		{
+			t = expired;
+			expired = t->next;
+
+			pthread_mutex_unlock( &wheel->lock );
+
+			vmc96_execute_step( vmc96, &t->action );
+
+			if( t->callback )
+				t->callback( vmc96, VMC96_TIMER_HANDLE( t - wheel->pool, t->generation ), &t->action, t->userdata );
+
+			pthread_mutex_lock( &wheel->lock );
+
+			t->next = wheel->free_list;
+			wheel->free_list = t;
+		}
+
+		vmc96_timer_wheel_arm( wheel, vmc96_timer_wheel_next( wheel ) );
+
+		pthread_mutex_unlock( &wheel->lock );
+
+		while( poll( fds, 2, -1 ) < 0 )
+			continue;
+
+		if( (fds[0].revents & POLLIN) && (read( wheel->timer_fd, &value, sizeof(value) ) < 0) )
+		{
+			VMC96_DEBUG_MSG( "[DEBUG] Timer wheel read failed.\n" );
+		}
+
+		if( (fds[1].revents & POLLIN) && (read( wheel->wake_fd, &value, sizeof(value) ) < 0) )
+		{
+			VMC96_DEBUG_MSG( "[DEBUG] Timer wheel wake up read failed.\n" );
+		}
+
+		pthread_mutex_lock( &wheel->lock );
+	}
+
+	pthread_mutex_unlock( &wheel->lock );
+
+	return NULL;
+}
+
+
+static int vmc96_timer_wheel_start( VMC96_t * vmc96 )
+{
+	vmc96_timer_wheel_t * wheel = &vmc96->wheel;
+	int i = 0;
+
+	wheel->pool = (vmc96_timer_t*) calloc( VMC96_TIMER_MAX_PENDING, sizeof(vmc96_timer_t) );
+
+	if( !wheel->pool )
+		return VMC96_ERROR_OUT_OF_MEMORY;
+
+	for( i = VMC96_TIMER_MAX_PENDING - 1; i >= 0; i-- )
+	{
+		wheel->pool[i].next = wheel->free_list;
+		wheel->free_list = &wheel->pool[i];
+	}
+
+	wheel->timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+	wheel->wake_fd = eventfd( 0, EFD_CLOEXEC );
+	wheel->start_us = vmc96_monotonic_us();
+
+	if( (wheel->timer_fd < 0) || (wheel->wake_fd < 0) ||
+		(pthread_create( &wheel->thread, NULL, vmc96_timer_wheel_thread, vmc96 ) != 0) )
+	{
+		if( wheel->timer_fd >= 0 )
+			close( wheel->timer_fd );
+
+		if( wheel->wake_fd >= 0 )
+			close( wheel->wake_fd );
+
+		free( wheel->pool );
+		wheel->pool = NULL;
+		wheel->free_list = NULL;
+
+		return VMC96_ERROR_SYSTEM_CALL;
+	}
+
+	wheel->running = 1;
+
+	return VMC96_SUCCESS;
+}
+
+
+static void vmc96_timer_wheel_destroy( VMC96_t * vmc96 )
+{
+	vmc96_timer_wheel_t * wheel = &vmc96->wheel;
+	unsigned long long one = 1;
+
+	if( wheel->running )
+	{
+		pthread_mutex_lock( &wheel->lock );
+		wheel->stop = 1;
+		pthread_mutex_unlock( &wheel->lock );
+
+		if( write( wheel->wake_fd, &one, sizeof(one) ) < 0 )
+		{
+			VMC96_DEBUG_MSG( "[DEBUG] Timer wheel wake up failed.\n" );
+		}
+
+		pthread_join( wheel->thread, NULL );
+
+		close( wheel->timer_fd );
+		close( wheel->wake_fd );
+		free( wheel->pool );
+	}
+}
+
+
+int vmc96_timer_schedule( VMC96_t * vmc96, unsigned int delay_ms, const VMC96_sequence_step_t * action,
+	VMC96_timer_callback_t callback, void * userdata, unsigned int * timer )
+{
+	vmc96_timer_wheel_t * wheel = &vmc96->wheel;
+	vmc96_timer_t * t = NULL;
+	unsigned long long one = 1;
+	unsigned long long expires = 0;
+	int wake = 0;
+	int ret = 0;
+
+	/* A clamped delay would fire early: a wrong action, not a slow one */
+	if( delay_ms > VMC96_TIMER_MAX_DELAY_MS )
+		return VMC96_ERROR_TIMER_INVALID_DELAY;
+
+	pthread_mutex_lock( &wheel->lock );
+
+	if( !wheel->running )
+	{
+		ret = vmc96_timer_wheel_start( vmc96 );
+
+		if( ret != VMC96_SUCCESS )
+		{
+			pthread_mutex_unlock( &wheel->lock );
+			return ret;
+		}
+	}
+
+	/* Round up: a timer never fires before its delay */
+	expires = vmc96_timer_wheel_now( wheel ) + ( delay_ms + VMC96_TIMER_RESOLUTION_MS - 1 ) / VMC96_TIMER_RESOLUTION_MS;
+
+	if( expires - wheel->base > VMC96_TIMER_WHEEL_MAX_TICKS )
+	{
+		pthread_mutex_unlock( &wheel->lock );
+		return VMC96_ERROR_TIMER_INVALID_DELAY;
+	}
+
+	t = wheel->free_list;
+
+	if( !t )
+	{
+		pthread_mutex_unlock( &wheel->lock );
+		return VMC96_ERROR_TIMER_POOL_EXHAUSTED;
+	}
+
+	wheel->free_list = t->next;
+
+	t->generation++;
+	t->pending = 1;
+	t->action = *action;
+	t->action.result = VMC96_ERROR_SEQUENCE_CANCELED;
+	t->action.sent_us = 0;
+	t->callback = callback;
+	t->userdata = userdata;
+
+	t->expires = expires;
+
+	vmc96_timer_wheel_insert( wheel, t );
+
+	/* Only wake the thread up if the new timer is due before it would wake up anyway */
+	wake = ( t->expires < wheel->armed );
+
+	if( timer )
+		*timer = VMC96_TIMER_HANDLE( t - wheel->pool, t->generation );
+
+	pthread_mutex_unlock( &wheel->lock );
+
+	if( wake && (write( wheel->wake_fd, &one, sizeof(one) ) < 0) )
+		return VMC96_ERROR_SYSTEM_CALL;
+
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_timer_cancel( VMC96_t * vmc96, unsigned int timer )
+{
+	vmc96_timer_wheel_t * wheel = &vmc96->wheel;
+	vmc96_timer_t * t = NULL;
+	unsigned int idx = VMC96_TIMER_HANDLE_INDEX( timer );
+
+	if( idx >= VMC96_TIMER_MAX_PENDING )
+		return VMC96_ERROR_TIMER_NOT_PENDING;
+
+	pthread_mutex_lock( &wheel->lock );
+
+	if( !wheel->running )
+	{
+		pthread_mutex_unlock( &wheel->lock );
+		return VMC96_ERROR_TIMER_NOT_PENDING;
+	}
+
+	t = &wheel->pool[ idx ];
+
+	if( !t->pending || (t->generation != VMC96_TIMER_HANDLE_GENERATION( timer )) )
+	{
+		pthread_mutex_unlock( &wheel->lock );
+		return VMC96_ERROR_TIMER_NOT_PENDING;
+	}
+
+	vmc96_timer_wheel_unlink( wheel, t );
+
+	t->pending = 0;
+	t->next = wheel->free_list;
+	wheel->free_list = t;
+
+	pthread_mutex_unlock( &wheel->lock );
+
+	return VMC96_SUCCESS;
+}
+
+#else
+
+int vmc96_sequence_start( VMC96_t * vmc96, VMC96_sequence_step_t * steps, unsigned int count )
+{
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
+
+
+int vmc96_sequence_wait( VMC96_t * vmc96 )
+{
+	return VMC96_SUCCESS;
+}
+
+
+int vmc96_sequence_cancel( VMC96_t * vmc96 )
+{
+	return VMC96_SUCCESS;
+}
+
+
+static void vmc96_timer_wheel_destroy( VMC96_t * vmc96 )
+{
+}
+
+
+int vmc96_timer_schedule( VMC96_t * vmc96, unsigned int delay_ms, const VMC96_sequence_step_t * action,
+	VMC96_timer_callback_t callback, void * userdata, unsigned int * timer )
+{
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
+
+
+int vmc96_timer_cancel( VMC96_t * vmc96, unsigned int timer )
+{
+	return VMC96_ERROR_TIMER_NOT_PENDING;
+}
+
+#endif
+
+
+/* ********************************************************************* */
+/* *                          HEALTH MONITOR                           * */
+/* ********************************************************************* */
+
+static int vmc96_health_index( unsigned char id_controller )
+{
+	switch( id_controller )
+	{
+		case VMC96_CONTROLLER_RELAY_1      : return VMC96_HEALTH_RELAY1;
+		case VMC96_CONTROLLER_RELAY_2      : return VMC96_HEALTH_RELAY2;
+		case VMC96_CONTROLLER_MOTOR_ARRAY  : return VMC96_HEALTH_MOTOR_ARRAY;
+		default                            : return -1;
+	}
+}
+
+
+/* eventfd and poll: the health monitor is only available on Linux */
+#ifdef __linux__
+
+static int vmc96_health_tick( VMC96_t * vmc96, VMC96_controller_health_t * changed )
+{
+	vmc96_health_monitor_t * mon = &vmc96->health;
+	VMC96_controller_health_t * c = NULL;
+	unsigned long long now = vmc96_monotonic_us();
+	unsigned long long interval = mon->policy.interval_ms * 1000ULL;
+	unsigned char alive[ VMC96_HEALTH_CONTROLLERS_COUNT ];
+	int due = -1;
+	int count = 0;
+	int ret = 0;
+	int i = 0;
+	int n = 0;
+
+	pthread_mutex_lock( &mon->lock );
+
+	for( i = 0; i < VMC96_HEALTH_CONTROLLERS_COUNT; i++ )
+	{
+		c = &mon->state.controller[i];
+		alive[i] = c->alive;
+
+		c->last_seen_us = __atomic_load_n( &vmc96->last_seen_us[i], __ATOMIC_RELAXED );
+
+		/* Recent traffic already proves liveness, no ping needed */
+		if( c->last_seen_us && (now - c->last_seen_us < interval) )
+		{
+			c->alive = 1;
+			c->failures = 0;
+		}
+	}
+
+	/* One ping per idle slot: the first due controller, round robin */
+	for( n = 0; (n < VMC96_HEALTH_CONTROLLERS_COUNT) && (due < 0); n++ )
+	{
+		i = ( mon->next + n ) % VMC96_HEALTH_CONTROLLERS_COUNT;
+		c = &mon->state.controller[i];
+
+		if( c->last_seen_us && (now - c->last_seen_us < interval) )
+			continue;
+
+		/* A failed ping is confirmed on the next idle slot, a dead controller is retried every interval */
+		if( !mon->last_ping_us[i] || (now - mon->last_ping_us[i] >= interval) || (c->failures && (c->failures < mon->policy.failures)) )
+			due = i;
+	}
+
+	if( (due >= 0) && ( __atomic_load_n( &vmc96->bus_waiters, __ATOMIC_RELAXED ) ||
+		(now - __atomic_load_n( &vmc96->bus_idle_us, __ATOMIC_RELAXED ) < mon->policy.idle_ms * 1000ULL) ) )
+	{
+		mon->state.controller[ due ].deferred++;
+		due = -1;
+	}
+
+	pthread_mutex_unlock( &mon->lock );
+
+	/* The bus is taken only if nobody holds it, a command arriving now waits for one short ping at most */
+	if( (due >= 0) && (vmc96_bus_try_acquire( vmc96 ) == VMC96_SUCCESS) )
+	{
+		vmc96->ping_timeout_ms = mon->policy.timeout_ms;
 
-	if( ret != VMC96_SUCCESS )
-		return ret;
+		if( due == VMC96_HEALTH_MOTOR_ARRAY )
+			ret = vmc96_motor_ping( vmc96 );
+		else
+			ret = vmc96_relay_ping( vmc96, due );
 
-	if( vmc96->response.data[0] != VMC96_COMMAND_MOTOR_SCAN_ARRAY )
-		return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+		vmc96->ping_timeout_ms = 0;
 
-	memset( &result->array, 0, sizeof(VMC96_motor_array_scan_result_t) );
+		VMC96_UNLOCK( vmc96 );
 
-	for( row = 0; row < VMC96_MOTOR_ARRAY_ROWS_COUNT; row++ )
-	{
-		for( col = 0; col < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; col++ )
-		{
-			result->array.motor[ row ][ col ] = ( vmc96->response.data[ 1 + col ] >> row ) & 0x1;
+		pthread_mutex_lock( &mon->lock );
 
-			if( result->array.motor[ row ][ col ] )
-				result->count++;
+		c = &mon->state.controller[ due ];
+
+		c->pings++;
+		mon->last_ping_us[ due ] = now;
+		mon->next = ( due + 1 ) % VMC96_HEALTH_CONTROLLERS_COUNT;
+
+		if( ret == VMC96_SUCCESS )
+		{
+			c->alive = 1;
+			c->failures = 0;
+			c->last_seen_us = __atomic_load_n( &vmc96->last_seen_us[ due ], __ATOMIC_RELAXED );
+		}
+		else if( ++c->failures >= mon->policy.failures )
+		{
+			c->alive = 0;
 		}
-	}
 
-	return VMC96_SUCCESS;
-}
+		pthread_mutex_unlock( &mon->lock );
+	}
+	else if( due >= 0 )
+	{
+		pthread_mutex_lock( &mon->lock );
+		mon->state.controller[ due ].deferred++;
+		pthread_mutex_unlock( &mon->lock );
+	}
 
+	pthread_mutex_lock( &mon->lock );
 
-int vmc96_motor_give_pulse( VMC96_t * vmc96, unsigned char row, unsigned char col, unsigned char duration_ms )
-{
-	unsigned char data[2] = { VMC96_GET_MOTOR_ID( row, col ), duration_ms };
+	for( i = 0; i < VMC96_HEALTH_CONTROLLERS_COUNT; i++ )
+		if( mon->state.controller[i].alive != alive[i] )
+			changed[ count++ ] = mon->state.controller[i];
 
-	if( !VMC96_VALIDATE_MOTOR_COORDINATE( row, col) )
-		return VMC96_ERROR_INVALID_MOTOR_COORDINATES;
+	pthread_mutex_unlock( &mon->lock );
 
-	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_MOTOR_ARRAY, VMC96_COMMAND_MOTOR_GIVE_PULSE, data, 2 );
+	return count;
 }
 
 
-/* ********************************************************************* */
-/* *                 GLOBAL COMMANDS CONTROL FUNCTION                  * */
-/* ********************************************************************* */
-
-int vmc96_global_reset( VMC96_t * vmc96 )
+static void * vmc96_health_thread( void * arg )
 {
-	unsigned char data = 0xFF;
-	return vmc96_send_message_ex( vmc96, VMC96_CONTROLLER_GLOBAL_BROADCAST, VMC96_COMMAND_GLOBAL_RESET, &data, 1 );
-}
-
+	VMC96_t * vmc96 = (VMC96_t*) arg;
+	vmc96_health_monitor_t * mon = &vmc96->health;
+	VMC96_controller_health_t changed[ VMC96_HEALTH_CONTROLLERS_COUNT ];
+	struct pollfd pfd;
+	int count = 0;
+	int i = 0;
 
-/* ********************************************************************* */
-/* *                    MESSAGE CONTROL FUNCTIONS                      * */
-/* ********************************************************************* */
+	pfd.fd = mon->cancel_fd;
+	pfd.events = POLLIN;
 
-static unsigned char vmc96_calculate_checksum( unsigned char * buf, size_t buflen )
-{
-	unsigned char sum = 0;
-	unsigned long i = 0;
+	/* Woken up every tick to catch idle slots, until canceled */
+	while( poll( &pfd, 1, VMC96_HEALTH_TICK_MS ) <= 0 )
+	{
+		count = vmc96_health_tick( vmc96, changed );
 
-	for( i = 0; i < buflen; i++ )
-		sum ^= buf[i];
+		for( i = 0; (i < count) && mon->callback; i++ )
+			mon->callback( vmc96, &changed[i], mon->userdata );
+	}
 
-	return sum;
+	return NULL;
 }
 
 
-static int vmc96_prepare_k1_message( VMC96_t * vmc96 )
+int vmc96_health_start( VMC96_t * vmc96, const VMC96_health_policy_t * policy, VMC96_health_callback_t callback, void * userdata )
 {
-	vmc96->message.k1_length = vmc96->message.data_length + VMC96_K1_MESSAGE_MIN_LEN;
-
-	/* K1 Message STX Header Field */
-	vmc96->message.k1[0] = VMC96_K1_MESSAGE_STX;
+	vmc96_health_monitor_t * mon = &vmc96->health;
+	static const unsigned char ids[ VMC96_HEALTH_CONTROLLERS_COUNT ] = { VMC96_CONTROLLER_RELAY_1, VMC96_CONTROLLER_RELAY_2, VMC96_CONTROLLER_MOTOR_ARRAY };
+	int i = 0;
 
-	/* K1 Message: Controller Address/ID Field */
-	vmc96->message.k1[1] = vmc96->message.id_controller;
+	if( (policy == NULL) || (policy->interval_ms == 0) || (policy->failures == 0) ||
+		(policy->timeout_ms == 0) || (policy->timeout_ms > VMC96_K1_RESPONSE_TIMEOUT_MS) )
+		return VMC96_ERROR_INVALID_HEALTH_POLICY;
 
-	/* K1 Message: Total Length Field */
-	vmc96->message.k1[2] = vmc96->message.k1_length;
+	/* Claim the monitor before touching anything a running monitor owns */
+	pthread_mutex_lock( &mon->lock );
 
-	/* K1 Message: Command Code Field */
-	vmc96->message.k1[3] = vmc96->message.command;
+	if( mon->running )
+	{
+		pthread_mutex_unlock( &mon->lock );
+		return VMC96_ERROR_HEALTH_BUSY;
+	}
 
-	/* K1 Message: Data Field */
-	if( vmc96->message.data_length > 0 )
-		memcpy( &vmc96->message.k1[4], vmc96->message.data, vmc96->message.data_length );
+	mon->running = 1;
 
-	/* K1 Message: Checksum Field */
-	vmc96->message.k1[ vmc96->message.k1_length - 1 ] = vmc96_calculate_checksum( vmc96->message.k1, vmc96->message.k1_length - 1 );
+	memset( &mon->state, 0, sizeof(VMC96_health_t) );
+	memset( mon->last_ping_us, 0, sizeof(mon->last_ping_us) );
 
-	return VMC96_SUCCESS;
-}
+	for( i = 0; i < VMC96_HEALTH_CONTROLLERS_COUNT; i++ )
+		mon->state.controller[i].id_controller = ids[i];
 
+	mon->policy = *policy;
+	mon->callback = callback;
+	mon->userdata = userdata;
+	mon->next = 0;
 
-static int vmc96_k1_parse_response_type( VMC96_t * vmc96 )
-{
-	switch( vmc96->message.id_controller )
-	{
-		case VMC96_CONTROLLER_GLOBAL_BROADCAST:
-		{
-			switch( vmc96->message.command )
-			{
-				case VMC96_COMMAND_GLOBAL_RESET : return VMC96_K1_RESPONSE_TYPE_ACK;
-				default                         : return VMC96_K1_RESPONSE_TYPE_INVALID;
-			}
-		}
+	pthread_mutex_unlock( &mon->lock );
 
-		case VMC96_CONTROLLER_RELAY_1 :
-		case VMC96_CONTROLLER_RELAY_2 :
-		{
-			switch( vmc96->message.command )
-			{
-				case VMC96_COMMAND_RESET          : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_SIMPLE_PING    : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_KERNEL_VERSION : return VMC96_K1_RESPONSE_TYPE_DATA;
-				case VMC96_COMMAND_RELAY_FUNCTION : return VMC96_K1_RESPONSE_TYPE_ACK;
-				default                           : return VMC96_K1_RESPONSE_TYPE_INVALID;
-			}
-		}
+	mon->cancel_fd = eventfd( 0, EFD_CLOEXEC );
 
-		case VMC96_CONTROLLER_MOTOR_ARRAY:
-		{
-			switch( vmc96->message.command )
-			{
-				case VMC96_COMMAND_RESET                  : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_SIMPLE_PING            : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_KERNEL_VERSION         : return VMC96_K1_RESPONSE_TYPE_DATA;
-				case VMC96_COMMAND_MOTOR_RUN              : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_MOTOR_STOP_ALL         : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_MOTOR_STATUS_REQUEST   : return VMC96_K1_RESPONSE_TYPE_DATA;
-				case VMC96_COMMAND_MOTOR_OPTO_LINE_STATUS : return VMC96_K1_RESPONSE_TYPE_DATA;
-				case VMC96_COMMAND_MOTOR_GIVE_PULSE       : return VMC96_K1_RESPONSE_TYPE_ACK;
-				case VMC96_COMMAND_MOTOR_SCAN_ARRAY       : return VMC96_K1_RESPONSE_TYPE_DATA;
-				default                                   : return VMC96_K1_RESPONSE_TYPE_INVALID;
-			}
-		}
+	if( mon->cancel_fd < 0 )
+		goto error_release;
 
-		default:
-		{
-			return VMC96_K1_RESPONSE_TYPE_INVALID;
-		}
+	if( pthread_create( &mon->thread, NULL, vmc96_health_thread, vmc96 ) != 0 )
+	{
+		close( mon->cancel_fd );
+		goto error_release;
 	}
-}
 
+	return VMC96_SUCCESS;
 
-static int vmc96_parse_k1_response( VMC96_t * vmc96 )
-{
-	switch( vmc96_k1_parse_response_type( vmc96 ) )
-	{
-		case VMC96_K1_RESPONSE_TYPE_ACK:
-		{
-			/* K1 Response: Validate Positive ACK Message Len */
-			if( vmc96->response.k1_length != VMC96_K1_MESSAGE_MIN_LEN )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+error_release:
 
-			/* K1 Response: Parse Source Controller ID/Address Field */
-			vmc96->response.id_controller = vmc96->response.k1[1];
+	pthread_mutex_lock( &mon->lock );
+	mon->running = 0;
+	pthread_mutex_unlock( &mon->lock );
 
-			/* K1 Response: Data Field Empty */
-			memset( vmc96->response.data, 0, VMC96_K1_MESSAGE_DATA_MAX_LEN );
-			vmc96->response.data_length = 0;
+	return VMC96_ERROR_SYSTEM_CALL;
+}
 
-			/* K1 Response: Validating STX Header Field */
-			if( vmc96->response.k1[0] != VMC96_K1_MESSAGE_STX )
-				return VMC96_ERROR_K1_RESPONSE_MALFORMED;
 
-			/* K1 Response: Validate Source Controller ID/Address Field */
-			if( vmc96->response.k1[1] != vmc96->message.id_controller )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+void vmc96_health_stop( VMC96_t * vmc96 )
+{
+	vmc96_health_monitor_t * mon = &vmc96->health;
+	unsigned long long one = 1;
 
-			/* K1 Response: Validate Positive ACK Message Len */
-			if( vmc96->response.k1[2] != VMC96_K1_MESSAGE_MIN_LEN )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+	pthread_mutex_lock( &mon->lock );
 
-			/* K1 Response: Validate Checksum */
-			if( vmc96->response.k1[4] != vmc96_calculate_checksum( vmc96->response.k1, vmc96->response.k1_length - 1 ) )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM;
+	/* Only one caller joins the thread */
+	if( !mon->running || mon->joining )
+	{
+		pthread_mutex_unlock( &mon->lock );
+		return;
+	}
 
-			/* K1 Response: Validate Positive ACK Field */
-			if( vmc96->response.k1[3] != VMC96_K1_RESPONSE_POSITIVE_ACK )
-				return VMC96_ERROR_K1_RESPONSE_NEGATIVE_ACK;
+	mon->joining = 1;
 
-			return VMC96_SUCCESS;
-		}
+	if( write( mon->cancel_fd, &one, sizeof(one) ) < 0 )
+	{
+		VMC96_DEBUG_MSG( "[DEBUG] Health monitor cancel failed.\n" );
+	}
 
-		case VMC96_K1_RESPONSE_TYPE_DATA:
-		{
-			/* K1 Response: Validating Message Length */
-			if( vmc96->response.k1_length < VMC96_K1_MESSAGE_MIN_LEN )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+	pthread_mutex_unlock( &mon->lock );
 
-			/* K1 Response: Parse Source Controller ID/Address Field */
-			vmc96->response.id_controller = vmc96->response.k1[1];
+	pthread_join( mon->thread, NULL );
 
-			/* K1 Response: Parse Total Data Length Field */
-			vmc96->response.data_length = vmc96->response.k1[2] - 4;
+	pthread_mutex_lock( &mon->lock );
 
-			/* K1 Response: Parse Data Field */
-			memcpy( vmc96->response.data, &vmc96->response.k1[3], vmc96->response.data_length );
+	close( mon->cancel_fd );
 
-			/* K1 Response: Validating STX Header Field */
-			if( vmc96->response.k1[0] != VMC96_K1_MESSAGE_STX )
-				return VMC96_ERROR_K1_RESPONSE_MALFORMED;
+	mon->joining = 0;
+	mon->running = 0;
 
-			/* K1 Response: Validate Source Controller ID/Address Field */
-			if( vmc96->response.k1[1] != vmc96->message.id_controller )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_SOURCE;
+	pthread_mutex_unlock( &mon->lock );
+}
 
-			/* K1 Response: Validate Total Length Field */
-			if( vmc96->response.k1[2] != vmc96->response.k1_length )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH;
+#else
 
-			/* K1 Response: Validate Checksum */
-			if( vmc96->response.k1[ vmc96->response.k1_length - 1 ] != vmc96_calculate_checksum( vmc96->response.k1, vmc96->response.k1_length - 1 ) )
-				return VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM;
+int vmc96_health_start( VMC96_t * vmc96, const VMC96_health_policy_t * policy, VMC96_health_callback_t callback, void * userdata )
+{
+	return VMC96_ERROR_NOT_SUPPORTED;
+}
 
-			return VMC96_SUCCESS;
-		}
 
-		default:
-		{
-			return VMC96_ERROR_K1_RESPONSE_MALFORMED;
-		}
-	}
+void vmc96_health_stop( VMC96_t * vmc96 )
+{
 }
 
+#endif
+
 
-static int vmc96_send_k1_message( VMC96_t * vmc96 )
+int vmc96_health_get( VMC96_t * vmc96, VMC96_health_t * health )
 {
-	int ret = 0;
-	int i = 0;
+	vmc96_health_monitor_t * mon = &vmc96->health;
 
-	ret = ftdi_usb_purge_buffers( vmc96->ftdi );
+	pthread_mutex_lock( &mon->lock );
+	memcpy( health, &mon->state, sizeof(VMC96_health_t) );
+	pthread_mutex_unlock( &mon->lock );
 
-	if( ret < 0 )
-		return VMC96_ERROR_FTDI_PURGE_BUFFERS;
+	return VMC96_SUCCESS;
+}
 
-	ret = ftdi_write_data( vmc96->ftdi, vmc96->message.k1, vmc96->message.k1_length );
 
-	if( ret < 0 )
-		return VMC96_ERROR_FTDI_WRITE_DATA;
+/* ********************************************************************* */
+/* *                      CONSTRUCTOR/DESTRUCTOR                       * */
+/* ********************************************************************* */
 
-	for( i = 0; i < VMC96_K1_RESPONSE_TIMEOUT_MS; i += VMC96_K1_RESPONSE_READ_RETRY_DELAY_MS  )
-	{
-		VMC96_SLEEP_MS( VMC96_K1_RESPONSE_READ_RETRY_DELAY_MS );
+static int vmc96_ftdi_purge( void * userdata )
+{
+	return ftdi_usb_purge_buffers( (struct ftdi_context *) userdata );
+}
 
-		ret = ftdi_read_data( vmc96->ftdi, vmc96->response.k1, VMC96_K1_MESSAGE_MAX_LEN );
 
-		if( ret < 0 )
-			return VMC96_ERROR_FTDI_READ_DATA;
+static int vmc96_ftdi_write( void * userdata, const unsigned char * buf, int len )
+{
+	return ftdi_write_data( (struct ftdi_context *) userdata, buf, len );
+}
 
-		if( ret > 0 )
-		{
-			vmc96->response.k1_length = ret;
-			return VMC96_SUCCESS;
-		}
-	}
 
-	return VMC96_ERROR_K1_RESPONSE_TIMEOUT;
+static int vmc96_ftdi_read( void * userdata, unsigned char * buf, int len )
+{
+	return ftdi_read_data( (struct ftdi_context *) userdata, buf, len );
 }
 
 
-static int vmc96_send_message( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd )
+static void vmc96_ftdi_close( void * userdata )
 {
-	return vmc96_send_message_ex( vmc96, id_cntlr, cmd, NULL, 0 );
+	ftdi_usb_close( (struct ftdi_context *) userdata );
+	ftdi_free( (struct ftdi_context *) userdata );
 }
 
 
-static int vmc96_send_message_ex( VMC96_t * vmc96, unsigned char id_cntlr, unsigned char cmd, unsigned char * data, unsigned char datalen )
+static VMC96_t * vmc96_context_new( void )
 {
-	int ret = 0;
+	VMC96_t * vmc96 = NULL;
 
-	vmc96->message.id_controller = id_cntlr;
-	vmc96->message.command = cmd;
+	vmc96 = (VMC96_t*) calloc( 1, sizeof(VMC96_t) );
 
-	memset( vmc96->message.data, 0, VMC96_K1_MESSAGE_DATA_MAX_LEN );
-	vmc96->message.data_length = 0;
+	if( !vmc96 )
+		return NULL;
 
-	if( (data != NULL) && (datalen > 0) )
-	{
-		memcpy( vmc96->message.data, data, datalen );
-		vmc96->message.data_length = datalen;
-	}
+	pthread_mutex_init( &vmc96->bus.lock, NULL );
+	pthread_cond_init( &vmc96->bus.cond, NULL );
 
-	ret = vmc96_prepare_k1_message( vmc96 );
+	pthread_mutex_init( &vmc96->wheel.lock, NULL );
+	pthread_mutex_init( &vmc96->health.lock, NULL );
+	pthread_mutex_init( &vmc96->sequencer.lock, NULL );
+	pthread_mutex_init( &vmc96->status_page_lock, NULL );
 
-	if( ret != VMC96_SUCCESS )
-		return ret;
+	vmc96->motor_run_max_per_frame = VMC96_MOTOR_RUN_MAX_MOTORS_PER_FRAME;
 
-	VMC96_DEBUG_BUFFER( "K1-MESSAGE", vmc96->message.k1, vmc96->message.k1_length );
+	vmc96_frame_table_build( &vmc96->frames );
 
-	ret = vmc96_send_k1_message( vmc96 );
+	/* Retries are disabled until the application sets a policy */
+	vmc96->retry_policy.max_attempts = 1;
+	vmc96->retry_policy.backoff_multiplier = 1;
 
-	if( ret != VMC96_SUCCESS )
-		return ret;
+	/* Fixed response timeout until the application sets a policy */
+	vmc96->timeout_policy.mode = VMC96_TIMEOUT_MODE_FIXED;
 
-	VMC96_DEBUG_BUFFER( "K1-RESPONSE", vmc96->response.k1, vmc96->response.k1_length );
+	vmc96_stats_clear( vmc96 );
 
-	return vmc96_parse_k1_response( vmc96 );
+	return vmc96;
 }
 
 
-/* ********************************************************************* */
-/* *                      CONSTRUCTOR/DESTRUCTOR                       * */
-/* ********************************************************************* */
+static void vmc96_context_free( VMC96_t * vmc96 )
+{
+	free( vmc96->trace.ring );
+	pthread_mutex_destroy( &vmc96->status_page_lock );
+	pthread_mutex_destroy( &vmc96->sequencer.lock );
+	pthread_mutex_destroy( &vmc96->health.lock );
+	pthread_mutex_destroy( &vmc96->wheel.lock );
+	pthread_cond_destroy( &vmc96->bus.cond );
+	pthread_mutex_destroy( &vmc96->bus.lock );
+	free( vmc96 );
+}
+
 
 void vmc96_finish( VMC96_t * vmc96 )
 {
-	ftdi_usb_close( vmc96->ftdi );
-	ftdi_free( vmc96->ftdi );
-	free( vmc96 );
+	vmc96_health_stop( vmc96 );
+	vmc96_sequence_cancel( vmc96 );
+	vmc96_timer_wheel_destroy( vmc96 );
+	vmc96_status_page_unpublish( vmc96 );
+
+	if( vmc96->transport.close )
+		vmc96->transport.close( vmc96->transport.userdata );
+
+	vmc96_context_free( vmc96 );
 
 	VMC96_DEBUG_MSG( "[DEBUG] Disconnected from VMC96 Board.\n");
 }
@@ -758,7 +4153,7 @@ int vmc96_initialize( VMC96_t ** ppvmc96 )
 	int ret = 0;
 	VMC96_t * vmc96 = NULL;
 
-	vmc96 = (VMC96_t*) calloc( 1, sizeof(VMC96_t) );
+	vmc96 = vmc96_context_new();
 
 	if( !vmc96 )
 		return VMC96_ERROR_OUT_OF_MEMORY;
@@ -821,6 +4216,13 @@ int vmc96_initialize( VMC96_t ** ppvmc96 )
 		goto error_cleanup;
 	}
 
+	vmc96->transport.purge = vmc96_ftdi_purge;
+	vmc96->transport.write = vmc96_ftdi_write;
+	vmc96->transport.read = vmc96_ftdi_read;
+	vmc96->transport.close = vmc96_ftdi_close;
+	vmc96->transport.read_delay_ms = VMC96_K1_RESPONSE_READ_RETRY_DELAY_MS;
+	vmc96->transport.userdata = vmc96->ftdi;
+
 	*ppvmc96 = vmc96;
 
 	VMC96_DEBUG_MSG( "[DEBUG] VMC96 board initialized successfully.\n" );
@@ -835,9 +4237,31 @@ error_cleanup:
 
 	ftdi_usb_close( vmc96->ftdi );
 	ftdi_free( vmc96->ftdi );
-	free( vmc96 );
+	vmc96_context_free( vmc96 );
 
 	return ret;
 }
 
+
+int vmc96_initialize_transport( VMC96_t ** ppvmc96, const VMC96_transport_t * transport )
+{
+	VMC96_t * vmc96 = NULL;
+
+	*ppvmc96 = NULL;
+
+	if( !transport || !transport->purge || !transport->write || !transport->read )
+		return VMC96_ERROR_INVALID_TRANSPORT;
+
+	vmc96 = vmc96_context_new();
+
+	if( !vmc96 )
+		return VMC96_ERROR_OUT_OF_MEMORY;
+
+	vmc96->transport = *transport;
+
+	*ppvmc96 = vmc96;
+
+	return VMC96_SUCCESS;
+}
+
 /* eof */
@@ -31,6 +31,8 @@
 
 #define VMC96_SUCCESS                              (0)
 #define VMC96_ERROR_OUT_OF_MEMORY                  (1)
+#define VMC96_ERROR_SYSTEM_CALL                    (2)
+#define VMC96_ERROR_NOT_SUPPORTED                  (3)
 #define VMC96_ERROR_FTDI_INITIALIZE                (101)
 #define VMC96_ERROR_FTDI_SET_INTERFACE             (102)
 #define VMC96_ERROR_FTDI_OPEN_USB_DEVICE           (103)
@@ -48,6 +50,25 @@
 #define VMC96_ERROR_K1_RESPONSE_INVALID_LENGTH     (205)
 #define VMC96_ERROR_K1_RESPONSE_TIMEOUT            (206)
 #define VMC96_ERROR_INVALID_MOTOR_COORDINATES      (301)
+#define VMC96_ERROR_INVALID_RETRY_POLICY           (302)
+#define VMC96_ERROR_INVALID_TIMEOUT_POLICY         (303)
+#define VMC96_ERROR_INVALID_TRANSPORT              (304)
+#define VMC96_ERROR_INVALID_REQUEST                (305)
+#define VMC96_ERROR_INVALID_HEALTH_POLICY          (306)
+#define VMC96_ERROR_SEQUENCE_BUSY                  (401)
+#define VMC96_ERROR_SEQUENCE_INVALID               (402)
+#define VMC96_ERROR_SEQUENCE_CANCELED              (403)
+#define VMC96_ERROR_TIMER_POOL_EXHAUSTED           (501)
+#define VMC96_ERROR_TIMER_NOT_PENDING              (502)
+#define VMC96_ERROR_TIMER_INVALID_DELAY            (503)
+#define VMC96_ERROR_TRACE_INVALID_SIZE             (601)
+#define VMC96_ERROR_TRACE_NOT_ALLOCATED            (602)
+#define VMC96_ERROR_CAPTURE_WRITE                  (603)
+#define VMC96_ERROR_STATUS_PAGE_INVALID            (701)
+#define VMC96_ERROR_STATUS_PAGE_BUSY               (702)
+#define VMC96_ERROR_STATUS_PAGE_IN_USE             (703)
+#define VMC96_ERROR_HEALTH_BUSY                    (801)
+#define VMC96_ERROR_COMMAND_PREEMPTED              (901)
 
 #define VMC96_OPTO_LINE_SAMPLE_BLOCK_LENGTH_MS     (1280)  /* 1.28s block */
 #define VMC96_OPTO_LINE_SAMPLE_LENGTH_MS           (40)    /* 40ms sample */
@@ -56,12 +77,88 @@
 #define VMC96_MOTOR_ARRAY_ROWS_COUNT               (8)
 #define VMC96_MOTOR_ARRAY_COLUMNS_COUNT            (12)
 
+#define VMC96_SEQUENCE_ACTION_NONE                 (0)
+#define VMC96_SEQUENCE_ACTION_RELAY_ON             (1)
+#define VMC96_SEQUENCE_ACTION_RELAY_OFF            (2)
+#define VMC96_SEQUENCE_ACTION_MOTOR_RUN            (3)
+#define VMC96_SEQUENCE_ACTION_MOTOR_PULSE          (4)
+#define VMC96_SEQUENCE_ACTION_MOTOR_STOP_ALL       (5)
+#define VMC96_SEQUENCE_ACTION_MOTOR_RESET          (6)
+
+#define VMC96_TIMEOUT_MODE_FIXED                   (0)     /* Always wait the fixed 1000ms for a response */
+#define VMC96_TIMEOUT_MODE_ADAPTIVE                (1)     /* Learn the response time per controller/command */
+
+#define VMC96_HISTOGRAM_BUCKETS                    (272)   /* Log-linear, 8 buckets per power of two nanoseconds, up to ~68s */
+
+#define VMC96_STATS_PHASE_ENCODE                   (0)     /* K1 frame encoding */
+#define VMC96_STATS_PHASE_PURGE                    (1)     /* RX/TX buffers purge */
+#define VMC96_STATS_PHASE_WRITE                    (2)     /* Frame write */
+#define VMC96_STATS_PHASE_FIRST_BYTE               (3)     /* Write done to first response byte */
+#define VMC96_STATS_PHASE_LAST_BYTE                (4)     /* First to last response byte */
+#define VMC96_STATS_PHASE_PARSE                    (5)     /* Response parsing */
+#define VMC96_STATS_PHASES_COUNT                   (6)
+#define VMC96_STATS_COMMANDS_COUNT                 (18)    /* Valid controller/command pairs */
+#define VMC96_STATS_ERRORS_COUNT                   (9)     /* Error codes a K1 transaction may end with */
+
+#define VMC96_TRACE_DIRECTION_TX                   (0)     /* Frame written to the board */
+#define VMC96_TRACE_DIRECTION_RX                   (1)     /* Frame read from the board */
+#define VMC96_TRACE_FRAME_MAX_LEN                  (255)   /* K1 frames are at most 255 bytes */
+#define VMC96_TRACE_DUMP_MAGIC                     "VMC96TRC"
+#define VMC96_TRACE_DUMP_VERSION                   (1)
+
+#define VMC96_CAPTURE_MAGIC                        "VMC96CAP"
+#define VMC96_CAPTURE_VERSION                      (1)
+#define VMC96_CAPTURE_BOARD_ID_MAX_LEN             (32)
+
+#define VMC96_REQUEST_DATA_MAX_LEN                 (250)   /* K1 frame data field */
+
+#define VMC96_COMMAND_CLASS_READ                   (0)     /* Status, opto, scan, version, ping */
+#define VMC96_COMMAND_CLASS_NORMAL                 (1)     /* Run, pulse, relay control */
+#define VMC96_COMMAND_CLASS_SAFETY                 (2)     /* Stop all, motor reset, global reset */
+#define VMC96_COMMAND_CLASSES_COUNT                (3)
+
+#define VMC96_STATUS_PAGE_MAGIC                    (0x50363956)  /* "V96P" */
+#define VMC96_STATUS_PAGE_VERSION                  (2)
+#define VMC96_STATUS_PAGE_MOTOR_STATUS             (0)     /* Status page fields: updated_us[] index, valid bit */
+#define VMC96_STATUS_PAGE_OPTO_LINE                (1)
+#define VMC96_STATUS_PAGE_SCAN                     (2)
+#define VMC96_STATUS_PAGE_RELAY1                   (3)
+#define VMC96_STATUS_PAGE_RELAY2                   (4)
+#define VMC96_STATUS_PAGE_FIELDS_COUNT             (5)
+
+#define VMC96_TIMER_RESOLUTION_MS                  (10)    /* Timer wheel tick */
+#define VMC96_TIMER_MAX_DELAY_MS                   (46UL * 3600UL * 1000UL)  /* Longest timer delay (46 hours) */
+#define VMC96_TIMER_MAX_PENDING                    (1024)  /* Pending timers per context */
+
+#define VMC96_HEALTH_RELAY1                        (0)     /* Monitored controllers: VMC96_health_t index */
+#define VMC96_HEALTH_RELAY2                        (1)
+#define VMC96_HEALTH_MOTOR_ARRAY                   (2)
+#define VMC96_HEALTH_CONTROLLERS_COUNT             (3)
+#define VMC96_HEALTH_TICK_MS                       (5)     /* Idle slot detection resolution */
+
 
 typedef struct VMC96_s                         VMC96_t;
 typedef struct VMC96_motor_array_s             VMC96_motor_array_t;
 typedef struct VMC96_motor_array_scan_result_s VMC96_motor_array_scan_result_t;
 typedef struct VMC96_motor_array_status_s      VMC96_motor_array_status_t;
 typedef struct VMC96_opto_line_sample_block_s  VMC96_opto_line_sample_block_t;
+typedef struct VMC96_sequence_step_s           VMC96_sequence_step_t;
+typedef struct VMC96_retry_policy_s            VMC96_retry_policy_t;
+typedef struct VMC96_retry_stats_s             VMC96_retry_stats_t;
+typedef struct VMC96_timeout_policy_s          VMC96_timeout_policy_t;
+typedef struct VMC96_histogram_s               VMC96_histogram_t;
+typedef struct VMC96_command_stats_s           VMC96_command_stats_t;
+typedef struct VMC96_error_stats_s             VMC96_error_stats_t;
+typedef struct VMC96_stats_s                   VMC96_stats_t;
+typedef struct VMC96_trace_record_s            VMC96_trace_record_t;
+typedef struct VMC96_trace_dump_header_s       VMC96_trace_dump_header_t;
+typedef struct VMC96_capture_header_s          VMC96_capture_header_t;
+typedef struct VMC96_capture_record_s          VMC96_capture_record_t;
+typedef struct VMC96_transport_s               VMC96_transport_t;
+typedef struct VMC96_status_page_s             VMC96_status_page_t;
+typedef struct VMC96_health_policy_s           VMC96_health_policy_t;
+typedef struct VMC96_controller_health_s       VMC96_controller_health_t;
+typedef struct VMC96_health_s                  VMC96_health_t;
 
 
 /*!
@@ -103,6 +200,268 @@ struct VMC96_motor_array_scan_result_s
 };
 
 
+/*!
+	\brief Represents a Timed Sequence Step
+*/
+struct VMC96_sequence_step_s
+{
+	unsigned int offset_ms;          /*!< Step Time Relative to the Sequence Start in Milliseconds */
+	unsigned char action;            /*!< Step Action (VMC96_SEQUENCE_ACTION_*) */
+	unsigned char id;                /*!< Relay ID (Relay Actions) */
+	unsigned char row;               /*!< Motor Array Row Coordinate (Motor Actions) */
+	unsigned char col;               /*!< Motor Array Column Coordinate (Motor Actions) */
+	unsigned char duration_ms;       /*!< Pulse Duration in Milliseconds (Motor Pulse Action) */
+	int result;                      /*!< Step Result Code (Filled by the Sequencer) */
+	unsigned long long sent_us;      /*!< CLOCK_MONOTONIC Time the Frame was Written in Microseconds (0 if No Frame was Written) */
+};
+
+
+/*!
+	\brief Represents a Retry Policy for Transient Errors (Checksum, Timeout and Malformed Responses)
+
+	Idempotent commands (ping, version, reset, status, scan, opto line, stop all, relay control)
+	are simply resent. Motor run and give pulse are resent only after a status request
+	shows they did not take effect.
+*/
+struct VMC96_retry_policy_s
+{
+	unsigned int max_attempts;        /*!< Total Attempts Including the First One (1 Disables Retries) */
+	unsigned int backoff_ms;          /*!< Delay Before the First Retry in Milliseconds */
+	unsigned int backoff_multiplier;  /*!< Delay Multiplier Applied After Each Retry (At Least 1) */
+	unsigned int backoff_max_ms;      /*!< Maximum Delay Between Retries in Milliseconds */
+};
+
+
+/*!
+	\brief Represents Retry Engine Counters
+*/
+struct VMC96_retry_stats_s
+{
+	unsigned long retries;            /*!< Frames Resent */
+	unsigned long status_checks;      /*!< Status Requests Issued to Verify Non-Idempotent Commands */
+	unsigned long verified;           /*!< Non-Idempotent Commands Found Already Executed (Not Resent) */
+	unsigned long recovered;          /*!< Commands Succeeded After a Transient Error */
+	unsigned long exhausted;          /*!< Commands Failed After All Attempts */
+};
+
+
+/*!
+	\brief Represents a Response Timeout Policy
+
+	In adaptive mode the timeout of each controller/command is its observed response time
+	percentile multiplied by the safety factor, bounded by floor_ms and the fixed 1000ms.
+	The fixed timeout is used until min_samples responses were observed, for retries, and for a
+	controller/command after two consecutive timeouts until it answers again. A timeout is
+	learned as a response at the deadline, so a slower board raises the timeout.
+*/
+struct VMC96_timeout_policy_s
+{
+	unsigned int mode;                /*!< VMC96_TIMEOUT_MODE_FIXED or VMC96_TIMEOUT_MODE_ADAPTIVE */
+	double percentile;                /*!< Response Time Percentile (e.g. 99.9) */
+	double safety_factor;             /*!< Multiplier Applied to the Percentile (e.g. 2.0) */
+	unsigned int floor_ms;            /*!< Minimum Timeout in Milliseconds (At Most 1000ms) */
+	unsigned int min_samples;         /*!< Responses Needed Before Adapting */
+};
+
+
+/*!
+	\brief Represents a Latency Histogram (Nanoseconds)
+*/
+struct VMC96_histogram_s
+{
+	unsigned long long count;                              /*!< Samples Count */
+	unsigned long long sum_ns;                             /*!< Samples Sum */
+	unsigned long long min_ns;                             /*!< Smallest Sample */
+	unsigned long long max_ns;                             /*!< Largest Sample */
+	unsigned int bucket[ VMC96_HISTOGRAM_BUCKETS ];        /*!< Samples per Bucket */
+};
+
+
+/*!
+	\brief Represents the Statistics of a Controller/Command Pair
+*/
+struct VMC96_command_stats_s
+{
+	unsigned char id_controller;                           /*!< K1 Controller Address */
+	unsigned char command;                                 /*!< K1 Command Code */
+	unsigned long long requests;                           /*!< Frames Sent (Retries Included) */
+	unsigned long long errors;                             /*!< Failed Transactions */
+	unsigned long long retries;                            /*!< Frames Resent by the Retry Engine */
+	unsigned long long bytes_tx;                           /*!< Bytes Written */
+	unsigned long long bytes_rx;                           /*!< Bytes Read */
+	VMC96_histogram_t phase[ VMC96_STATS_PHASES_COUNT ];   /*!< Latency per Phase (VMC96_STATS_PHASE_*) */
+	VMC96_histogram_t total;                               /*!< Round Trip Latency (Encode to Parse) */
+};
+
+
+/*!
+	\brief Represents an Error Code Counter
+*/
+struct VMC96_error_stats_s
+{
+	int code;                                              /*!< VMC96_ERROR_* Code */
+	unsigned long long count;                              /*!< Transactions Ended With this Code */
+};
+
+
+/*!
+	\brief Represents the Statistics of a Context (Large Object, Avoid Small Stacks)
+*/
+struct VMC96_stats_s
+{
+	VMC96_command_stats_t command[ VMC96_STATS_COMMANDS_COUNT ];  /*!< Per Controller/Command Statistics */
+	VMC96_error_stats_t error[ VMC96_STATS_ERRORS_COUNT ];        /*!< Per Error Code Counters */
+	unsigned long long bytes_tx;                                  /*!< Total Bytes Written */
+	unsigned long long bytes_rx;                                  /*!< Total Bytes Read */
+	unsigned long long since_us;                                  /*!< CLOCK_MONOTONIC Time of the Last Reset */
+	unsigned long long busy_ns;                                   /*!< Time Spent in K1 Transactions (Bus Busy) */
+	unsigned long long coalesced;                                 /*!< Read Requests Answered by an Identical Request in Flight */
+};
+
+
+/*!
+	\brief Represents a Traced K1 Frame
+*/
+struct VMC96_trace_record_s
+{
+	unsigned long long timestamp_ns;                       /*!< CLOCK_MONOTONIC Time in Nanoseconds */
+	unsigned int sequence;                                 /*!< Record Number Since Tracing Started (From 1) */
+	int result;                                            /*!< Write Result (TX) or Transaction Result (RX) */
+	unsigned char direction;                               /*!< VMC96_TRACE_DIRECTION_TX or VMC96_TRACE_DIRECTION_RX */
+	unsigned char id_controller;                           /*!< Addressed K1 Controller */
+	unsigned char command;                                 /*!< K1 Command Code */
+	unsigned char length;                                  /*!< Frame Length (0 if Nothing Was Received) */
+	unsigned char frame[ VMC96_TRACE_FRAME_MAX_LEN ];      /*!< Raw Frame */
+};
+
+
+/*!
+	\brief Represents the Header of a Binary Trace Dump (Followed by Records, Oldest First)
+*/
+struct VMC96_trace_dump_header_s
+{
+	char magic[8];                                         /*!< VMC96_TRACE_DUMP_MAGIC */
+	unsigned int version;                                  /*!< VMC96_TRACE_DUMP_VERSION */
+	unsigned int record_size;                              /*!< sizeof(VMC96_trace_record_t) */
+	unsigned int records;                                  /*!< Records Following the Header */
+	unsigned int dropped;                                  /*!< Records Overwritten Before the Dump */
+};
+
+
+/*!
+	\brief Represents the Header of a Capture File (Followed by Records)
+*/
+struct VMC96_capture_header_s
+{
+	char magic[8];                                         /*!< VMC96_CAPTURE_MAGIC */
+	unsigned int version;                                  /*!< VMC96_CAPTURE_VERSION */
+	unsigned int reserved;                                 /*!< Zero */
+	unsigned long long start_us;                           /*!< CLOCK_MONOTONIC Time the Capture Started */
+	char board_id[ VMC96_CAPTURE_BOARD_ID_MAX_LEN ];       /*!< Board Identification (NUL Padded) */
+};
+
+
+/*!
+	\brief Represents a Captured K1 Frame (Followed by length Frame Bytes)
+*/
+struct VMC96_capture_record_s
+{
+	unsigned int delta_us;                                 /*!< Microseconds Since the Previous Record (or the Capture Start) */
+	short result;                                          /*!< Write Result (TX) or Transaction Result (RX) */
+	unsigned char direction;                               /*!< VMC96_TRACE_DIRECTION_TX or VMC96_TRACE_DIRECTION_RX */
+	unsigned char length;                                  /*!< Frame Length (0 if Nothing Was Received) */
+};
+
+
+/*!
+	\brief Represents the Shared-Memory Status Page of a Board (Latest Decoded State)
+*/
+struct VMC96_status_page_s
+{
+	unsigned int magic;                                    /*!< VMC96_STATUS_PAGE_MAGIC */
+	unsigned int version;                                  /*!< VMC96_STATUS_PAGE_VERSION */
+	unsigned int sequence;                                 /*!< Seqlock Sequence (Odd While the Publisher Writes) */
+	unsigned int valid;                                    /*!< Published Fields (1 << VMC96_STATUS_PAGE_*) */
+	int publisher_pid;                                     /*!< Publisher Process */
+	unsigned long long publisher_start;                    /*!< Publisher Start Time in Clock Ticks Since Boot (Tells a Reused Pid Apart) */
+	unsigned long long updated_us[ VMC96_STATUS_PAGE_FIELDS_COUNT ];  /*!< CLOCK_MONOTONIC Time of the Response Behind Each Field */
+	VMC96_motor_array_status_t motor_status;               /*!< Last Motor Array Status */
+	VMC96_opto_line_sample_block_t opto_line;              /*!< Last Opto-Sensor Block */
+	VMC96_motor_array_scan_result_t scan;                  /*!< Last Motor Array Scan */
+	unsigned char relay_state[2];                          /*!< Last State Set on Each Relay */
+};
+
+
+/*!
+	\brief Represents a Health Monitor Policy
+
+	A controller is pinged only after interval_ms without a successful transaction, and only
+	in an idle slot: nobody waiting for the bus and no frame for the last idle_ms.
+*/
+struct VMC96_health_policy_s
+{
+	unsigned int interval_ms;         /*!< Silence Before a Controller is Pinged (e.g. 5000) */
+	unsigned int idle_ms;             /*!< Bus Quiet Time Required Before a Ping (e.g. 50) */
+	unsigned int timeout_ms;          /*!< Ping Response Timeout, Longest Wait Imposed on a Command (e.g. 50) */
+	unsigned int failures;            /*!< Consecutive Failed Pings Declaring a Controller Dead */
+};
+
+
+/*!
+	\brief Represents the Liveness of a Controller
+*/
+struct VMC96_controller_health_s
+{
+	unsigned char id_controller;      /*!< K1 Controller Address */
+	unsigned char alive;              /*!< Answered Recently (Traffic or Ping) */
+	unsigned int failures;            /*!< Consecutive Failed Pings */
+	unsigned long long last_seen_us;  /*!< CLOCK_MONOTONIC Time of the Last Successful Transaction (0 if Never) */
+	unsigned long pings;              /*!< Pings Sent */
+	unsigned long deferred;           /*!< Idle Slot Checks That Found the Bus Busy While a Ping Was Due */
+};
+
+
+/*!
+	\brief Represents the Liveness of the Board Controllers
+*/
+struct VMC96_health_s
+{
+	VMC96_controller_health_t controller[ VMC96_HEALTH_CONTROLLERS_COUNT ];  /*!< VMC96_HEALTH_* Index */
+};
+
+
+/*!
+	\brief Represents a Byte Transport to the Board (Default: libftdi)
+*/
+struct VMC96_transport_s
+{
+	int (*purge)( void * userdata );                                          /*!< Discard Pending Bytes, < 0 on Error */
+	int (*write)( void * userdata, const unsigned char * buf, int len );      /*!< Bytes Written, < 0 on Error */
+	int (*read)( void * userdata, unsigned char * buf, int len );             /*!< Bytes Read (0 if None Yet), < 0 on Error */
+	void (*close)( void * userdata );                                         /*!< Called by vmc96_finish() (May be NULL) */
+	unsigned int read_delay_ms;                                               /*!< Delay Between Reads (0 if read() Waits by Itself) */
+	void * userdata;                                                          /*!< Passed to the Callbacks */
+};
+
+
+/*!
+	\brief Trace Callback, Called for Every Traced Frame from the Thread Doing the Transaction
+*/
+typedef void (*VMC96_trace_callback_t)( VMC96_t * vmc96, const VMC96_trace_record_t * record, void * userdata );
+
+
+/*!
+	\brief Timer Expiration Callback, called from the timer thread after the action was issued.
+*/
+typedef void (*VMC96_timer_callback_t)( VMC96_t * vmc96, unsigned int timer, const VMC96_sequence_step_t * action, void * userdata );
+
+
+/*!
+	\brief Liveness Change Callback, called from the health monitor thread.
+*/
+typedef void (*VMC96_health_callback_t)( VMC96_t * vmc96, const VMC96_controller_health_t * health, void * userdata );
+
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -226,6 +585,21 @@ extern "C"
 	*/
 	int vmc96_motor_pair_run( VMC96_t * vmc96, unsigned char row, unsigned char col1, unsigned char col2 );
 
+	/*!
+		\brief Run a set of motors using as few K1 frames as the controller accepts.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param set Motor Array bitmap, every non-zero entry is a motor to run.
+		\return Returns VMC96_SUCCESS in case of success.
+
+		The maximum number of motors per frame is discovered on the first calls
+		and cached in the context: a NAKed frame of a never accepted length is
+		resent shorter, bisecting between the longest accepted and the shortest
+		NAKed length. Timeouts and invalid responses end the call; with a retry
+		policy set, a timed-out frame is resent only with the motors that a
+		status read shows not running (see vmc96_set_retry_policy).
+	*/
+	int vmc96_motor_run_set( VMC96_t * vmc96, const VMC96_motor_array_t * set );
+
 	/*!
 		\brief Retrieve Opto Line Status.
 		\param vmc96 Pointer to VMC96 Context Object.
@@ -252,6 +626,257 @@ extern "C"
 	*/
 	int vmc96_motor_give_pulse( VMC96_t * vmc96, unsigned char row, unsigned char col, unsigned char duration_ms );
 
+	/*!
+		\brief Start a Timed Sequence in Background.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param steps Steps sorted by offset_ms, must remain valid until vmc96_sequence_wait() returns.
+		\param count Steps count.
+		\return Returns VMC96_SUCCESS in case of success.
+
+		Steps are fired by a timerfd on CLOCK_MONOTONIC relative to the sequence start,
+		so delays do not accumulate drift. Only one sequence may run per context.
+	*/
+	int vmc96_sequence_start( VMC96_t * vmc96, VMC96_sequence_step_t * steps, unsigned int count );
+
+	/*!
+		\brief Wait for the Running Sequence to Finish.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return Returns VMC96_SUCCESS if every step succeeded, otherwise the first failing step result.
+	*/
+	int vmc96_sequence_wait( VMC96_t * vmc96 );
+
+	/*!
+		\brief Cancel the Running Sequence, Pending Steps are Marked as Canceled.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_sequence_cancel( VMC96_t * vmc96 );
+
+	/*!
+		\brief Schedule a Delayed Action (e.g. Relay Auto-Off, Motor Stop After a Maximum Runtime).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param delay_ms Delay in milliseconds (VMC96_TIMER_RESOLUTION_MS resolution).
+		\param action Action to issue on expiration (offset_ms is ignored), VMC96_SEQUENCE_ACTION_NONE only calls back.
+		\param callback Optional expiration callback (may be NULL).
+		\param userdata Callback user data.
+		\param timer Receives the timer handle (may be NULL).
+		\return Returns VMC96_SUCCESS in case of success, VMC96_ERROR_TIMER_INVALID_DELAY if delay_ms exceeds VMC96_TIMER_MAX_DELAY_MS.
+	*/
+	int vmc96_timer_schedule( VMC96_t * vmc96, unsigned int delay_ms, const VMC96_sequence_step_t * action,
+		VMC96_timer_callback_t callback, void * userdata, unsigned int * timer );
+
+	/*!
+		\brief Cancel a Pending Timer.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param timer Timer handle.
+		\return Returns VMC96_SUCCESS in case of success, VMC96_ERROR_TIMER_NOT_PENDING if already expired or canceled.
+	*/
+	int vmc96_timer_cancel( VMC96_t * vmc96, unsigned int timer );
+
+	/*!
+		\brief Set the Retry Policy for Transient Errors (Default: Retries Disabled).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param policy Retry Policy.
+		\return Returns VMC96_SUCCESS in case of success, VMC96_ERROR_INVALID_RETRY_POLICY if the multiplier is 0 or the delays are inverted.
+	*/
+	int vmc96_set_retry_policy( VMC96_t * vmc96, const VMC96_retry_policy_t * policy );
+
+	/*!
+		\brief Retrieve Retry Engine Counters.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param stats Buffer to store the counters.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_get_retry_stats( VMC96_t * vmc96, VMC96_retry_stats_t * stats );
+
+	/*!
+		\brief Set the Response Timeout Policy (Default: Fixed).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param policy Timeout Policy.
+		\return Returns VMC96_SUCCESS in case of success, VMC96_ERROR_INVALID_TIMEOUT_POLICY if floor_ms exceeds the fixed timeout.
+	*/
+	int vmc96_set_timeout_policy( VMC96_t * vmc96, const VMC96_timeout_policy_t * policy );
+
+	/*!
+		\brief Retrieve Latency, Error and Traffic Statistics.
+		The copy is taken without the context lock (seqlock), so it never delays a command.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param stats Buffer to store the statistics.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_get_stats( VMC96_t * vmc96, VMC96_stats_t * stats );
+
+	/*!
+		\brief Reset Statistics.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return void
+	*/
+	void vmc96_reset_stats( VMC96_t * vmc96 );
+
+	/*!
+		\brief Latency Percentile of a Histogram.
+		\param h Histogram.
+		\param percentile Percentile (0 to 100).
+		\return Upper limit of the bucket holding the percentile in nanoseconds.
+	*/
+	unsigned long long vmc96_histogram_percentile( const VMC96_histogram_t * h, double percentile );
+
+	/*!
+		\brief Samples of a Histogram Known to Be Below a Limit (Cumulative Count, e.g. Prometheus Buckets).
+		\param h Histogram.
+		\param ns Limit in nanoseconds.
+		\return Samples of the buckets entirely below the limit.
+	*/
+	unsigned long long vmc96_histogram_count_below( const VMC96_histogram_t * h, unsigned long long ns );
+
+	/*!
+		\brief Start Tracing K1 Frames into a Ring (Overwriting the Oldest Records).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param records Ring size, a power of two (0 keeps the current ring). The ring is allocated by
+		the first call and never resized: a different size returns VMC96_ERROR_TRACE_INVALID_SIZE.
+		\param callback Optional callback called for every frame (NULL for none).
+		\param userdata Callback user data.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_trace_start( VMC96_t * vmc96, unsigned int records, VMC96_trace_callback_t callback, void * userdata );
+
+	/*!
+		\brief Stop Tracing. The ring is kept for vmc96_trace_dump().
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return void
+	*/
+	void vmc96_trace_stop( VMC96_t * vmc96 );
+
+	/*!
+		\brief Write the Trace Ring as Binary (VMC96_trace_dump_header_t + Records).
+		Lock-free: it may run while transactions are in progress, even from a signal handler.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param fd File descriptor to write to.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_trace_dump( VMC96_t * vmc96, int fd );
+
+	/*!
+		\brief Start Recording Every K1 Frame into a Capture File.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param fd File descriptor to write to (VMC96_capture_header_t is written first).
+		\param board_id Board identification stored in the header (may be NULL).
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_capture_start( VMC96_t * vmc96, int fd, const char * board_id );
+
+	/*!
+		\brief Stop Recording. The file descriptor is not closed.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return Returns VMC96_SUCCESS, or VMC96_ERROR_CAPTURE_WRITE if a record could not be written.
+	*/
+	int vmc96_capture_stop( VMC96_t * vmc96 );
+
+	/*!
+		\brief Initialize VMC96 Context Object Over a Custom Transport (Simulators, Replay).
+		\param ppvmc96 Pointer to VMC96 Context Object.
+		\param transport Transport callbacks (copied).
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_initialize_transport( VMC96_t ** ppvmc96, const VMC96_transport_t * transport );
+
+	/*!
+		\brief Send a Raw K1 Request and Receive its Response Data.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param id_controller K1 controller address.
+		\param command K1 command code.
+		\param data Request data (may be NULL).
+		\param data_length Request data length (up to VMC96_REQUEST_DATA_MAX_LEN).
+		\param response Buffer to store the response data, VMC96_REQUEST_DATA_MAX_LEN bytes (may be NULL).
+		\param response_length Buffer to store the response data length (may be NULL).
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_k1_request( VMC96_t * vmc96, unsigned char id_controller, unsigned char command, const unsigned char * data, unsigned int data_length, unsigned char * response, unsigned int * response_length );
+
+	/*!
+		\brief Send an Already Encoded K1 Frame and Receive its Response Data.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param frame Complete K1 frame (STX, controller, length, command, data, checksum). A wrong checksum returns VMC96_ERROR_INVALID_REQUEST.
+		\param length Frame length (must match the frame length field).
+		\param response Buffer to store the response data, VMC96_REQUEST_DATA_MAX_LEN bytes (may be NULL).
+		\param response_length Buffer to store the response data length (may be NULL).
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_k1_request_frame( VMC96_t * vmc96, const unsigned char * frame, unsigned int length, unsigned char * response, unsigned int * response_length );
+
+	/*!
+		\brief Get the Priority Class of a K1 Command.
+		\param id_controller K1 controller address.
+		\param command K1 command code.
+		\return Returns VMC96_COMMAND_CLASS_*.
+	*/
+	int vmc96_k1_command_class( unsigned char id_controller, unsigned char command );
+
+	/*!
+		\brief Publish the Latest Decoded Board State into a POSIX Shared-Memory Page.
+		Every successful status, opto, scan and relay call updates the page (no extra K1 traffic).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param name Shared-memory object name (e.g. "/vmc96-0").
+		\return Returns VMC96_SUCCESS in case of success, or VMC96_ERROR_STATUS_PAGE_IN_USE if a running process publishes that name.
+	*/
+	int vmc96_status_page_publish( VMC96_t * vmc96, const char * name );
+
+	/*!
+		\brief Stop Publishing and Remove the Shared-Memory Page (Also Done by vmc96_finish()).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return void
+	*/
+	void vmc96_status_page_unpublish( VMC96_t * vmc96 );
+
+	/*!
+		\brief Map a Published Status Page Read-Only (Any Process, No Board Access Needed).
+		\param name Shared-memory object name.
+		\param page Pointer to store the mapped page.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_status_page_open( const char * name, const VMC96_status_page_t ** page );
+
+	/*!
+		\brief Take a Consistent Snapshot of a Status Page (Seqlock Read, No System Calls).
+		\param page Page mapped by vmc96_status_page_open().
+		\param snapshot Buffer to store the snapshot.
+		\return Returns VMC96_SUCCESS, or VMC96_ERROR_STATUS_PAGE_BUSY if the publisher never finished a write.
+	*/
+	int vmc96_status_page_read( const VMC96_status_page_t * page, VMC96_status_page_t * snapshot );
+
+	/*!
+		\brief Unmap a Status Page Mapped by vmc96_status_page_open().
+		\param page Mapped page.
+		\return void
+	*/
+	void vmc96_status_page_close( const VMC96_status_page_t * page );
+
+	/*!
+		\brief Start Monitoring the Liveness of the Relay and Motor Array Controllers.
+		Pings are sent only in idle bus slots and only to controllers without recent successful traffic.
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param policy Health Policy.
+		\param callback Optional callback called when a controller goes alive or dead (NULL for none).
+		\param userdata Callback user data.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_health_start( VMC96_t * vmc96, const VMC96_health_policy_t * policy, VMC96_health_callback_t callback, void * userdata );
+
+	/*!
+		\brief Stop the Health Monitor (Also Done by vmc96_finish()).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\return void
+	*/
+	void vmc96_health_stop( VMC96_t * vmc96 );
+
+	/*!
+		\brief Retrieve the Liveness of the Controllers (Never Waits for the Bus).
+		\param vmc96 Pointer to VMC96 Context Object.
+		\param health Buffer to store the liveness.
+		\return Returns VMC96_SUCCESS in case of success.
+	*/
+	int vmc96_health_get( VMC96_t * vmc96, VMC96_health_t * health );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,485 @@
+/*!
+	\file vmc96api.hpp
+	\brief VMC96 Vending Machine Controller Board C++ Wrapper (Header Only, C++17 or Later)
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#ifndef __VMC96API_HPP__
+#define __VMC96API_HPP__
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if (__cplusplus >= 202002L) && __has_include( <span> )
+#include <span>
+#endif
+
+#include "vmc96api.h"
+
+
+namespace vmc96
+{
+
+/* ********************************************************************* */
+/* *                               SPAN                                * */
+/* ********************************************************************* */
+
+#if (__cplusplus >= 202002L) && __has_include( <span> )
+
+	using std::span;
+	using std::dynamic_extent;
+
+#else
+
+	inline constexpr std::size_t dynamic_extent = static_cast<std::size_t>( -1 );
+
+	/*!
+		\brief Minimal Read/Write View of Contiguous Elements (std::span Subset for C++17)
+	*/
+	template <typename T, std::size_t Extent = dynamic_extent>
+	class span
+	{
+	public:
+		constexpr span() noexcept : m_data( nullptr ), m_size( 0 ) {}
+		constexpr span( T * data, std::size_t size ) noexcept : m_data( data ), m_size( size ) {}
+		template <std::size_t N> constexpr span( T (&arr)[N] ) noexcept : m_data( arr ), m_size( N ) {}
+		template <typename U, std::size_t N> constexpr span( std::array<U, N> & arr ) noexcept : m_data( arr.data() ), m_size( N ) {}
+		template <typename U, std::size_t N> constexpr span( const std::array<U, N> & arr ) noexcept : m_data( arr.data() ), m_size( N ) {}
+		template <typename U, std::size_t E> constexpr span( const span<U, E> & other ) noexcept : m_data( other.data() ), m_size( other.size() ) {}
+
+		constexpr T * data() const noexcept { return m_data; }
+		constexpr std::size_t size() const noexcept { return m_size; }
+		constexpr bool empty() const noexcept { return m_size == 0; }
+		constexpr T * begin() const noexcept { return m_data; }
+		constexpr T * end() const noexcept { return m_data + m_size; }
+		constexpr T & operator[]( std::size_t i ) const noexcept { return m_data[i]; }
+		constexpr span<T> first( std::size_t count ) const noexcept { return span<T>( m_data, count ); }
+		constexpr span<T> subspan( std::size_t offset, std::size_t count ) const noexcept { return span<T>( m_data + offset, count ); }
+
+	private:
+		T * m_data;
+		std::size_t m_size;
+	};
+
+#endif
+
+
+/* ********************************************************************* */
+/* *                              ERRORS                               * */
+/* ********************************************************************* */
+
+	/*!
+		\brief Failed VMC96 Call (code() is the VMC96_ERROR_* Code)
+	*/
+	class error : public std::runtime_error
+	{
+	public:
+		explicit error( int code ) : std::runtime_error( vmc96_get_error_code_string( code ) ), m_code( code ) {}
+
+		int code() const noexcept { return m_code; }
+
+	private:
+		int m_code;
+	};
+
+
+	/*!
+		\brief Throws vmc96::error Unless ret is VMC96_SUCCESS
+	*/
+	inline void check( int ret )
+	{
+		if( ret != VMC96_SUCCESS )
+			throw error( ret );
+	}
+
+
+/* ********************************************************************* */
+/* *                        MOTOR COORDINATES                          * */
+/* ********************************************************************* */
+
+	/*!
+		\brief Motor Array Row (Strong Type)
+	*/
+	struct row
+	{
+		unsigned char value;
+
+		constexpr explicit row( unsigned int v ) : value( static_cast<unsigned char>( v < VMC96_MOTOR_ARRAY_ROWS_COUNT ? v : throw std::out_of_range( "vmc96::row" ) ) ) {}
+	};
+
+
+	/*!
+		\brief Motor Array Column (Strong Type)
+	*/
+	struct column
+	{
+		unsigned char value;
+
+		constexpr explicit column( unsigned int v ) : value( static_cast<unsigned char>( v < VMC96_MOTOR_ARRAY_COLUMNS_COUNT ? v : throw std::out_of_range( "vmc96::column" ) ) ) {}
+	};
+
+
+	/*!
+		\brief Motor Array Coordinate
+
+		Rows and columns are range checked on construction: in a constant
+		expression an invalid coordinate does not compile, at run time it
+		throws std::out_of_range.
+	*/
+	class motor
+	{
+	public:
+		constexpr motor( vmc96::row r, vmc96::column c ) noexcept : m_row( r ), m_column( c ) {}
+
+		constexpr unsigned char row() const noexcept { return m_row.value; }
+		constexpr unsigned char column() const noexcept { return m_column.value; }
+
+		/*! K1 motor address: ((row + 1) << 4) + (column + 1) */
+		constexpr unsigned char id() const noexcept { return static_cast<unsigned char>( ((m_row.value + 1) << 4) + (m_column.value + 1) ); }
+
+	private:
+		vmc96::row m_row;
+		vmc96::column m_column;
+	};
+
+
+	namespace detail
+	{
+		template <unsigned int Row, unsigned int Column>
+		struct checked_motor
+		{
+			static_assert( Row < VMC96_MOTOR_ARRAY_ROWS_COUNT, "vmc96::motor_v: row out of range" );
+			static_assert( Column < VMC96_MOTOR_ARRAY_COLUMNS_COUNT, "vmc96::motor_v: column out of range" );
+
+			static constexpr motor value = motor( vmc96::row( Row ), vmc96::column( Column ) );
+		};
+	}
+
+	/*!
+		\brief Motor Known at Compile Time (Checked by static_assert)
+	*/
+	template <unsigned int Row, unsigned int Column>
+	inline constexpr motor motor_v = detail::checked_motor<Row, Column>::value;
+
+
+/* ********************************************************************* */
+/* *                          K1 FRAMES                                * */
+/* ********************************************************************* */
+
+	/*!
+		\brief K1 Controller Addresses
+	*/
+	enum class controller : unsigned char
+	{
+		global      = 0x00,
+		relay1      = 0x26,
+		relay2      = 0x27,
+		motor_array = 0x30
+	};
+
+
+	/*!
+		\brief K1 Command Codes
+	*/
+	enum class command : unsigned char
+	{
+		ping                   = 0x00,
+		global_reset           = 0x01,
+		version                = 0x02,
+		reset                  = 0x05,
+		motor_status           = 0x10,
+		motor_scan_array       = 0x11,
+		relay_function         = 0x11,
+		motor_stop_all         = 0x12,
+		motor_run              = 0x13,
+		motor_give_pulse       = 0x14,
+		motor_opto_line_status = 0x15
+	};
+
+
+	/*!
+		\brief Encoded K1 Frame: STX, Controller, Length, Command, N Data Bytes, XOR Checksum
+	*/
+	template <std::size_t N>
+	struct frame
+	{
+		static_assert( N <= VMC96_REQUEST_DATA_MAX_LEN, "K1 frame data too long" );
+
+		std::array<unsigned char, N + 5> bytes;
+
+		constexpr const unsigned char * data() const noexcept { return bytes.data(); }
+		static constexpr std::size_t size() noexcept { return N + 5; }
+	};
+
+
+	/*!
+		\brief Encode a K1 Frame (Evaluated by the Compiler When its Arguments are Constants)
+	*/
+	template <std::size_t N = 0>
+	constexpr frame<N> encode( controller id, command cmd, const std::array<unsigned char, N> & data = {} ) noexcept
+	{
+		frame<N> f{};
+		unsigned char cks = 0;
+
+		f.bytes[0] = 0x35;
+		f.bytes[1] = static_cast<unsigned char>( id );
+		f.bytes[2] = static_cast<unsigned char>( N + 5 );
+		f.bytes[3] = static_cast<unsigned char>( cmd );
+
+		for( std::size_t i = 0; i < N; i++ )
+			f.bytes[4 + i] = data[i];
+
+		for( std::size_t i = 0; i < N + 4; i++ )
+			cks ^= f.bytes[i];
+
+		f.bytes[N + 4] = cks;
+
+		return f;
+	}
+
+
+	/*!
+		\brief Frames of the Library Commands
+	*/
+	namespace frames
+	{
+		inline constexpr auto motor_ping        = encode( controller::motor_array, command::ping );
+		inline constexpr auto motor_version     = encode( controller::motor_array, command::version );
+		inline constexpr auto motor_reset       = encode( controller::motor_array, command::reset );
+		inline constexpr auto motor_status      = encode( controller::motor_array, command::motor_status );
+		inline constexpr auto motor_scan_array  = encode( controller::motor_array, command::motor_scan_array );
+		inline constexpr auto motor_stop_all    = encode( controller::motor_array, command::motor_stop_all );
+		inline constexpr auto motor_opto_line   = encode( controller::motor_array, command::motor_opto_line_status );
+		inline constexpr auto global_reset      = encode<1>( controller::global, command::global_reset, { 0xFF } );
+
+		constexpr frame<1> motor_run( motor m ) noexcept
+		{
+			return encode<1>( controller::motor_array, command::motor_run, { m.id() } );
+		}
+
+		constexpr frame<2> motor_pair_run( motor m1, motor m2 ) noexcept
+		{
+			return encode<2>( controller::motor_array, command::motor_run, { m1.id(), m2.id() } );
+		}
+
+		constexpr frame<2> motor_give_pulse( motor m, unsigned char duration_ms ) noexcept
+		{
+			return encode<2>( controller::motor_array, command::motor_give_pulse, { m.id(), duration_ms } );
+		}
+
+		constexpr controller relay( unsigned int id )
+		{
+			return ( id == 0 ) ? controller::relay1 : ( id == 1 ) ? controller::relay2 : throw std::out_of_range( "vmc96::frames::relay" );
+		}
+
+		constexpr frame<1> relay_control( unsigned int id, bool state )
+		{
+			return encode<1>( relay( id ), command::relay_function, { static_cast<unsigned char>( state ? 1 : 0 ) } );
+		}
+
+		/*! Frame fully computed at compile time: vmc96::frames::motor_run_v<2, 5> */
+		template <unsigned int Row, unsigned int Column>
+		inline constexpr frame<1> motor_run_v = motor_run( motor_v<Row, Column> );
+	}
+
+
+/* ********************************************************************* */
+/* *                          RESULT VIEWS                             * */
+/* ********************************************************************* */
+
+	/*! Motor array cells, row major (rows x columns) */
+	inline span<const unsigned char, VMC96_MOTOR_ARRAY_ROWS_COUNT * VMC96_MOTOR_ARRAY_COLUMNS_COUNT> cells( const VMC96_motor_array_t & array ) noexcept
+	{
+		return span<const unsigned char, VMC96_MOTOR_ARRAY_ROWS_COUNT * VMC96_MOTOR_ARRAY_COLUMNS_COUNT>( &array.motor[0][0], VMC96_MOTOR_ARRAY_ROWS_COUNT * VMC96_MOTOR_ARRAY_COLUMNS_COUNT );
+	}
+
+	/*! Opto-sensor samples, oldest first */
+	inline span<const unsigned char, VMC96_OPTO_LINE_SAMPLES_PER_BLOCK> samples( const VMC96_opto_line_sample_block_t & block ) noexcept
+	{
+		return span<const unsigned char, VMC96_OPTO_LINE_SAMPLES_PER_BLOCK>( block.sample, VMC96_OPTO_LINE_SAMPLES_PER_BLOCK );
+	}
+
+
+/* ********************************************************************* */
+/* *                              BOARD                                * */
+/* ********************************************************************* */
+
+	/*!
+		\brief Owned VMC96 Context (RAII, Move Only)
+
+		Every call throws vmc96::error on failure. Calls from several threads
+		on one board are serialized by the library.
+	*/
+	class board
+	{
+	public:
+		/*! Opens the first VMC96 board (FTDI) */
+		board()
+		{
+			check( vmc96_initialize( &m_vmc96 ) );
+		}
+
+		/*! Uses a custom transport (simulators, replays) */
+		explicit board( const VMC96_transport_t & transport )
+		{
+			check( vmc96_initialize_transport( &m_vmc96, &transport ) );
+		}
+
+		/*! Takes ownership of an initialized context */
+		explicit board( VMC96_t * vmc96 ) noexcept : m_vmc96( vmc96 ) {}
+
+		board( const board & ) = delete;
+		board & operator=( const board & ) = delete;
+
+		board( board && other ) noexcept : m_vmc96( std::exchange( other.m_vmc96, nullptr ) ) {}
+
+		board & operator=( board && other ) noexcept
+		{
+			if( this != &other )
+			{
+				reset();
+				m_vmc96 = std::exchange( other.m_vmc96, nullptr );
+			}
+
+			return *this;
+		}
+
+		~board()
+		{
+			reset();
+		}
+
+		VMC96_t * get() const noexcept { return m_vmc96; }
+		explicit operator bool() const noexcept { return m_vmc96 != nullptr; }
+
+		/*! Gives up ownership (the caller calls vmc96_finish()) */
+		VMC96_t * release() noexcept { return std::exchange( m_vmc96, nullptr ); }
+
+		void reset() noexcept
+		{
+			if( m_vmc96 )
+				vmc96_finish( std::exchange( m_vmc96, nullptr ) );
+		}
+
+		/*!
+			\brief Send an Encoded Frame (Nothing is Encoded at Run Time)
+			\return The response data, a view into buffer.
+		*/
+		template <std::size_t N>
+		span<unsigned char> send( const frame<N> & f, span<unsigned char> buffer = {} )
+		{
+			unsigned char scratch[ VMC96_REQUEST_DATA_MAX_LEN ];
+			unsigned int length = 0;
+
+			check( vmc96_k1_request_frame( m_vmc96, f.data(), static_cast<unsigned int>( f.size() ), scratch, &length ) );
+
+			if( length > buffer.size() )
+				length = static_cast<unsigned int>( buffer.size() );
+
+			for( unsigned int i = 0; i < length; i++ )
+				buffer[i] = scratch[i];
+
+			return buffer.first( length );
+		}
+
+		/*!
+			\brief Send a Raw Request Encoded at Run Time
+			\return The response data, a view into buffer.
+		*/
+		span<unsigned char> request( controller id, command cmd, span<const unsigned char> data, span<unsigned char> buffer )
+		{
+			unsigned char scratch[ VMC96_REQUEST_DATA_MAX_LEN ];
+			unsigned int length = 0;
+
+			check( vmc96_k1_request( m_vmc96, static_cast<unsigned char>( id ), static_cast<unsigned char>( cmd ), data.data(), static_cast<unsigned int>( data.size() ), scratch, &length ) );
+
+			if( length > buffer.size() )
+				length = static_cast<unsigned int>( buffer.size() );
+
+			for( unsigned int i = 0; i < length; i++ )
+				buffer[i] = scratch[i];
+
+			return buffer.first( length );
+		}
+
+		/* Fixed frames go through the C functions: one encoding (the C frame table) for both APIs */
+		void motor_run( motor m ) { check( vmc96_motor_run( m_vmc96, m.row(), m.column() ) ); }
+		void motor_pair_run( motor m1, motor m2 ) { send( frames::motor_pair_run( m1, m2 ) ); }
+		void motor_give_pulse( motor m, unsigned char duration_ms ) { send( frames::motor_give_pulse( m, duration_ms ) ); }
+		void motor_stop_all() { check( vmc96_motor_stop_all( m_vmc96 ) ); }
+		void motor_reset() { check( vmc96_motor_reset( m_vmc96 ) ); }
+		void motor_ping() { check( vmc96_motor_ping( m_vmc96 ) ); }
+		void global_reset() { check( vmc96_global_reset( m_vmc96 ) ); }
+		void relay_control( unsigned int id, bool state ) { check( vmc96_relay_control( m_vmc96, static_cast<unsigned char>( id ), state ? 1 : 0 ) ); }
+
+		void motor_run_set( const VMC96_motor_array_t & set ) { check( vmc96_motor_run_set( m_vmc96, &set ) ); }
+
+		/* Decoded reads go through the C decoders (status page, coalescing) */
+		VMC96_motor_array_status_t motor_get_status()
+		{
+			VMC96_motor_array_status_t status;
+			check( vmc96_motor_get_status( m_vmc96, &status ) );
+			return status;
+		}
+
+		VMC96_motor_array_scan_result_t motor_scan_array()
+		{
+			VMC96_motor_array_scan_result_t result;
+			check( vmc96_motor_scan_array( m_vmc96, &result ) );
+			return result;
+		}
+
+		VMC96_opto_line_sample_block_t motor_opto_line_status()
+		{
+			VMC96_opto_line_sample_block_t block;
+			check( vmc96_motor_opto_line_status( m_vmc96, &block ) );
+			return block;
+		}
+
+		std::string motor_get_version()
+		{
+			char version[ VMC96_REQUEST_DATA_MAX_LEN + 1 ];
+			check( vmc96_motor_get_version( m_vmc96, version ) );
+			return std::string( version );
+		}
+
+		std::string relay_get_version( unsigned int id )
+		{
+			char version[ VMC96_REQUEST_DATA_MAX_LEN + 1 ];
+			check( vmc96_relay_get_version( m_vmc96, static_cast<unsigned char>( id ), version ) );
+			return std::string( version );
+		}
+
+	private:
+		VMC96_t * m_vmc96 = nullptr;
+	};
+
+}
+
+#endif
+
+/* eof */
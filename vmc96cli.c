@@ -30,6 +30,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "vmc96api.h"
 
@@ -56,6 +66,8 @@
 #define VMC96CLI_COMMAND_MOTOR_STATUS                     (9)
 #define VMC96CLI_COMMAND_ARRAY_SCAN                       (10)
 #define VMC96CLI_COMMAND_GIVE_PULSE                       (11)
+#define VMC96CLI_COMMAND_BENCH                            (12)
+#define VMC96CLI_COMMAND_SOAK                             (13)
 #define VMC96CLI_COMMAND_INVALID                          (-1)
 #define VMC96CLI_COMMAND_NOT_SPECIFIED                    (-2)
 
@@ -72,15 +84,38 @@
 #define VMC96CLI_ERROR_ARGS_MOTOR_COLUMN1                 (-10)
 #define VMC96CLI_ERROR_ARGS_MOTOR_COLUMN2                 (-11)
 #define VMC96CLI_ERROR_ARGS_DURATION                      (-12)
+#define VMC96CLI_ERROR_CAPTURE                            (-13)
+#define VMC96CLI_ERROR_SCRIPT                             (-14)
+#define VMC96CLI_ERROR_SESSION_LINE_FAILED                (-15)
+#define VMC96CLI_ERROR_ARGS_WATCH                         (-16)
+#define VMC96CLI_ERROR_PUBLISH                            (-17)
+#define VMC96CLI_ERROR_METRICS                            (-18)
+#define VMC96CLI_ERROR_SESSION_LINE_TOO_LONG              (-19)
+#define VMC96CLI_ERROR_SESSION_OPTION                     (-20)
 
 #define VMC96CLI_ARGUMENT_NOT_INITIALIZED                 (-1)
 
+#define VMC96CLI_SESSION_LINE_MAX_LEN                     (1024)
+#define VMC96CLI_SESSION_MAX_TOKENS                       (32)
+#define VMC96CLI_SESSION_PROMPT                           "vmc96> "
+
+#define VMC96CLI_BENCH_DEFAULT_ITERATIONS                 (1000)
+#define VMC96CLI_SOAK_DEFAULT_SECONDS                     (600)
+
+#define VMC96CLI_WATCH_DEFAULT_CURRENT_THRESHOLD_MA       (50)
+
+#define VMC96CLI_METRICS_TEXTFILE_PERIOD_MS               (1000)
+#define VMC96CLI_METRICS_POLL_MS                          (200)    /* Exporter stop latency */
+#define VMC96CLI_METRICS_REQUEST_MAX_LEN                  (1024)
+#define VMC96CLI_METRICS_PATH_MAX_LEN                     (1024)
+
 
 /* ********************************************************************* */
 /* *                        STRUCTS AND DATA TYPES                     * */
 /* ********************************************************************* */
 
 typedef struct vmc96cli_arguments_s vmc96cli_arguments_t;
+typedef struct vmc96cli_metrics_s vmc96cli_metrics_t;
 
 struct vmc96cli_arguments_s
 {
@@ -92,6 +127,29 @@ struct vmc96cli_arguments_s
 	int row;
 	int col1;
 	int col2;
+	const char * capture;
+	const char * script;
+	int timing;
+	int keep_going;
+	int iterations;
+	int seconds;
+	double watch_hz;
+	int current_threshold;
+	int json;
+	const char * publish;
+	const char * metrics;
+	int metrics_port;
+};
+
+
+struct vmc96cli_metrics_s
+{
+	VMC96_t * vmc96;
+	const char * path;
+	int listen_fd;
+	int stop;
+	pthread_t thread;
+	VMC96_stats_t * stats;
 };
 
 
@@ -105,6 +163,31 @@ static int vmc96cli_get_cntrl_code( const char * cntrl );
 static int vmc96cli_get_cmd_code( const char * cmd );
 static int vmc96cli_execute( VMC96_t * vmc96, vmc96cli_arguments_t * args );
 static int vmc96cli_proccess_arguments( int argc, char ** argv, vmc96cli_arguments_t * args );
+static int vmc96cli_session( VMC96_t * vmc96, vmc96cli_arguments_t * args );
+static void vmc96cli_signal_handler( int signum );
+static const char * vmc96cli_get_k1_cntrl_name( unsigned char id_controller );
+static const char * vmc96cli_get_k1_cmd_name( unsigned char id_controller, unsigned char command );
+static double vmc96cli_percentile_ms( const VMC96_histogram_t * h, double percentile );
+static int vmc96cli_bench( VMC96_t * vmc96, vmc96cli_arguments_t * args );
+static void vmc96cli_watch_event( vmc96cli_arguments_t * args, const char * event, int a, int b );
+static int vmc96cli_watch( VMC96_t * vmc96, vmc96cli_arguments_t * args );
+static void vmc96cli_metrics_render( vmc96cli_metrics_t * metrics, FILE * fp );
+static void * vmc96cli_metrics_thread( void * arg );
+static int vmc96cli_metrics_start( VMC96_t * vmc96, vmc96cli_arguments_t * args, vmc96cli_metrics_t * metrics );
+static void vmc96cli_metrics_stop( vmc96cli_metrics_t * metrics );
+
+
+/* ********************************************************************* */
+/* *                              GLOBALS                              * */
+/* ********************************************************************* */
+
+static volatile sig_atomic_t g_vmc96cli_interrupted = 0;
+
+/* Last polled board state (written by the watch loop, read by the metrics exporter) */
+static int g_vmc96cli_polled = 0;
+static int g_vmc96cli_last_error = VMC96_SUCCESS;
+static unsigned int g_vmc96cli_current_ma = 0;
+static unsigned int g_vmc96cli_active_count = 0;
 
 
 /* ********************************************************************* */
@@ -128,6 +211,14 @@ static const char * vmc96cli_get_error_code_string( int cod )
 		case VMC96CLI_ERROR_ARGS_MOTOR_COLUMN1            : return "Motor pair first column coordinate not especified (--column1)."; break;
 		case VMC96CLI_ERROR_ARGS_MOTOR_COLUMN2            : return "Motor pair second column coordinate not especified (--column2)."; break;
 		case VMC96CLI_ERROR_ARGS_DURATION                 : return "Pulse duration not especified (--duration)."; break;
+		case VMC96CLI_ERROR_CAPTURE                       : return "Can not record capture file (--capture)."; break;
+		case VMC96CLI_ERROR_SCRIPT                        : return "Can not open script file (--script)."; break;
+		case VMC96CLI_ERROR_SESSION_LINE_FAILED           : return "One or more session lines failed."; break;
+		case VMC96CLI_ERROR_ARGS_WATCH                    : return "Invalid polling rate (--watch)."; break;
+		case VMC96CLI_ERROR_PUBLISH                       : return "Can not publish status page (--publish)."; break;
+		case VMC96CLI_ERROR_METRICS                       : return "Can not start metrics exporter (--metrics/--metrics-port)."; break;
+		case VMC96CLI_ERROR_SESSION_LINE_TOO_LONG         : return "Session line too long or too many options."; break;
+		case VMC96CLI_ERROR_SESSION_OPTION                : return "Option only valid on the command line (--script/--watch/--capture/--publish/--metrics/--timing/--keep-going)."; break;
 		default                                           : return "Unknown error."; break;
 	}
 }
@@ -165,6 +256,21 @@ static void vmc96cli_show_usage( void )
 	printf( "	vmc96cli --controller=MOTOR_ARRAY --command=STOP_ALL\n\n" );
 	printf( "MOTOR ARRAY - GET OPTO-SENSOR STATUS:\n\n" );
 	printf( "	vmc96cli --controller=MOTOR_ARRAY --command=OPTO_LINE_STATUS\n\n" );
+	printf( "RECORD THE K1 TRAFFIC OF ANY COMMAND (REPLAY WITH vmc96replay):\n\n" );
+	printf( "	vmc96cli --controller=MOTOR_ARRAY --command=PING --capture=capture.bin\n\n" );
+	printf( "LATENCY CHARACTERIZATION - PING/STATUS/OPTO ROUND TRIPS (GLOBAL RUNS ALL CONTROLLERS):\n\n" );
+	printf( "	vmc96cli --controller=[GLOBAL|RELAY1|RELAY2|MOTOR_ARRAY] --command=BENCH [--iterations=N]\n" );
+	printf( "	vmc96cli --controller=[GLOBAL|RELAY1|RELAY2|MOTOR_ARRAY] --command=SOAK [--seconds=T]\n\n" );
+	printf( "WATCH MOTORS, CURRENT AND OPTO-SENSOR (PRINTS CHANGES ONLY, CTRL+C TO STOP):\n\n" );
+	printf( "	vmc96cli --watch=[HZ] [--current-threshold=MA] [--json]\n\n" );
+	printf( "PUBLISH THE WATCHED STATE TO A SHARED-MEMORY STATUS PAGE (READ WITH vmc96_status_page_read):\n\n" );
+	printf( "	vmc96cli --watch=[HZ] --publish=/vmc96-0\n\n" );
+	printf( "EXPORT PROMETHEUS METRICS (TEXTFILE COLLECTOR OR HTTP ON 127.0.0.1) WHILE WATCHING OR RUNNING A SESSION:\n\n" );
+	printf( "	vmc96cli --watch=[HZ] --metrics=/var/lib/node_exporter/vmc96.prom\n" );
+	printf( "	vmc96cli --watch=[HZ] --metrics-port=9196\n\n" );
+	printf( "RUN A SESSION (ONE COMMAND PER LINE, SAME OPTIONS WITHOUT THE LEADING --):\n\n" );
+	printf( "	vmc96cli --script=commissioning.txt [--timing] [--keep-going]\n" );
+	printf( "	echo \"controller=MOTOR_ARRAY command=PING\" | vmc96cli --script=-\n\n" );
 	printf( "SHOW USAGE:\n\n" );
 	printf( "	vmc96cli --help\n\n" );
 }
@@ -211,6 +317,10 @@ static int vmc96cli_get_cmd_code( const char * cmd )
 		return VMC96CLI_COMMAND_ARRAY_SCAN;
 	else if( !strcasecmp( cmd, "GIVE_PULSE" ) )
 		return VMC96CLI_COMMAND_GIVE_PULSE;
+	else if( !strcasecmp( cmd, "BENCH" ) )
+		return VMC96CLI_COMMAND_BENCH;
+	else if( !strcasecmp( cmd, "SOAK" ) )
+		return VMC96CLI_COMMAND_SOAK;
 	else if( !strcasecmp( cmd, "" ) )
 		return VMC96CLI_COMMAND_NOT_SPECIFIED;
 	else
@@ -228,6 +338,10 @@ static int vmc96cli_execute( VMC96_t * vmc96, vmc96cli_arguments_t * args )
 	if( args->command == VMC96CLI_ARGUMENT_NOT_INITIALIZED )
 		return VMC96CLI_ERROR_ARGS_COMMAND_NOT_SPECIFIED;
 
+	/* Latency characterization is available on every controller (GLOBAL runs all of them) */
+	if( (args->command == VMC96CLI_COMMAND_BENCH) || (args->command == VMC96CLI_COMMAND_SOAK) )
+		return vmc96cli_bench( vmc96, args );
+
 	switch( args->controller )
 	{
 		/* ************************************************************** */
@@ -614,6 +728,18 @@ static int vmc96cli_proccess_arguments( int argc, char ** argv, vmc96cli_argumen
 		{ "col2",        required_argument, 0,  'h' },
 		{ "column2",     required_argument, 0,  'h' },
 		{ "help",        no_argument,       0,  'i' },
+		{ "capture",     required_argument, 0,  'j' },
+		{ "script",      required_argument, 0,  'k' },
+		{ "timing",      no_argument,       0,  'l' },
+		{ "keep-going",  no_argument,       0,  'm' },
+		{ "iterations",  required_argument, 0,  'n' },
+		{ "seconds",     required_argument, 0,  'o' },
+		{ "watch",       required_argument, 0,  'p' },
+		{ "current-threshold", required_argument, 0,  'q' },
+		{ "json",        no_argument,       0,  'r' },
+		{ "publish",     required_argument, 0,  's' },
+		{ "metrics",     required_argument, 0,  't' },
+		{ "metrics-port", required_argument, 0,  'u' },
 		{ NULL,          no_argument,       0,   0  }
 	};
 
@@ -625,10 +751,25 @@ static int vmc96cli_proccess_arguments( int argc, char ** argv, vmc96cli_argumen
 	args->col1 = VMC96CLI_ARGUMENT_NOT_INITIALIZED;
 	args->col2 = VMC96CLI_ARGUMENT_NOT_INITIALIZED;
 	args->duration = VMC96CLI_ARGUMENT_NOT_INITIALIZED;
+	args->capture = NULL;
+	args->script = NULL;
+	args->timing = 0;
+	args->keep_going = 0;
+	args->iterations = VMC96CLI_BENCH_DEFAULT_ITERATIONS;
+	args->seconds = VMC96CLI_SOAK_DEFAULT_SECONDS;
+	args->watch_hz = 0.0;
+	args->current_threshold = VMC96CLI_WATCH_DEFAULT_CURRENT_THRESHOLD_MA;
+	args->json = 0;
+	args->publish = NULL;
+	args->metrics = NULL;
+	args->metrics_port = 0;
+
+	/* Session lines are parsed with the same table: force getopt to start over */
+	optind = 0;
 
 	while(1)
 	{
-		ret = getopt_long( argc, argv, "a:b:c:d:e:f:g:h:i", options, &index );
+		ret = getopt_long( argc, argv, "a:b:c:d:e:f:g:h:ij:k:lmn:o:p:q:rs:t:u:", options, &index );
 
 		if( ret == -1 )
 			return VMC96CLI_SUCCESS;
@@ -643,6 +784,18 @@ static int vmc96cli_proccess_arguments( int argc, char ** argv, vmc96cli_argumen
 			case 'f' : args->col = atoi( optarg ); break;
 			case 'g' : args->col1 = atoi( optarg ); break;
 			case 'h' : args->col2 = atoi( optarg ); break;
+			case 'j' : args->capture = optarg; break;
+			case 'k' : args->script = optarg; break;
+			case 'l' : args->timing = 1; break;
+			case 'm' : args->keep_going = 1; break;
+			case 'n' : args->iterations = atoi( optarg ); break;
+			case 'o' : args->seconds = atoi( optarg ); break;
+			case 'p' : args->watch_hz = atof( optarg ); break;
+			case 'q' : args->current_threshold = atoi( optarg ); break;
+			case 'r' : args->json = 1; break;
+			case 's' : args->publish = optarg; break;
+			case 't' : args->metrics = optarg; break;
+			case 'u' : args->metrics_port = atoi( optarg ); break;
 
 			case 'i' :
 				vmc96cli_show_usage();
@@ -655,13 +808,707 @@ static int vmc96cli_proccess_arguments( int argc, char ** argv, vmc96cli_argumen
 }
 
 
+static int vmc96cli_session( VMC96_t * vmc96, vmc96cli_arguments_t * args )
+{
+	int ret = VMC96CLI_SUCCESS;
+	int line_ret = 0;
+	int interactive = 0;
+	int lineno = 0;
+	int argc = 0;
+	int c = 0;
+	char * token = NULL;
+	char * saveptr = NULL;
+	char line[ VMC96CLI_SESSION_LINE_MAX_LEN ];
+	char options[ VMC96CLI_SESSION_MAX_TOKENS ][ VMC96CLI_SESSION_LINE_MAX_LEN + 2 ];
+	char * argv[ VMC96CLI_SESSION_MAX_TOKENS + 1 ];
+	FILE * script = NULL;
+	struct timespec t0;
+	struct timespec t1;
+	vmc96cli_arguments_t line_args;
+
+	if( !strcmp( args->script, "-" ) )
+		script = stdin;
+	else
+		script = fopen( args->script, "r" );
+
+	if( !script )
+		return VMC96CLI_ERROR_SCRIPT;
+
+	interactive = ( script == stdin ) && isatty( STDIN_FILENO );
+
+	while(1)
+	{
+		if( interactive )
+		{
+			fprintf( stdout, VMC96CLI_SESSION_PROMPT );
+			fflush( stdout );
+		}
+
+		if( !fgets( line, sizeof(line), script ) )
+			break;
+
+		lineno++;
+		line_ret = VMC96CLI_SUCCESS;
+
+		/* argv[0] is the program name, each token becomes a long option */
+		argv[0] = "vmc96cli";
+		argc = 1;
+
+		/* A line that does not fit the buffer is dropped whole, never run as two commands */
+		if( !strchr( line, '\n' ) && !feof( script ) )
+		{
+			while( ((c = fgetc( script )) != EOF) && (c != '\n') )
+				continue;
+
+			line_ret = VMC96CLI_ERROR_SESSION_LINE_TOO_LONG;
+		}
+
+		for( token = strtok_r( line, " \t\r\n", &saveptr ); (line_ret == VMC96CLI_SUCCESS) && token && (*token != '#'); token = strtok_r( NULL, " \t\r\n", &saveptr ) )
+		{
+			/* Keep room for the terminating NULL */
+			if( argc >= VMC96CLI_SESSION_MAX_TOKENS )
+			{
+				line_ret = VMC96CLI_ERROR_SESSION_LINE_TOO_LONG;
+				break;
+			}
+
+			snprintf( options[ argc - 1 ], sizeof(options[0]), "%s%s", strncmp( token, "--", 2 ) ? "--" : "", token );
+			argv[ argc ] = options[ argc - 1 ];
+			argc++;
+		}
+
+		argv[ argc ] = NULL;
+
+		/* Blank lines and comments */
+		if( (argc == 1) && (line_ret == VMC96CLI_SUCCESS) )
+			continue;
+
+		if( (line_ret == VMC96CLI_SUCCESS) && (!strcmp( argv[1], "--quit" ) || !strcmp( argv[1], "--exit" )) )
+			break;
+
+		clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+		if( line_ret == VMC96CLI_SUCCESS )
+			line_ret = vmc96cli_proccess_arguments( argc, argv, &line_args );
+
+		/* Options that configure the whole run are only read from the command line */
+		if( (line_ret == VMC96CLI_SUCCESS) && (line_args.script || (line_args.watch_hz != 0.0) || line_args.capture || line_args.publish ||
+			line_args.metrics || line_args.metrics_port || line_args.timing || line_args.keep_going) )
+			line_ret = VMC96CLI_ERROR_SESSION_OPTION;
+
+		if( line_ret == VMC96CLI_SUCCESS )
+			line_ret = vmc96cli_execute( vmc96, &line_args );
+
+		clock_gettime( CLOCK_MONOTONIC, &t1 );
+
+		if( args->timing )
+			fprintf( stdout, "[%d] %d %s (%.3fms)\n", lineno, line_ret, vmc96cli_get_error_code_string( line_ret ),
+				(t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0 );
+		else
+			fprintf( stdout, "[%d] %d %s\n", lineno, line_ret, vmc96cli_get_error_code_string( line_ret ) );
+
+		/* Pipelines consume the results as they are produced */
+		fflush( stdout );
+
+		if( line_ret != VMC96CLI_SUCCESS )
+		{
+			ret = VMC96CLI_ERROR_SESSION_LINE_FAILED;
+
+			/* Scripts stop at the first failure, interactive sessions carry on */
+			if( !interactive && !args->keep_going )
+				break;
+		}
+	}
+
+	if( script != stdin )
+		fclose( script );
+
+	return ret;
+}
+
+
+static void vmc96cli_signal_handler( int signum )
+{
+	(void) signum;
+	g_vmc96cli_interrupted = 1;
+}
+
+
+static void vmc96cli_signal_catch( int signum, struct sigaction * previous )
+{
+	struct sigaction sa;
+
+	memset( &sa, 0, sizeof(sa) );
+	sa.sa_handler = vmc96cli_signal_handler;
+	sigemptyset( &sa.sa_mask );
+
+	sigaction( signum, &sa, previous );
+}
+
+
+static const char * vmc96cli_get_k1_cntrl_name( unsigned char id_controller )
+{
+	switch( id_controller )
+	{
+		case 0x00 : return "GLOBAL"; break;
+		case 0x26 : return "RELAY1"; break;
+		case 0x27 : return "RELAY2"; break;
+		case 0x30 : return "MOTOR_ARRAY"; break;
+		default   : return "UNKNOWN"; break;
+	}
+}
+
+
+static const char * vmc96cli_get_k1_cmd_name( unsigned char id_controller, unsigned char command )
+{
+	switch( command )
+	{
+		case 0x00 : return "PING"; break;
+		case 0x01 : return "RESET"; break;
+		case 0x02 : return "VERSION"; break;
+		case 0x05 : return "RESET"; break;
+		case 0x10 : return "STATUS"; break;
+		case 0x11 : return ( id_controller == 0x30 ) ? "SCAN" : "CONTROL"; break;
+		case 0x12 : return "STOP_ALL"; break;
+		case 0x13 : return "RUN"; break;
+		case 0x14 : return "GIVE_PULSE"; break;
+		case 0x15 : return "OPTO_LINE_STATUS"; break;
+		default   : return "UNKNOWN"; break;
+	}
+}
+
+
+static double vmc96cli_percentile_ms( const VMC96_histogram_t * h, double percentile )
+{
+	unsigned long long ns = vmc96_histogram_percentile( h, percentile );
+
+	/* The histogram reports bucket limits, never print more than the largest sample */
+	return ( ( ns < h->max_ns ) ? ns : h->max_ns ) / 1e6;
+}
+
+
+static int vmc96cli_bench( VMC96_t * vmc96, vmc96cli_arguments_t * args )
+{
+	int i = 0;
+	int relay = 0;
+	int soak = ( args->command == VMC96CLI_COMMAND_SOAK );
+	int all = ( args->controller == VMC96CLI_CONTROLLER_GLOBAL );
+	unsigned long long calls = 0;
+	unsigned long long timeouts = 0;
+	unsigned long long checksum_errors = 0;
+	double elapsed = 0.0;
+	struct timespec t0;
+	struct timespec now;
+	VMC96_motor_array_status_t status;
+	VMC96_opto_line_sample_block_t block;
+	VMC96_stats_t * stats = NULL;
+	struct sigaction previous_int;
+
+	if( (soak && (args->seconds <= 0)) || (!soak && (args->iterations <= 0)) )
+		return VMC96CLI_ERROR_INVALID_ARGS;
+
+	/* Large object: keep it off the stack */
+	stats = (VMC96_stats_t*) malloc( sizeof(VMC96_stats_t) );
+
+	if( !stats )
+		return VMC96CLI_ERROR_COMMAND_FAILED;
+
+	/* Ctrl+C ends the run early and still prints the report; an earlier run's Ctrl+C does not */
+	g_vmc96cli_interrupted = 0;
+	vmc96cli_signal_catch( SIGINT, &previous_int );
+
+	vmc96_reset_stats( vmc96 );
+	clock_gettime( CLOCK_MONOTONIC, &t0 );
+
+	for( i = 0; !g_vmc96cli_interrupted; i++ )
+	{
+		clock_gettime( CLOCK_MONOTONIC, &now );
+		elapsed = (now.tv_sec - t0.tv_sec) + (now.tv_nsec - t0.tv_nsec) / 1e9;
+
+		if( soak ? (elapsed >= args->seconds) : (i >= args->iterations) )
+			break;
+
+		/* Failures are counted by the library statistics, the run carries on */
+		for( relay = 0; relay < 2; relay++ )
+		{
+			if( all || (args->controller == VMC96CLI_CONTROLLER_RELAY1 + relay) )
+			{
+				vmc96_relay_ping( vmc96, relay );
+				calls++;
+			}
+		}
+
+		if( all || (args->controller == VMC96CLI_CONTROLLER_MOTOR_ARRAY) )
+		{
+			vmc96_motor_ping( vmc96 );
+			vmc96_motor_get_status( vmc96, &status );
+			vmc96_motor_opto_line_status( vmc96, &block );
+			calls += 3;
+		}
+	}
+
+	sigaction( SIGINT, &previous_int, NULL );
+
+	vmc96_get_stats( vmc96, stats );
+
+	fprintf( stdout, "%-12s %-17s %10s %8s %10s %10s %10s %10s\n", "CONTROLLER", "COMMAND", "REQUESTS", "ERRORS",
+		"MIN(ms)", "P50(ms)", "P99(ms)", "MAX(ms)" );
+
+	for( i = 0; i < VMC96_STATS_COMMANDS_COUNT; i++ )
+	{
+		const VMC96_command_stats_t * cs = &stats->command[i];
+
+		if( !cs->requests )
+			continue;
+
+		fprintf( stdout, "%-12s %-17s %10llu %8llu %10.3f %10.3f %10.3f %10.3f\n",
+			vmc96cli_get_k1_cntrl_name( cs->id_controller ),
+			vmc96cli_get_k1_cmd_name( cs->id_controller, cs->command ),
+			cs->requests, cs->errors,
+			cs->total.count ? cs->total.min_ns / 1e6 : 0.0,
+			vmc96cli_percentile_ms( &cs->total, 50.0 ),
+			vmc96cli_percentile_ms( &cs->total, 99.0 ),
+			cs->total.max_ns / 1e6 );
+	}
+
+	for( i = 0; i < VMC96_STATS_ERRORS_COUNT; i++ )
+	{
+		if( stats->error[i].code == VMC96_ERROR_K1_RESPONSE_TIMEOUT )
+			timeouts = stats->error[i].count;
+		else if( stats->error[i].code == VMC96_ERROR_K1_RESPONSE_INVALID_CHECKSUM )
+			checksum_errors = stats->error[i].count;
+	}
+
+	fprintf( stdout, "\nTimeouts: %llu\n", timeouts );
+	fprintf( stdout, "Checksum Errors: %llu\n", checksum_errors );
+	fprintf( stdout, "Commands: %llu in %.2fs (%.1f commands/s)\n", calls, elapsed, elapsed > 0 ? calls / elapsed : 0.0 );
+
+	free( stats );
+
+	return VMC96CLI_SUCCESS;
+}
+
+
+static void vmc96cli_watch_event( vmc96cli_arguments_t * args, const char * event, int a, int b )
+{
+	struct timespec ts;
+	unsigned long long t_ms = 0;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	t_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+
+	if( args->json )
+	{
+		if( !strcmp( event, "MOTOR_START" ) || !strcmp( event, "MOTOR_STOP" ) )
+			fprintf( stdout, "{\"t_ms\":%llu,\"event\":\"%s\",\"row\":%d,\"col\":%d}\n", t_ms, event, a, b );
+		else if( !strcmp( event, "CURRENT" ) )
+			fprintf( stdout, "{\"t_ms\":%llu,\"event\":\"%s\",\"current_ma\":%d}\n", t_ms, event, a );
+		else if( !strcmp( event, "ERROR" ) )
+			fprintf( stdout, "{\"t_ms\":%llu,\"event\":\"%s\",\"code\":%d,\"message\":\"%s\"}\n", t_ms, event, a, vmc96_get_error_code_string(a) );
+		else
+			fprintf( stdout, "{\"t_ms\":%llu,\"event\":\"%s\",\"samples\":%d}\n", t_ms, event, a );
+	}
+	else
+	{
+		if( !strcmp( event, "MOTOR_START" ) || !strcmp( event, "MOTOR_STOP" ) )
+			fprintf( stdout, "%llu %s %d %d\n", t_ms, event, a, b );
+		else if( !strcmp( event, "ERROR" ) )
+			fprintf( stdout, "%llu %s %d %s\n", t_ms, event, a, vmc96_get_error_code_string(a) );
+		else
+			fprintf( stdout, "%llu %s %d\n", t_ms, event, a );
+	}
+}
+
+
+static int vmc96cli_watch( VMC96_t * vmc96, vmc96cli_arguments_t * args )
+{
+	int ret = 0;
+	int row = 0;
+	int col = 0;
+	int i = 0;
+	int first = 1;
+	int last_error = VMC96_SUCCESS;
+	int opto_count = 0;
+	int last_opto_count = 0;
+	unsigned int last_current_ma = 0;
+	unsigned long long period_ns = 0;
+	struct timespec next;
+	VMC96_motor_array_t last_array;
+	VMC96_motor_array_status_t status;
+	VMC96_opto_line_sample_block_t block;
+	VMC96_motor_array_scan_result_t scan;
+	struct sigaction previous_int;
+	struct sigaction previous_term;
+
+	if( (args->watch_hz <= 0.0) || (args->watch_hz > 1000.0) || (args->current_threshold < 0) )
+		return VMC96CLI_ERROR_ARGS_WATCH;
+
+	period_ns = (unsigned long long)( 1e9 / args->watch_hz );
+
+	memset( &last_array, 0, sizeof(last_array) );
+
+	/* The scan is not polled (it is slow): publish the installed motors once */
+	if( args->publish )
+		vmc96_motor_scan_array( vmc96, &scan );
+
+	g_vmc96cli_interrupted = 0;
+	vmc96cli_signal_catch( SIGINT, &previous_int );
+	vmc96cli_signal_catch( SIGTERM, &previous_term );
+
+	clock_gettime( CLOCK_MONOTONIC, &next );
+
+	while( !g_vmc96cli_interrupted )
+	{
+		ret = vmc96_motor_get_status( vmc96, &status );
+
+		if( ret == VMC96_SUCCESS )
+			ret = vmc96_motor_opto_line_status( vmc96, &block );
+
+		__atomic_store_n( &g_vmc96cli_last_error, ret, __ATOMIC_RELAXED );
+
+		if( ret == VMC96_SUCCESS )
+		{
+			__atomic_store_n( &g_vmc96cli_current_ma, status.current_ma, __ATOMIC_RELAXED );
+			__atomic_store_n( &g_vmc96cli_active_count, status.active_count, __ATOMIC_RELAXED );
+			__atomic_store_n( &g_vmc96cli_polled, 1, __ATOMIC_RELEASE );
+		}
+
+		/* Errors are reported once per change, like any other state (code 0 once recovered) */
+		if( ret != last_error )
+		{
+			vmc96cli_watch_event( args, "ERROR", ret, 0 );
+			last_error = ret;
+		}
+
+		if( ret == VMC96_SUCCESS )
+		{
+			for( row = 0; row < VMC96_MOTOR_ARRAY_ROWS_COUNT; row++ )
+			{
+				for( col = 0; col < VMC96_MOTOR_ARRAY_COLUMNS_COUNT; col++ )
+				{
+					if( status.array.motor[row][col] == last_array.motor[row][col] )
+						continue;
+
+					vmc96cli_watch_event( args, status.array.motor[row][col] ? "MOTOR_START" : "MOTOR_STOP", row, col );
+				}
+			}
+
+			if( first || (abs( (int) status.current_ma - (int) last_current_ma ) >= args->current_threshold) )
+			{
+				vmc96cli_watch_event( args, "CURRENT", status.current_ma, 0 );
+				last_current_ma = status.current_ma;
+			}
+
+			/* The block is a rolling window: an edge is the sensor going from idle to triggered and back */
+			for( i = 0, opto_count = 0; i < VMC96_OPTO_LINE_SAMPLES_PER_BLOCK; i++ )
+				opto_count += block.sample[i] ? 1 : 0;
+
+			if( (opto_count > 0) && (last_opto_count == 0) )
+				vmc96cli_watch_event( args, "OPTO_RISE", opto_count, 0 );
+			else if( (opto_count == 0) && (last_opto_count > 0) )
+				vmc96cli_watch_event( args, "OPTO_FALL", 0, 0 );
+
+			memcpy( &last_array, &status.array, sizeof(last_array) );
+			last_opto_count = opto_count;
+			first = 0;
+		}
+
+		/* Consumers read the events as they happen */
+		fflush( stdout );
+
+		/* Absolute deadlines keep the rate steady; a late poll restarts the schedule instead of bursting */
+		next.tv_nsec += period_ns % 1000000000ULL;
+		next.tv_sec += period_ns / 1000000000ULL + next.tv_nsec / 1000000000L;
+		next.tv_nsec %= 1000000000L;
+
+		while( (clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL ) == EINTR) && !g_vmc96cli_interrupted );
+
+		if( !g_vmc96cli_interrupted )
+		{
+			struct timespec now;
+
+			clock_gettime( CLOCK_MONOTONIC, &now );
+
+			if( (now.tv_sec - next.tv_sec) * 1000000000LL + (now.tv_nsec - next.tv_nsec) > (long long) period_ns )
+				next = now;
+		}
+	}
+
+	sigaction( SIGINT, &previous_int, NULL );
+	sigaction( SIGTERM, &previous_term, NULL );
+
+	return VMC96CLI_SUCCESS;
+}
+
+
+static void vmc96cli_metrics_render( vmc96cli_metrics_t * metrics, FILE * fp )
+{
+	static const double le[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0 };
+	static const char * counters[][2] =
+	{
+		{ "vmc96_requests_total", "K1 frames sent (retries included)." },
+		{ "vmc96_errors_total",   "K1 frames that failed." },
+		{ "vmc96_retries_total",  "K1 frames resent by the retry engine." }
+	};
+	VMC96_stats_t * stats = metrics->stats;
+	const VMC96_command_stats_t * cs = NULL;
+	const char * cntrl = NULL;
+	const char * cmd = NULL;
+	unsigned long long value = 0;
+	unsigned int f = 0;
+	unsigned int i = 0;
+	unsigned int j = 0;
+
+	/* Pre-aggregated counters: a lock-free copy, no K1 traffic */
+	vmc96_get_stats( metrics->vmc96, stats );
+
+	/* Each family's samples must follow its own HELP/TYPE lines: one family at a time */
+	for( f = 0; f < sizeof(counters) / sizeof(counters[0]); f++ )
+	{
+		fprintf( fp, "# HELP %s %s\n# TYPE %s counter\n", counters[f][0], counters[f][1], counters[f][0] );
+
+		for( i = 0; i < VMC96_STATS_COMMANDS_COUNT; i++ )
+		{
+			cs = &stats->command[i];
+			cntrl = vmc96cli_get_k1_cntrl_name( cs->id_controller );
+			cmd = vmc96cli_get_k1_cmd_name( cs->id_controller, cs->command );
+			value = ( f == 0 ) ? cs->requests : ( f == 1 ) ? cs->errors : cs->retries;
+
+			fprintf( fp, "%s{controller=\"%s\",command=\"%s\"} %llu\n", counters[f][0], cntrl, cmd, value );
+		}
+	}
+
+	fprintf( fp, "# HELP vmc96_round_trip_seconds Successful K1 transactions latency (encode to parse).\n# TYPE vmc96_round_trip_seconds histogram\n" );
+
+	for( i = 0; i < VMC96_STATS_COMMANDS_COUNT; i++ )
+	{
+		cs = &stats->command[i];
+		cntrl = vmc96cli_get_k1_cntrl_name( cs->id_controller );
+		cmd = vmc96cli_get_k1_cmd_name( cs->id_controller, cs->command );
+
+		for( j = 0; j < sizeof(le) / sizeof(le[0]); j++ )
+			fprintf( fp, "vmc96_round_trip_seconds_bucket{controller=\"%s\",command=\"%s\",le=\"%g\"} %llu\n", cntrl, cmd, le[j],
+				vmc96_histogram_count_below( &cs->total, (unsigned long long)( le[j] * 1e9 ) ) );
+
+		fprintf( fp, "vmc96_round_trip_seconds_bucket{controller=\"%s\",command=\"%s\",le=\"+Inf\"} %llu\n", cntrl, cmd, cs->total.count );
+		fprintf( fp, "vmc96_round_trip_seconds_sum{controller=\"%s\",command=\"%s\"} %.9f\n", cntrl, cmd, cs->total.sum_ns / 1e9 );
+		fprintf( fp, "vmc96_round_trip_seconds_count{controller=\"%s\",command=\"%s\"} %llu\n", cntrl, cmd, cs->total.count );
+	}
+
+	fprintf( fp, "# HELP vmc96_transaction_errors_total K1 frames that ended with a VMC96_ERROR_* code.\n# TYPE vmc96_transaction_errors_total counter\n" );
+
+	for( i = 0; i < VMC96_STATS_ERRORS_COUNT; i++ )
+		fprintf( fp, "vmc96_transaction_errors_total{code=\"%d\",description=\"%s\"} %llu\n", stats->error[i].code,
+			vmc96_get_error_code_string( stats->error[i].code ), stats->error[i].count );
+
+	/* Vend frames (RUN and GIVE_PULSE) accepted by the board or lost to an error */
+	fprintf( fp, "# HELP vmc96_vends_total Vend frames by outcome.\n# TYPE vmc96_vends_total counter\n" );
+
+	for( i = 0; i < VMC96_STATS_COMMANDS_COUNT; i++ )
+	{
+		cs = &stats->command[i];
+
+		if( (cs->id_controller != 0x30) || ((cs->command != 0x13) && (cs->command != 0x14)) )
+			continue;
+
+		cmd = vmc96cli_get_k1_cmd_name( cs->id_controller, cs->command );
+
+		fprintf( fp, "vmc96_vends_total{command=\"%s\",result=\"accepted\"} %llu\n", cmd, cs->requests - cs->errors );
+		fprintf( fp, "vmc96_vends_total{command=\"%s\",result=\"failed\"} %llu\n", cmd, cs->errors );
+	}
+
+	fprintf( fp, "# HELP vmc96_bytes_total Bytes written to and read from the board.\n# TYPE vmc96_bytes_total counter\n" );
+	fprintf( fp, "vmc96_bytes_total{direction=\"tx\"} %llu\n", stats->bytes_tx );
+	fprintf( fp, "vmc96_bytes_total{direction=\"rx\"} %llu\n", stats->bytes_rx );
+
+	/* Utilization is rate(vmc96_bus_busy_seconds_total) */
+	fprintf( fp, "# HELP vmc96_bus_busy_seconds_total Time the bus was held by K1 transactions.\n# TYPE vmc96_bus_busy_seconds_total counter\n" );
+	fprintf( fp, "vmc96_bus_busy_seconds_total %.9f\n", stats->busy_ns / 1e9 );
+
+	fprintf( fp, "# HELP vmc96_coalesced_total Reads answered by an identical request already in flight.\n# TYPE vmc96_coalesced_total counter\n" );
+	fprintf( fp, "vmc96_coalesced_total %llu\n", stats->coalesced );
+
+	if( !__atomic_load_n( &g_vmc96cli_polled, __ATOMIC_ACQUIRE ) )
+		return;
+
+	fprintf( fp, "# HELP vmc96_motor_current_milliamperes Total motor current at the last poll.\n# TYPE vmc96_motor_current_milliamperes gauge\n" );
+	fprintf( fp, "vmc96_motor_current_milliamperes %u\n", __atomic_load_n( &g_vmc96cli_current_ma, __ATOMIC_RELAXED ) );
+	fprintf( fp, "# HELP vmc96_motors_active Running motors at the last poll.\n# TYPE vmc96_motors_active gauge\n" );
+	fprintf( fp, "vmc96_motors_active %u\n", __atomic_load_n( &g_vmc96cli_active_count, __ATOMIC_RELAXED ) );
+	fprintf( fp, "# HELP vmc96_last_poll_error VMC96_ERROR_* code of the last poll (0 if it succeeded).\n# TYPE vmc96_last_poll_error gauge\n" );
+	fprintf( fp, "vmc96_last_poll_error %d\n", __atomic_load_n( &g_vmc96cli_last_error, __ATOMIC_RELAXED ) );
+}
+
+
+static void * vmc96cli_metrics_thread( void * arg )
+{
+	vmc96cli_metrics_t * metrics = (vmc96cli_metrics_t*) arg;
+	char request[ VMC96CLI_METRICS_REQUEST_MAX_LEN ];
+	char tmp[ VMC96CLI_METRICS_PATH_MAX_LEN ];
+	char header[ 256 ];
+	char * body = NULL;
+	size_t body_len = 0;
+	int client = -1;
+	int elapsed_ms = VMC96CLI_METRICS_TEXTFILE_PERIOD_MS;
+	struct pollfd pfd;
+	struct timeval tv;
+	FILE * fp = NULL;
+
+	while( !__atomic_load_n( &metrics->stop, __ATOMIC_ACQUIRE ) )
+	{
+		/* Textfile collector: written aside and renamed, the collector never reads a partial file */
+		if( metrics->path && (elapsed_ms >= VMC96CLI_METRICS_TEXTFILE_PERIOD_MS) )
+		{
+			snprintf( tmp, sizeof(tmp), "%s.tmp", metrics->path );
+
+			fp = fopen( tmp, "w" );
+
+			if( fp )
+			{
+				vmc96cli_metrics_render( metrics, fp );
+
+				if( fclose( fp ) == 0 )
+					rename( tmp, metrics->path );
+			}
+
+			elapsed_ms = 0;
+		}
+
+		if( metrics->listen_fd < 0 )
+		{
+			usleep( VMC96CLI_METRICS_POLL_MS * 1000L );
+			elapsed_ms += VMC96CLI_METRICS_POLL_MS;
+			continue;
+		}
+
+		pfd.fd = metrics->listen_fd;
+		pfd.events = POLLIN;
+
+		if( poll( &pfd, 1, VMC96CLI_METRICS_POLL_MS ) <= 0 )
+		{
+			elapsed_ms += VMC96CLI_METRICS_POLL_MS;
+			continue;
+		}
+
+		client = accept( metrics->listen_fd, NULL, NULL );
+
+		if( client < 0 )
+			continue;
+
+		/* Any request gets the metrics; a stalled client can not hold the exporter */
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		setsockopt( client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv) );
+		setsockopt( client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv) );
+
+		if( recv( client, request, sizeof(request), 0 ) > 0 )
+		{
+			fp = open_memstream( &body, &body_len );
+
+			if( fp )
+			{
+				vmc96cli_metrics_render( metrics, fp );
+				fclose( fp );
+
+				snprintf( header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+					"Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long) body_len );
+
+				if( send( client, header, strlen( header ), MSG_NOSIGNAL ) > 0 )
+					send( client, body, body_len, MSG_NOSIGNAL );
+
+				free( body );
+				body = NULL;
+			}
+		}
+
+		close( client );
+	}
+
+	return NULL;
+}
+
+
+static int vmc96cli_metrics_start( VMC96_t * vmc96, vmc96cli_arguments_t * args, vmc96cli_metrics_t * metrics )
+{
+	int on = 1;
+	struct sockaddr_in addr;
+
+	memset( metrics, 0, sizeof(vmc96cli_metrics_t) );
+
+	metrics->vmc96 = vmc96;
+	metrics->path = args->metrics;
+	metrics->listen_fd = -1;
+
+	if( args->metrics_port < 0 || args->metrics_port > 65535 )
+		return VMC96CLI_ERROR_METRICS;
+
+	/* Large object: keep it off the stack */
+	metrics->stats = (VMC96_stats_t*) malloc( sizeof(VMC96_stats_t) );
+
+	if( !metrics->stats )
+		return VMC96CLI_ERROR_METRICS;
+
+	if( args->metrics_port )
+	{
+		metrics->listen_fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+		memset( &addr, 0, sizeof(addr) );
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons( (unsigned short) args->metrics_port );
+		addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+		if( (metrics->listen_fd < 0) ||
+			(setsockopt( metrics->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) ) < 0) ||
+			(bind( metrics->listen_fd, (struct sockaddr*) &addr, sizeof(addr) ) < 0) ||
+			(listen( metrics->listen_fd, 8 ) < 0) )
+		{
+			if( metrics->listen_fd >= 0 )
+				close( metrics->listen_fd );
+
+			free( metrics->stats );
+			return VMC96CLI_ERROR_METRICS;
+		}
+	}
+
+	if( pthread_create( &metrics->thread, NULL, vmc96cli_metrics_thread, metrics ) != 0 )
+	{
+		if( metrics->listen_fd >= 0 )
+			close( metrics->listen_fd );
+
+		free( metrics->stats );
+		return VMC96CLI_ERROR_METRICS;
+	}
+
+	return VMC96CLI_SUCCESS;
+}
+
+
+static void vmc96cli_metrics_stop( vmc96cli_metrics_t * metrics )
+{
+	__atomic_store_n( &metrics->stop, 1, __ATOMIC_RELEASE );
+	pthread_join( metrics->thread, NULL );
+
+	if( metrics->listen_fd >= 0 )
+		close( metrics->listen_fd );
+
+	/* Stale values would be scraped forever */
+	if( metrics->path )
+		unlink( metrics->path );
+
+	free( metrics->stats );
+}
+
+
 /* ********************************************************************* */
 /* *                                MAIN                               * */
 /* ********************************************************************* */
 int main( int argc, char ** argv )
 {
 	int ret = 0;
+	int fd = -1;
+	int exporting = 0;
 	vmc96cli_arguments_t args;
+	vmc96cli_metrics_t metrics;
 	VMC96_t * vmc96 = NULL;
 
 	ret = vmc96cli_proccess_arguments( argc, argv, &args );
@@ -677,7 +1524,51 @@ int main( int argc, char ** argv )
 		return EXIT_FAILURE;
 	}
 
-	ret = vmc96cli_execute( vmc96, &args );
+	if( args.capture )
+	{
+		fd = open( args.capture, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+		if( (fd < 0) || (vmc96_capture_start( vmc96, fd, "vmc96cli" ) != VMC96_SUCCESS) )
+		{
+			fprintf( stderr, "Error: %s\n", vmc96cli_get_error_code_string( VMC96CLI_ERROR_CAPTURE ) );
+			vmc96_finish( vmc96 );
+			return EXIT_FAILURE;
+		}
+	}
+
+	if( args.publish && (vmc96_status_page_publish( vmc96, args.publish ) != VMC96_SUCCESS) )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96cli_get_error_code_string( VMC96CLI_ERROR_PUBLISH ) );
+		vmc96_finish( vmc96 );
+		return EXIT_FAILURE;
+	}
+
+	exporting = ( args.metrics || args.metrics_port );
+
+	if( exporting && (vmc96cli_metrics_start( vmc96, &args, &metrics ) != VMC96CLI_SUCCESS) )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96cli_get_error_code_string( VMC96CLI_ERROR_METRICS ) );
+		vmc96_finish( vmc96 );
+		return EXIT_FAILURE;
+	}
+
+	if( args.watch_hz != 0.0 )
+		ret = vmc96cli_watch( vmc96, &args );
+	else if( args.script )
+		ret = vmc96cli_session( vmc96, &args );
+	else
+		ret = vmc96cli_execute( vmc96, &args );
+
+	if( exporting )
+		vmc96cli_metrics_stop( &metrics );
+
+	if( args.capture )
+	{
+		if( (vmc96_capture_stop( vmc96 ) != VMC96_SUCCESS) && (ret == VMC96CLI_SUCCESS) )
+			ret = VMC96CLI_ERROR_CAPTURE;
+
+		close( fd );
+	}
 
 	vmc96_finish( vmc96 );
 
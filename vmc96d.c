@@ -0,0 +1,1048 @@
+/*!
+	\file vmc96d.c
+	\brief VMC96 Board Broker Daemon (Fair Multi-Client Bus Arbitration)
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+
+	Protocol (SOCK_SEQPACKET Unix socket, one packet per message):
+
+		Client -> Daemon, first packet: client name (1 to 31 characters)
+		Client -> Daemon, next packets: [id_controller, command, data...]
+		Daemon -> Client: [int result (host byte order), response data...]
+
+	The hello is answered with a result and no data. A result is VMC96_SUCCESS,
+	a VMC96_ERROR_* code of the K1 transaction or a VMC96D_ERROR_* code.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "vmc96api.h"
+
+
+/* ********************************************************************* */
+/* *                              DEFINES                              * */
+/* ********************************************************************* */
+
+#define VMC96D_SUCCESS                                    (0)
+#define VMC96D_ERROR_INVALID_ARGS                         (-1)
+#define VMC96D_ERROR_SOCKET                               (-2)
+#define VMC96D_ERROR_OUT_OF_MEMORY                        (-3)
+#define VMC96D_ERROR_INVALID_REQUEST                      (-4)
+#define VMC96D_ERROR_TOO_MANY_CLIENTS                     (-5)
+#define VMC96D_ERROR_SOCKET_IN_USE                        (-6)
+
+#define VMC96D_DEFAULT_SOCKET_PATH                        "/tmp/vmc96d.sock"
+#define VMC96D_DEFAULT_QUANTUM_US                         (20000)  /* About two K1 round trips at 19200 baud */
+#define VMC96D_DEFAULT_WEIGHT                             (1)
+
+#define VMC96D_CONNECTIONS_MAX                            (64)
+#define VMC96D_CLIENTS_MAX                                (32)     /* Distinct client names */
+#define VMC96D_CLIENT_NAME_MAX_LEN                        (32)
+#define VMC96D_POLICIES_MAX                               (32)
+#define VMC96D_QUEUE_DEPTH                                (32)     /* Per client: a full queue stops reading its sockets */
+#define VMC96D_LISTEN_BACKLOG                             (16)
+
+#define VMC96D_PACKET_MAX_LEN                             (2 + VMC96_REQUEST_DATA_MAX_LEN)
+#define VMC96D_RESPONSE_MAX_LEN                           (sizeof(int) + VMC96_REQUEST_DATA_MAX_LEN)
+
+#define VMC96D_METRICS_PERIOD_MS                          (1000)
+#define VMC96D_METRICS_PATH_MAX_LEN                       (4096)
+#define VMC96D_WAIT_BUCKETS_COUNT                         (11)     /* Queue wait histogram, plus one overflow bucket */
+
+
+/* ********************************************************************* */
+/* *                        STRUCTS AND DATA TYPES                     * */
+/* ********************************************************************* */
+
+typedef struct vmc96d_bucket_s vmc96d_bucket_t;
+typedef struct vmc96d_policy_s vmc96d_policy_t;
+typedef struct vmc96d_request_s vmc96d_request_t;
+typedef struct vmc96d_client_s vmc96d_client_t;
+typedef struct vmc96d_connection_s vmc96d_connection_t;
+typedef struct vmc96d_s vmc96d_t;
+
+/* Token bucket: rate <= 0 means unlimited */
+struct vmc96d_bucket_s
+{
+	double rate;                        /* Requests per second */
+	double burst;
+	double tokens;
+	unsigned long long stamp_us;
+};
+
+struct vmc96d_policy_s
+{
+	char name[ VMC96D_CLIENT_NAME_MAX_LEN ];
+	int weight;
+	double rate;
+	double burst;
+};
+
+struct vmc96d_request_s
+{
+	int connection;
+	int cls;                            /* VMC96_COMMAND_CLASS_* */
+	int throttled;                      /* Waited for a rate limit token */
+	unsigned long long arrival_us;
+	unsigned int length;
+	unsigned char packet[ VMC96D_PACKET_MAX_LEN ];
+};
+
+struct vmc96d_client_s
+{
+	char name[ VMC96D_CLIENT_NAME_MAX_LEN ];
+	int weight;
+	int connections;
+
+	/* Deficit round robin: bus time still owed to this client in the current turn */
+	long long deficit_us;
+	int in_turn;
+
+	vmc96d_bucket_t bucket;
+	vmc96d_bucket_t class_bucket[ VMC96_COMMAND_CLASSES_COUNT ];
+
+	vmc96d_request_t queue[ VMC96D_QUEUE_DEPTH ];
+	int depth;
+
+	/* Metrics */
+	unsigned long long requests[ VMC96_COMMAND_CLASSES_COUNT ];
+	unsigned long long errors;
+	unsigned long long throttled;
+	unsigned long long bus_us;
+	unsigned long long wait_us;
+	unsigned long long wait_max_us;
+	unsigned long long wait_bucket[ VMC96D_WAIT_BUCKETS_COUNT + 1 ];
+	int depth_max;
+};
+
+struct vmc96d_connection_s
+{
+	int fd;
+	int client;                         /* -1 until the hello is received */
+};
+
+struct vmc96d_s
+{
+	VMC96_t * vmc96;
+	int listen_fd;
+	const char * socket_path;
+	const char * metrics_path;
+	long long quantum_us;
+
+	double class_rate[ VMC96_COMMAND_CLASSES_COUNT ];
+	double class_burst[ VMC96_COMMAND_CLASSES_COUNT ];
+
+	vmc96d_policy_t policy[ VMC96D_POLICIES_MAX ];
+	int policies_count;
+
+	vmc96d_client_t client[ VMC96D_CLIENTS_MAX ];
+	int clients_count;
+	int cursor;                         /* Deficit round robin position */
+
+	vmc96d_connection_t connection[ VMC96D_CONNECTIONS_MAX ];
+};
+
+
+/* ********************************************************************* */
+/* *                             PROTOTYPES                            * */
+/* ********************************************************************* */
+
+static const char * vmc96d_get_error_code_string( int cod );
+static const char * vmc96d_get_class_name( int cls );
+static void vmc96d_show_usage( void );
+static void vmc96d_signal_handler( int signum );
+static unsigned long long vmc96d_monotonic_us( void );
+static int vmc96d_parse_client( vmc96d_t * d, const char * arg );
+static int vmc96d_parse_class_rate( vmc96d_t * d, const char * arg );
+static void vmc96d_bucket_init( vmc96d_bucket_t * b, double rate, double burst, unsigned long long now_us );
+static int vmc96d_bucket_ready( vmc96d_bucket_t * b, unsigned long long now_us, unsigned long long * wake_us );
+static void vmc96d_bucket_take( vmc96d_bucket_t * b );
+static int vmc96d_client_bind( vmc96d_t * d, const char * name );
+static int vmc96d_client_eligible( vmc96d_client_t * c, unsigned long long now_us, unsigned long long * wake_us );
+static int vmc96d_schedule( vmc96d_t * d, unsigned long long now_us, int * slot, unsigned long long * wake_us );
+static void vmc96d_execute( vmc96d_t * d, int index, int slot );
+static void vmc96d_reply( int fd, int result, const unsigned char * data, unsigned int length );
+static int vmc96d_listen( vmc96d_t * d );
+static void vmc96d_accept( vmc96d_t * d );
+static void vmc96d_connection_close( vmc96d_t * d, int conn );
+static void vmc96d_connection_read( vmc96d_t * d, int conn );
+static void vmc96d_metrics_render( vmc96d_t * d, FILE * fp );
+static void vmc96d_metrics_write( vmc96d_t * d );
+static void vmc96d_report( vmc96d_t * d );
+
+
+/* ********************************************************************* */
+/* *                              GLOBALS                              * */
+/* ********************************************************************* */
+
+static volatile sig_atomic_t g_vmc96d_stop = 0;
+
+/* Queue wait histogram upper bounds */
+static const unsigned long long g_vmc96d_wait_le_us[ VMC96D_WAIT_BUCKETS_COUNT ] =
+	{ 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000 };
+
+
+/* ********************************************************************* */
+/* *                          IMPLEMENTATION                           * */
+/* ********************************************************************* */
+
+static const char * vmc96d_get_error_code_string( int cod )
+{
+	switch(cod)
+	{
+		case VMC96D_SUCCESS                       : return "Success."; break;
+		case VMC96D_ERROR_INVALID_ARGS            : return "Invalid arguments."; break;
+		case VMC96D_ERROR_SOCKET                  : return "Can not listen on the daemon socket."; break;
+		case VMC96D_ERROR_OUT_OF_MEMORY           : return "Out of memory."; break;
+		case VMC96D_ERROR_INVALID_REQUEST         : return "Invalid request packet."; break;
+		case VMC96D_ERROR_TOO_MANY_CLIENTS        : return "Too many clients."; break;
+		case VMC96D_ERROR_SOCKET_IN_USE           : return "Another daemon is listening on the socket."; break;
+		default                                   : return "Unknown error."; break;
+	}
+}
+
+
+static const char * vmc96d_get_class_name( int cls )
+{
+	switch( cls )
+	{
+		case VMC96_COMMAND_CLASS_READ             : return "read"; break;
+		case VMC96_COMMAND_CLASS_NORMAL           : return "normal"; break;
+		case VMC96_COMMAND_CLASS_SAFETY           : return "safety"; break;
+		default                                   : return "unknown"; break;
+	}
+}
+
+
+static void vmc96d_show_usage( void )
+{
+	printf( "SHARE A BOARD BETWEEN CLIENTS (WEIGHTED DEFICIT ROUND ROBIN):\n\n" );
+	printf( "	vmc96d --socket=/tmp/vmc96d.sock --client=vend:4 --client=telemetry:1:20\n\n" );
+	printf( "CLIENT POLICY (WEIGHT, REQUESTS PER SECOND AND BURST, UNLISTED CLIENTS HAVE WEIGHT 1):\n\n" );
+	printf( "	--client=<name>:<weight>[:<rate>[:<burst>]]\n\n" );
+	printf( "COMMAND CLASS RATE LIMIT, PER CLIENT (SAFETY COMMANDS ARE NEVER LIMITED):\n\n" );
+	printf( "	--class-rate=[read|normal]:<rate>[:<burst>]\n\n" );
+	printf( "BUS TIME GRANTED PER TURN AND WEIGHT UNIT (DEFAULT 20000us):\n\n" );
+	printf( "	--quantum=<us>\n\n" );
+	printf( "PER CLIENT METRICS (PROMETHEUS TEXTFILE, REWRITTEN EVERY SECOND):\n\n" );
+	printf( "	--metrics=/var/lib/node_exporter/textfile/vmc96d.prom\n\n" );
+}
+
+
+static void vmc96d_signal_handler( int signum )
+{
+	(void) signum;
+
+	g_vmc96d_stop = 1;
+}
+
+
+static unsigned long long vmc96d_monotonic_us( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ((unsigned long long) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+
+static int vmc96d_parse_client( vmc96d_t * d, const char * arg )
+{
+	vmc96d_policy_t * p = NULL;
+	int n = 0;
+
+	if( d->policies_count >= VMC96D_POLICIES_MAX )
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	p = &d->policy[ d->policies_count ];
+
+	memset( p, 0, sizeof(vmc96d_policy_t) );
+
+	n = sscanf( arg, "%31[^:]:%d:%lf:%lf", p->name, &p->weight, &p->rate, &p->burst );
+
+	if( (n < 2) || (p->weight < 1) || (p->rate < 0.0) || (p->burst < 0.0) )
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	d->policies_count++;
+
+	return VMC96D_SUCCESS;
+}
+
+
+static int vmc96d_parse_class_rate( vmc96d_t * d, const char * arg )
+{
+	char name[ 16 ];
+	double rate = 0.0;
+	double burst = 0.0;
+	int cls = 0;
+
+	if( sscanf( arg, "%15[^:]:%lf:%lf", name, &rate, &burst ) < 2 )
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	if( !strcmp( name, "read" ) )
+		cls = VMC96_COMMAND_CLASS_READ;
+	else if( !strcmp( name, "normal" ) )
+		cls = VMC96_COMMAND_CLASS_NORMAL;
+	else
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	if( (rate < 0.0) || (burst < 0.0) )
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	d->class_rate[ cls ] = rate;
+	d->class_burst[ cls ] = burst;
+
+	return VMC96D_SUCCESS;
+}
+
+
+static void vmc96d_bucket_init( vmc96d_bucket_t * b, double rate, double burst, unsigned long long now_us )
+{
+	b->rate = rate;
+	b->burst = ( burst >= 1.0 ) ? burst : 1.0;
+	b->tokens = b->burst;
+	b->stamp_us = now_us;
+}
+
+
+static int vmc96d_bucket_ready( vmc96d_bucket_t * b, unsigned long long now_us, unsigned long long * wake_us )
+{
+	unsigned long long ready_us = 0;
+
+	if( b->rate <= 0.0 )
+		return 1;
+
+	b->tokens += (now_us - b->stamp_us) * b->rate / 1e6;
+	b->stamp_us = now_us;
+
+	if( b->tokens > b->burst )
+		b->tokens = b->burst;
+
+	if( b->tokens >= 1.0 )
+		return 1;
+
+	ready_us = now_us + (unsigned long long)( (1.0 - b->tokens) * 1e6 / b->rate ) + 1;
+
+	if( !*wake_us || (ready_us < *wake_us) )
+		*wake_us = ready_us;
+
+	return 0;
+}
+
+
+static void vmc96d_bucket_take( vmc96d_bucket_t * b )
+{
+	if( b->rate > 0.0 )
+		b->tokens -= 1.0;
+}
+
+
+static int vmc96d_client_bind( vmc96d_t * d, const char * name )
+{
+	vmc96d_client_t * c = NULL;
+	unsigned long long now_us = vmc96d_monotonic_us();
+	int i = 0;
+
+	/* A client keeps its rate limit state and metrics across reconnections */
+	for( i = 0; i < d->clients_count; i++ )
+		if( !strcmp( d->client[i].name, name ) )
+			return i;
+
+	if( d->clients_count >= VMC96D_CLIENTS_MAX )
+		return VMC96D_ERROR_TOO_MANY_CLIENTS;
+
+	c = &d->client[ d->clients_count ];
+
+	memset( c, 0, sizeof(vmc96d_client_t) );
+
+	snprintf( c->name, sizeof(c->name), "%s", name );
+
+	c->weight = VMC96D_DEFAULT_WEIGHT;
+
+	vmc96d_bucket_init( &c->bucket, 0.0, 0.0, now_us );
+
+	for( i = 0; i < d->policies_count; i++ )
+	{
+		if( strcmp( d->policy[i].name, name ) )
+			continue;
+
+		c->weight = d->policy[i].weight;
+		vmc96d_bucket_init( &c->bucket, d->policy[i].rate, d->policy[i].burst, now_us );
+	}
+
+	for( i = 0; i < VMC96_COMMAND_CLASSES_COUNT; i++ )
+		vmc96d_bucket_init( &c->class_bucket[i], d->class_rate[i], d->class_burst[i], now_us );
+
+	return d->clients_count++;
+}
+
+
+static int vmc96d_client_eligible( vmc96d_client_t * c, unsigned long long now_us, unsigned long long * wake_us )
+{
+	vmc96d_request_t * head = &c->queue[0];
+	int ready = 0;
+
+	if( !c->depth )
+		return 0;
+
+	/* Both buckets are checked so that the earliest wake up accounts for either */
+	ready = vmc96d_bucket_ready( &c->bucket, now_us, wake_us );
+	ready &= vmc96d_bucket_ready( &c->class_bucket[ head->cls ], now_us, wake_us );
+
+	if( !ready )
+		head->throttled = 1;
+
+	return ready;
+}
+
+
+static int vmc96d_schedule( vmc96d_t * d, unsigned long long now_us, int * slot, unsigned long long * wake_us )
+{
+	vmc96d_client_t * c = NULL;
+	unsigned long long oldest_us = 0;
+	int index = -1;
+	int eligible = 0;
+	int visited = 0;
+	int i = 0;
+	int j = 0;
+
+	*wake_us = 0;
+
+	if( !d->clients_count )
+		return -1;
+
+	/* Safety commands skip every queue and every limit, oldest first */
+	for( i = 0; i < d->clients_count; i++ )
+	{
+		c = &d->client[i];
+
+		for( j = 0; j < c->depth; j++ )
+		{
+			if( c->queue[j].cls != VMC96_COMMAND_CLASS_SAFETY )
+				continue;
+
+			if( (index < 0) || (c->queue[j].arrival_us < oldest_us) )
+			{
+				index = i;
+				*slot = j;
+				oldest_us = c->queue[j].arrival_us;
+			}
+		}
+	}
+
+	if( index >= 0 )
+		return index;
+
+	/*
+		Deficit round robin over bus time: a client is granted quantum x weight
+		microseconds per turn and keeps the bus while its deficit is positive. The
+		measured transaction time is charged afterwards, so a slow command (or a
+		timeout) is paid back over the next turns.
+	*/
+	*slot = 0;
+
+	for( ;; )
+	{
+		c = &d->client[ d->cursor ];
+
+		if( vmc96d_client_eligible( c, now_us, wake_us ) )
+		{
+			eligible++;
+
+			if( !c->in_turn )
+			{
+				c->deficit_us += d->quantum_us * c->weight;
+				c->in_turn = 1;
+			}
+
+			if( c->deficit_us > 0 )
+				return d->cursor;
+		}
+		else if( !c->depth || (c->deficit_us > 0) )
+		{
+			/* Idle or throttled clients do not bank bus time */
+			c->deficit_us = 0;
+		}
+
+		c->in_turn = 0;
+		d->cursor = (d->cursor + 1) % d->clients_count;
+
+		if( ++visited == d->clients_count )
+		{
+			if( !eligible )
+				return -1;
+
+			visited = 0;
+			eligible = 0;
+		}
+	}
+}
+
+
+static void vmc96d_execute( vmc96d_t * d, int index, int slot )
+{
+	vmc96d_client_t * c = &d->client[ index ];
+	vmc96d_request_t request;
+	unsigned char response[ VMC96_REQUEST_DATA_MAX_LEN ];
+	unsigned int response_length = 0;
+	unsigned long long start_us = 0;
+	unsigned long long wait_us = 0;
+	unsigned long long bus_us = 0;
+	int ret = 0;
+	int i = 0;
+
+	memcpy( &request, &c->queue[ slot ], sizeof(request) );
+
+	c->depth--;
+	memmove( &c->queue[ slot ], &c->queue[ slot + 1 ], (c->depth - slot) * sizeof(vmc96d_request_t) );
+
+	if( request.cls != VMC96_COMMAND_CLASS_SAFETY )
+	{
+		vmc96d_bucket_take( &c->bucket );
+		vmc96d_bucket_take( &c->class_bucket[ request.cls ] );
+	}
+
+	start_us = vmc96d_monotonic_us();
+	wait_us = start_us - request.arrival_us;
+
+	ret = vmc96_k1_request( d->vmc96, request.packet[0], request.packet[1], request.packet + 2, request.length - 2, response, &response_length );
+
+	bus_us = vmc96d_monotonic_us() - start_us;
+
+	c->deficit_us -= bus_us;
+
+	c->requests[ request.cls ]++;
+	c->errors += ( ret != VMC96_SUCCESS ) ? 1 : 0;
+	c->throttled += request.throttled;
+	c->bus_us += bus_us;
+	c->wait_us += wait_us;
+
+	if( wait_us > c->wait_max_us )
+		c->wait_max_us = wait_us;
+
+	for( i = 0; (i < VMC96D_WAIT_BUCKETS_COUNT) && (wait_us > g_vmc96d_wait_le_us[i]); i++ );
+
+	c->wait_bucket[i]++;
+
+	vmc96d_reply( d->connection[ request.connection ].fd, ret, response, ( ret == VMC96_SUCCESS ) ? response_length : 0 );
+}
+
+
+static void vmc96d_reply( int fd, int result, const unsigned char * data, unsigned int length )
+{
+	unsigned char packet[ VMC96D_RESPONSE_MAX_LEN ];
+
+	memcpy( packet, &result, sizeof(int) );
+
+	if( length )
+		memcpy( packet + sizeof(int), data, length );
+
+	/* A client that stopped reading loses its reply, it never blocks the bus */
+	send( fd, packet, sizeof(int) + length, MSG_NOSIGNAL | MSG_DONTWAIT );
+}
+
+
+static int vmc96d_listen( vmc96d_t * d )
+{
+	struct sockaddr_un addr;
+	int probe = -1;
+	int ret = 0;
+
+	if( strlen( d->socket_path ) >= sizeof(addr.sun_path) )
+		return VMC96D_ERROR_INVALID_ARGS;
+
+	memset( &addr, 0, sizeof(addr) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, d->socket_path );
+
+	/* Only a socket nobody accepts on is stale: never take the path from a live daemon */
+	probe = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+	if( probe < 0 )
+		return VMC96D_ERROR_SOCKET;
+
+	ret = connect( probe, (struct sockaddr*) &addr, sizeof(addr) );
+
+	if( ret == 0 )
+	{
+		close( probe );
+		return VMC96D_ERROR_SOCKET_IN_USE;
+	}
+
+	if( errno == ECONNREFUSED )
+		unlink( d->socket_path );
+
+	close( probe );
+
+	d->listen_fd = socket( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0 );
+
+	if( d->listen_fd < 0 )
+		return VMC96D_ERROR_SOCKET;
+
+	if( (bind( d->listen_fd, (struct sockaddr*) &addr, sizeof(addr) ) < 0) || (listen( d->listen_fd, VMC96D_LISTEN_BACKLOG ) < 0) )
+	{
+		close( d->listen_fd );
+		d->listen_fd = -1;
+		return VMC96D_ERROR_SOCKET;
+	}
+
+	return VMC96D_SUCCESS;
+}
+
+
+static void vmc96d_accept( vmc96d_t * d )
+{
+	int fd = -1;
+	int i = 0;
+
+	fd = accept( d->listen_fd, NULL, NULL );
+
+	if( fd < 0 )
+		return;
+
+	for( i = 0; i < VMC96D_CONNECTIONS_MAX; i++ )
+	{
+		if( d->connection[i].fd >= 0 )
+			continue;
+
+		d->connection[i].fd = fd;
+		d->connection[i].client = -1;
+		return;
+	}
+
+	vmc96d_reply( fd, VMC96D_ERROR_TOO_MANY_CLIENTS, NULL, 0 );
+	close( fd );
+}
+
+
+static void vmc96d_connection_close( vmc96d_t * d, int conn )
+{
+	vmc96d_connection_t * cn = &d->connection[ conn ];
+	vmc96d_client_t * c = NULL;
+	int i = 0;
+	int j = 0;
+
+	/* Requests nobody will read the reply of are dropped, not sent */
+	if( cn->client >= 0 )
+	{
+		c = &d->client[ cn->client ];
+
+		for( i = 0, j = 0; i < c->depth; i++ )
+			if( c->queue[i].connection != conn )
+				memmove( &c->queue[ j++ ], &c->queue[i], sizeof(vmc96d_request_t) );
+
+		c->depth = j;
+		c->connections--;
+	}
+
+	close( cn->fd );
+
+	cn->fd = -1;
+	cn->client = -1;
+}
+
+
+static void vmc96d_connection_read( vmc96d_t * d, int conn )
+{
+	vmc96d_connection_t * cn = &d->connection[ conn ];
+	vmc96d_client_t * c = NULL;
+	vmc96d_request_t * r = NULL;
+	unsigned char packet[ VMC96D_PACKET_MAX_LEN ];
+	char name[ VMC96D_CLIENT_NAME_MAX_LEN ];
+	ssize_t n = 0;
+	int ret = 0;
+
+	for( ;; )
+	{
+		c = ( cn->client >= 0 ) ? &d->client[ cn->client ] : NULL;
+
+		/* Back pressure: the rest stays in the socket until the queue drains */
+		if( c && (c->depth >= VMC96D_QUEUE_DEPTH) )
+			return;
+
+		n = recv( cn->fd, packet, sizeof(packet), MSG_DONTWAIT | MSG_TRUNC );
+
+		if( (n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) )
+			return;
+
+		if( n <= 0 )
+		{
+			vmc96d_connection_close( d, conn );
+			return;
+		}
+
+		if( !c )
+		{
+			if( n >= VMC96D_CLIENT_NAME_MAX_LEN )
+			{
+				vmc96d_reply( cn->fd, VMC96D_ERROR_INVALID_REQUEST, NULL, 0 );
+				vmc96d_connection_close( d, conn );
+				return;
+			}
+
+			memcpy( name, packet, n );
+			name[n] = '\0';
+
+			ret = ( name[0] && (strlen( name ) == (size_t) n) ) ? vmc96d_client_bind( d, name ) : VMC96D_ERROR_INVALID_REQUEST;
+
+			if( ret < 0 )
+			{
+				vmc96d_reply( cn->fd, ret, NULL, 0 );
+				vmc96d_connection_close( d, conn );
+				return;
+			}
+
+			cn->client = ret;
+			d->client[ ret ].connections++;
+
+			vmc96d_reply( cn->fd, VMC96D_SUCCESS, NULL, 0 );
+			continue;
+		}
+
+		if( (n < 2) || (n > (ssize_t) sizeof(packet)) )
+		{
+			vmc96d_reply( cn->fd, VMC96D_ERROR_INVALID_REQUEST, NULL, 0 );
+			continue;
+		}
+
+		r = &c->queue[ c->depth++ ];
+
+		r->connection = conn;
+		r->cls = vmc96_k1_command_class( packet[0], packet[1] );
+		r->throttled = 0;
+		r->arrival_us = vmc96d_monotonic_us();
+		r->length = n;
+		memcpy( r->packet, packet, n );
+
+		if( c->depth > c->depth_max )
+			c->depth_max = c->depth;
+	}
+}
+
+
+static void vmc96d_metrics_render( vmc96d_t * d, FILE * fp )
+{
+	vmc96d_client_t * c = NULL;
+	unsigned long long count = 0;
+	int i = 0;
+	int j = 0;
+
+	fprintf( fp, "# HELP vmc96d_client_weight Deficit round robin weight.\n# TYPE vmc96d_client_weight gauge\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_weight{client=\"%s\"} %d\n", d->client[i].name, d->client[i].weight );
+
+	fprintf( fp, "# HELP vmc96d_client_connections Open connections.\n# TYPE vmc96d_client_connections gauge\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_connections{client=\"%s\"} %d\n", d->client[i].name, d->client[i].connections );
+
+	fprintf( fp, "# HELP vmc96d_client_requests_total Requests sent to the board.\n# TYPE vmc96d_client_requests_total counter\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		for( j = 0; j < VMC96_COMMAND_CLASSES_COUNT; j++ )
+			fprintf( fp, "vmc96d_client_requests_total{client=\"%s\",class=\"%s\"} %llu\n", d->client[i].name, vmc96d_get_class_name( j ), d->client[i].requests[j] );
+
+	fprintf( fp, "# HELP vmc96d_client_errors_total Requests that ended with a VMC96_ERROR_* code.\n# TYPE vmc96d_client_errors_total counter\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_errors_total{client=\"%s\"} %llu\n", d->client[i].name, d->client[i].errors );
+
+	fprintf( fp, "# HELP vmc96d_client_throttled_total Requests delayed by a rate limit.\n# TYPE vmc96d_client_throttled_total counter\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_throttled_total{client=\"%s\"} %llu\n", d->client[i].name, d->client[i].throttled );
+
+	fprintf( fp, "# HELP vmc96d_client_bus_seconds_total Bus time used.\n# TYPE vmc96d_client_bus_seconds_total counter\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_bus_seconds_total{client=\"%s\"} %.6f\n", d->client[i].name, d->client[i].bus_us / 1e6 );
+
+	fprintf( fp, "# HELP vmc96d_client_queue_depth Requests waiting for the bus.\n# TYPE vmc96d_client_queue_depth gauge\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_queue_depth{client=\"%s\"} %d\n", d->client[i].name, d->client[i].depth );
+
+	fprintf( fp, "# HELP vmc96d_client_queue_depth_max Highest queue depth seen.\n# TYPE vmc96d_client_queue_depth_max gauge\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+		fprintf( fp, "vmc96d_client_queue_depth_max{client=\"%s\"} %d\n", d->client[i].name, d->client[i].depth_max );
+
+	fprintf( fp, "# HELP vmc96d_client_wait_seconds Time from arrival to the start of the transaction.\n# TYPE vmc96d_client_wait_seconds histogram\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+	{
+		c = &d->client[i];
+
+		for( j = 0, count = 0; j < VMC96D_WAIT_BUCKETS_COUNT; j++ )
+		{
+			count += c->wait_bucket[j];
+			fprintf( fp, "vmc96d_client_wait_seconds_bucket{client=\"%s\",le=\"%g\"} %llu\n", c->name, g_vmc96d_wait_le_us[j] / 1e6, count );
+		}
+
+		count += c->wait_bucket[ VMC96D_WAIT_BUCKETS_COUNT ];
+
+		fprintf( fp, "vmc96d_client_wait_seconds_bucket{client=\"%s\",le=\"+Inf\"} %llu\n", c->name, count );
+		fprintf( fp, "vmc96d_client_wait_seconds_sum{client=\"%s\"} %.6f\n", c->name, c->wait_us / 1e6 );
+		fprintf( fp, "vmc96d_client_wait_seconds_count{client=\"%s\"} %llu\n", c->name, count );
+	}
+}
+
+
+static void vmc96d_metrics_write( vmc96d_t * d )
+{
+	char tmp[ VMC96D_METRICS_PATH_MAX_LEN ];
+	FILE * fp = NULL;
+
+	/* Written aside and renamed, the collector never reads a partial file */
+	snprintf( tmp, sizeof(tmp), "%s.tmp", d->metrics_path );
+
+	fp = fopen( tmp, "w" );
+
+	if( !fp )
+		return;
+
+	vmc96d_metrics_render( d, fp );
+
+	if( fclose( fp ) == 0 )
+		rename( tmp, d->metrics_path );
+}
+
+
+static void vmc96d_report( vmc96d_t * d )
+{
+	vmc96d_client_t * c = NULL;
+	unsigned long long bus_us = 0;
+	unsigned long long requests = 0;
+	int i = 0;
+
+	for( i = 0; i < d->clients_count; i++ )
+		bus_us += d->client[i].bus_us;
+
+	printf( "\nCLIENT                           WEIGHT  REQUESTS  ERRORS  THROTTLED  BUS SHARE  WAIT AVG(ms)  WAIT MAX(ms)  DEPTH MAX\n" );
+
+	for( i = 0; i < d->clients_count; i++ )
+	{
+		c = &d->client[i];
+		requests = c->requests[0] + c->requests[1] + c->requests[2];
+
+		printf( "%-32s %6d  %8llu  %6llu  %9llu  %8.1f%%  %12.2f  %12.2f  %9d\n", c->name, c->weight, requests, c->errors, c->throttled,
+			bus_us ? c->bus_us * 100.0 / bus_us : 0.0, requests ? c->wait_us / 1e3 / requests : 0.0, c->wait_max_us / 1e3, c->depth_max );
+	}
+}
+
+
+/* ********************************************************************* */
+/* *                                MAIN                               * */
+/* ********************************************************************* */
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	int index = 0;
+	int slot = 0;
+	int timeout_ms = VMC96D_METRICS_PERIOD_MS;
+	int n = 0;
+	int i = 0;
+	int map[ VMC96D_CONNECTIONS_MAX ];
+	unsigned long long now_us = 0;
+	unsigned long long wake_us = 0;
+	unsigned long long metrics_us = 0;
+	struct pollfd pfd[ VMC96D_CONNECTIONS_MAX + 1 ];
+	vmc96d_t * d = NULL;
+
+	static struct option options[] =
+	{
+		{ "socket",      required_argument, 0,  'a' },
+		{ "client",      required_argument, 0,  'b' },
+		{ "class-rate",  required_argument, 0,  'c' },
+		{ "quantum",     required_argument, 0,  'd' },
+		{ "metrics",     required_argument, 0,  'e' },
+		{ "help",        no_argument,       0,  'f' },
+		{ NULL,          no_argument,       0,   0  }
+	};
+
+	d = (vmc96d_t*) calloc( 1, sizeof(vmc96d_t) );
+
+	if( !d )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96d_get_error_code_string( VMC96D_ERROR_OUT_OF_MEMORY ) );
+		return EXIT_FAILURE;
+	}
+
+	d->listen_fd = -1;
+	d->socket_path = VMC96D_DEFAULT_SOCKET_PATH;
+	d->quantum_us = VMC96D_DEFAULT_QUANTUM_US;
+
+	for( i = 0; i < VMC96D_CONNECTIONS_MAX; i++ )
+	{
+		d->connection[i].fd = -1;
+		d->connection[i].client = -1;
+	}
+
+	while( (ret = getopt_long( argc, argv, "a:b:c:d:e:f", options, &index )) != -1 )
+	{
+		switch( ret )
+		{
+			case 'a' : d->socket_path = optarg; ret = VMC96D_SUCCESS; break;
+			case 'b' : ret = vmc96d_parse_client( d, optarg ); break;
+			case 'c' : ret = vmc96d_parse_class_rate( d, optarg ); break;
+			case 'd' : d->quantum_us = atoll( optarg ); ret = ( d->quantum_us > 0 ) ? VMC96D_SUCCESS : VMC96D_ERROR_INVALID_ARGS; break;
+			case 'e' : d->metrics_path = optarg; ret = VMC96D_SUCCESS; break;
+
+			case 'f' :
+			default :
+				vmc96d_show_usage();
+				free( d );
+				return EXIT_FAILURE;
+		}
+
+		if( ret != VMC96D_SUCCESS )
+		{
+			fprintf( stderr, "Error: %s\n", vmc96d_get_error_code_string( ret ) );
+			free( d );
+			return EXIT_FAILURE;
+		}
+	}
+
+	ret = vmc96_initialize( &d->vmc96 );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+		free( d );
+		return EXIT_FAILURE;
+	}
+
+	ret = vmc96d_listen( d );
+
+	if( ret != VMC96D_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96d_get_error_code_string(ret) );
+		vmc96_finish( d->vmc96 );
+		free( d );
+		return EXIT_FAILURE;
+	}
+
+	signal( SIGINT, vmc96d_signal_handler );
+	signal( SIGTERM, vmc96d_signal_handler );
+
+	printf( "Listening on %s\n", d->socket_path );
+	fflush( stdout );
+
+	metrics_us = vmc96d_monotonic_us();
+
+	while( !g_vmc96d_stop )
+	{
+		pfd[0].fd = d->listen_fd;
+		pfd[0].events = POLLIN;
+
+		for( i = 0, n = 1; i < VMC96D_CONNECTIONS_MAX; i++ )
+		{
+			if( d->connection[i].fd < 0 )
+				continue;
+
+			/* A client with a full queue is not read until it drains */
+			if( (d->connection[i].client >= 0) && (d->client[ d->connection[i].client ].depth >= VMC96D_QUEUE_DEPTH) )
+				continue;
+
+			pfd[n].fd = d->connection[i].fd;
+			pfd[n].events = POLLIN;
+			map[n - 1] = i;
+			n++;
+		}
+
+		if( poll( pfd, n, timeout_ms ) < 0 )
+			continue;
+
+		if( pfd[0].revents & POLLIN )
+			vmc96d_accept( d );
+
+		for( i = 1; i < n; i++ )
+			if( pfd[i].revents )
+				vmc96d_connection_read( d, map[i - 1] );
+
+		/* One transaction per loop, so that new arrivals are queued before the next pick */
+		now_us = vmc96d_monotonic_us();
+		index = vmc96d_schedule( d, now_us, &slot, &wake_us );
+
+		if( index >= 0 )
+		{
+			vmc96d_execute( d, index, slot );
+			timeout_ms = 0;
+		}
+		else
+		{
+			timeout_ms = VMC96D_METRICS_PERIOD_MS;
+
+			/* Only rate-limited requests are pending: sleep until the first token */
+			if( wake_us )
+				timeout_ms = ( wake_us > now_us ) ? (int)( (wake_us - now_us + 999) / 1000 ) : 0;
+		}
+
+		now_us = vmc96d_monotonic_us();
+
+		if( d->metrics_path && (now_us - metrics_us >= VMC96D_METRICS_PERIOD_MS * 1000ULL) )
+		{
+			vmc96d_metrics_write( d );
+			metrics_us = now_us;
+		}
+
+		if( d->metrics_path && (timeout_ms > VMC96D_METRICS_PERIOD_MS) )
+			timeout_ms = VMC96D_METRICS_PERIOD_MS;
+	}
+
+	signal( SIGINT, SIG_DFL );
+	signal( SIGTERM, SIG_DFL );
+
+	vmc96d_report( d );
+
+	for( i = 0; i < VMC96D_CONNECTIONS_MAX; i++ )
+		if( d->connection[i].fd >= 0 )
+			vmc96d_connection_close( d, i );
+
+	close( d->listen_fd );
+	unlink( d->socket_path );
+
+	if( d->metrics_path )
+		unlink( d->metrics_path );
+
+	vmc96_finish( d->vmc96 );
+
+	free( d );
+
+	return EXIT_SUCCESS;
+}
+
+/* eof */
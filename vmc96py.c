@@ -0,0 +1,797 @@
+/*!
+	\file vmc96py.c
+	\brief VMC96 Board Python Extension Module (_vmc96)
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Jan.2019
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+/*
+	Drop-in replacement for the VMC96 class of VMC96.py backed by vmc96api.c:
+
+		import _vmc96
+		vmc = _vmc96.VMC96( invertedArray=False )
+		vmc.motor_run( 0x11 )
+
+	Methods keep the names, arguments, return values and exceptions of
+	VMC96.py. The GIL is released while a K1 transaction is on the wire, and
+	the library context lock serializes threads sharing one object. on_log is
+	only formatted when a callback is set.
+
+	Telemetry is also available as packed arrays (_vmc96.Buffer, buffer
+	protocol with format and shape), fetched in bulk with the GIL released
+	for the whole run:
+
+		opto = numpy.asarray( vmc.opto_sensor_read_block( 1000, 40 ) )  # uint8 (1000, 32)
+		current = numpy.asarray( vmc.motor_current_read( 1000, 10 ) )    # uint32 (1000,)
+		scan = numpy.asarray( vmc.motor_scan_bitmap() )                  # uint8 (8, 12)
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vmc96api.h"
+
+
+/* ********************************************************************* */
+/* *                              DEFINES                              * */
+/* ********************************************************************* */
+
+#define VMC96PY_MESSAGE_HEADER                            (0x35)
+#define VMC96PY_MESSAGE_MIN_LENGTH                        (5)
+
+#define VMC96PY_CONTROLLER_RELAY                          (0x26)
+#define VMC96PY_CONTROLLER_MOTOR                          (0x30)
+
+#define VMC96PY_COMMAND_RELAY_CONTROL                     (0x11)
+#define VMC96PY_COMMAND_RELAY_RESET                       (0x05)
+#define VMC96PY_COMMAND_MOTOR_RUN                         (0x13)
+#define VMC96PY_COMMAND_MOTOR_STOP_ALL                    (0x12)
+#define VMC96PY_COMMAND_MOTOR_RESET                       (0x05)
+#define VMC96PY_COMMAND_MOTOR_OPTO_SENSOR_STATUS          (0x15)
+#define VMC96PY_COMMAND_MOTOR_SCAN_ARRAY                  (0x11)
+
+#define VMC96PY_OPTO_SENSOR_RESPONSE_LENGTH               (5)
+#define VMC96PY_RESPONSE_POSITIVE_ACK                     (0x00)
+
+#define VMC96PY_INVERT_MOTOR_ID( _mid )                   ((((_mid) & 0x0F) << 4) | (((_mid) & 0xF0) >> 4))
+
+
+/* ********************************************************************* */
+/* *                        STRUCTS AND DATA TYPES                     * */
+/* ********************************************************************* */
+
+typedef struct vmc96py_object_s vmc96py_object_t;
+typedef struct vmc96py_buffer_s vmc96py_buffer_t;
+
+struct vmc96py_object_s
+{
+	PyObject_HEAD
+	VMC96_t * vmc96;
+	int inverted;
+	PyObject * on_log;
+};
+
+/* Read-only packed array exported through the buffer protocol */
+struct vmc96py_buffer_s
+{
+	PyObject_HEAD
+	void * data;
+	Py_ssize_t itemsize;
+	int ndim;
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+	char format[2];
+};
+
+
+/* ********************************************************************* */
+/* *                             PROTOTYPES                            * */
+/* ********************************************************************* */
+
+static void vmc96py_log_frame( vmc96py_object_t * self, const char * prefix, unsigned char cntrl, int cmd, const unsigned char * data, unsigned int data_length );
+static int vmc96py_request( vmc96py_object_t * self, unsigned char cntrl, unsigned char cmd, const unsigned char * args, unsigned int args_length, unsigned char * data, unsigned int * data_length );
+static PyObject * vmc96py_execute_command( vmc96py_object_t * self, unsigned char cntrl, unsigned char cmd, const unsigned char * args, unsigned int args_length );
+static vmc96py_buffer_t * vmc96py_buffer_new( char format, Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t cols );
+static PyObject * vmc96py_bulk_error( vmc96py_buffer_t * buf, int ret );
+
+
+/* ********************************************************************* */
+/* *                          IMPLEMENTATION                           * */
+/* ********************************************************************* */
+
+static void vmc96py_log_frame( vmc96py_object_t * self, const char * prefix, unsigned char cntrl, int cmd, const unsigned char * data, unsigned int data_length )
+{
+	char msg[ 64 + 8 * VMC96_REQUEST_DATA_MAX_LEN ];
+	unsigned char frame[ VMC96_REQUEST_DATA_MAX_LEN + VMC96PY_MESSAGE_MIN_LENGTH ];
+	unsigned int length = 0;
+	unsigned int first = 0;
+	unsigned int i = 0;
+	int n = 0;
+	PyObject * ret = NULL;
+
+	/* Rebuild the frame: responses have no command byte */
+	frame[ length++ ] = VMC96PY_MESSAGE_HEADER;
+	frame[ length++ ] = cntrl;
+	frame[ length++ ] = 0;
+
+	if( cmd >= 0 )
+		frame[ length++ ] = (unsigned char) cmd;
+
+	first = length;
+
+	if( data_length > 0 )
+		memcpy( frame + length, data, data_length );
+
+	length += data_length;
+
+	frame[2] = length + 1;
+	frame[ length ] = 0;
+
+	for( i = 0; i < length; i++ )
+		frame[ length ] ^= frame[i];
+
+	/* Same layout as VMC96._request_to_string() / VMC96._response_to_string() */
+	if( cmd >= 0 )
+		n = snprintf( msg, sizeof(msg), "%s[ hdr='0x%02X', cntrl='0x%02X', len='0x%02X', cmd='0x%02X', data=[", prefix, frame[0], frame[1], frame[2], frame[3] );
+	else
+		n = snprintf( msg, sizeof(msg), "%s[ hdr='0x%02X', cntrl='0x%02X', len='0x%02X', data=[", prefix, frame[0], frame[1], frame[2] );
+
+	for( i = first; i < length; i++ )
+		n += snprintf( msg + n, sizeof(msg) - n, "%s'0x%02X'", (i > first) ? ", " : "", frame[i] );
+
+	snprintf( msg + n, sizeof(msg) - n, "], chksum='0x%02X' ]", frame[ length ] );
+
+	ret = PyObject_CallFunction( self->on_log, "s", msg );
+
+	/* Logging must not break the command: report and carry on */
+	if( !ret )
+		PyErr_WriteUnraisable( self->on_log );
+
+	Py_XDECREF( ret );
+}
+
+
+static int vmc96py_request( vmc96py_object_t * self, unsigned char cntrl, unsigned char cmd, const unsigned char * args, unsigned int args_length, unsigned char * data, unsigned int * data_length )
+{
+	int ret = 0;
+	VMC96_t * vmc96 = self->vmc96;
+
+	if( !vmc96 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "VMC96 Device not initialized" );
+		return -1;
+	}
+
+	if( self->on_log != Py_None )
+		vmc96py_log_frame( self, "VMC96 Request: ", cntrl, cmd, args, args_length );
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = vmc96_k1_request( vmc96, cntrl, cmd, args, args_length, data, data_length );
+	Py_END_ALLOW_THREADS
+
+	if( ret != VMC96_SUCCESS )
+	{
+		PyErr_Format( PyExc_RuntimeError, "Invalid Response: %s", vmc96_get_error_code_string( ret ) );
+		return -1;
+	}
+
+	/* The library consumes the acknowledge byte: VMC96.py returns it as the response data */
+	if( *data_length == 0 )
+	{
+		data[0] = VMC96PY_RESPONSE_POSITIVE_ACK;
+		*data_length = 1;
+	}
+
+	if( self->on_log != Py_None )
+		vmc96py_log_frame( self, "VMC96 Response: ", cntrl, -1, data, *data_length );
+
+	return 0;
+}
+
+
+static PyObject * vmc96py_execute_command( vmc96py_object_t * self, unsigned char cntrl, unsigned char cmd, const unsigned char * args, unsigned int args_length )
+{
+	unsigned char data[ VMC96_REQUEST_DATA_MAX_LEN ];
+	unsigned int data_length = 0;
+	unsigned int i = 0;
+	PyObject * list = NULL;
+
+	if( vmc96py_request( self, cntrl, cmd, args, args_length, data, &data_length ) != 0 )
+		return NULL;
+
+	list = PyList_New( data_length );
+
+	if( !list )
+		return NULL;
+
+	for( i = 0; i < data_length; i++ )
+		PyList_SET_ITEM( list, i, PyLong_FromLong( data[i] ) );
+
+	return list;
+}
+
+
+/* ********************************************************************* */
+/* *                            BUFFER TYPE                            * */
+/* ********************************************************************* */
+
+static PyTypeObject vmc96py_buffer_type;
+
+
+static vmc96py_buffer_t * vmc96py_buffer_new( char format, Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t cols )
+{
+	vmc96py_buffer_t * buf = PyObject_New( vmc96py_buffer_t, &vmc96py_buffer_type );
+
+	if( !buf )
+		return NULL;
+
+	buf->data = calloc( rows * cols, itemsize );
+	buf->itemsize = itemsize;
+	buf->ndim = ( cols > 1 ) ? 2 : 1;
+	buf->shape[0] = rows;
+	buf->shape[1] = cols;
+	buf->strides[0] = cols * itemsize;
+	buf->strides[1] = itemsize;
+	buf->format[0] = format;
+	buf->format[1] = '\0';
+
+	if( !buf->data )
+	{
+		Py_DECREF( buf );
+		return (vmc96py_buffer_t*) PyErr_NoMemory();
+	}
+
+	return buf;
+}
+
+
+static int vmc96py_buffer_getbuffer( vmc96py_buffer_t * self, Py_buffer * view, int flags )
+{
+	if( flags & PyBUF_WRITABLE )
+	{
+		PyErr_SetString( PyExc_BufferError, "_vmc96.Buffer is read-only" );
+		return -1;
+	}
+
+	view->obj = (PyObject*) self;
+	view->buf = self->data;
+	view->len = self->shape[0] * self->shape[1] * self->itemsize;
+	view->readonly = 1;
+	view->itemsize = self->itemsize;
+	view->format = ( flags & PyBUF_FORMAT ) ? self->format : NULL;
+	view->ndim = self->ndim;
+	view->shape = ( flags & PyBUF_ND ) ? self->shape : NULL;
+	view->strides = ( (flags & PyBUF_STRIDES) == PyBUF_STRIDES ) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+
+	/* Released by PyBuffer_Release(): the data lives as long as any view */
+	Py_INCREF( self );
+
+	return 0;
+}
+
+
+static Py_ssize_t vmc96py_buffer_length( vmc96py_buffer_t * self )
+{
+	return self->shape[0];
+}
+
+
+static void vmc96py_buffer_dealloc( vmc96py_buffer_t * self )
+{
+	free( self->data );
+	PyObject_Free( self );
+}
+
+
+static PyBufferProcs vmc96py_buffer_procs =
+{
+	.bf_getbuffer = (getbufferproc) vmc96py_buffer_getbuffer,
+};
+
+
+static PySequenceMethods vmc96py_buffer_sequence =
+{
+	.sq_length = (lenfunc) vmc96py_buffer_length,
+};
+
+
+static PyTypeObject vmc96py_buffer_type =
+{
+	PyVarObject_HEAD_INIT( NULL, 0 )
+	.tp_name = "_vmc96.Buffer",
+	.tp_doc = "Read-only packed sample array (buffer protocol, use numpy.asarray() or memoryview()).",
+	.tp_basicsize = sizeof(vmc96py_buffer_t),
+	.tp_itemsize = 0,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_dealloc = (destructor) vmc96py_buffer_dealloc,
+	.tp_as_buffer = &vmc96py_buffer_procs,
+	.tp_as_sequence = &vmc96py_buffer_sequence,
+};
+
+
+static PyObject * vmc96py_bulk_error( vmc96py_buffer_t * buf, int ret )
+{
+	Py_DECREF( buf );
+	PyErr_Format( PyExc_RuntimeError, "Invalid Response: %s", vmc96_get_error_code_string( ret ) );
+	return NULL;
+}
+
+
+/* ********************************************************************* */
+/* *                            VMC96 TYPE                             * */
+/* ********************************************************************* */
+
+static int vmc96py_init( vmc96py_object_t * self, PyObject * args, PyObject * kwargs )
+{
+	int ret = 0;
+	int inverted = 0;
+	VMC96_t * vmc96 = NULL;
+	static char * keywords[] = { "invertedArray", NULL };
+
+	if( !PyArg_ParseTupleAndKeywords( args, kwargs, "|p", keywords, &inverted ) )
+		return -1;
+
+	/* Other threads may be using the open context with the GIL released: never close it here */
+	if( self->vmc96 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "VMC96 Device already initialized" );
+		return -1;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = vmc96_initialize( &vmc96 );
+	Py_END_ALLOW_THREADS
+
+	if( ret != VMC96_SUCCESS )
+	{
+		PyErr_Format( PyExc_RuntimeError, "Error initializing VMC96 Device: %s", vmc96_get_error_code_string( ret ) );
+		return -1;
+	}
+
+	self->vmc96 = vmc96;
+	self->inverted = inverted;
+
+	return 0;
+}
+
+
+static PyObject * vmc96py_new( PyTypeObject * type, PyObject * args, PyObject * kwargs )
+{
+	vmc96py_object_t * self = (vmc96py_object_t*) type->tp_alloc( type, 0 );
+
+	if( self )
+	{
+		Py_INCREF( Py_None );
+		self->on_log = Py_None;
+	}
+
+	return (PyObject*) self;
+}
+
+
+static void vmc96py_dealloc( vmc96py_object_t * self )
+{
+	if( self->vmc96 )
+		vmc96_finish( self->vmc96 );
+
+	Py_XDECREF( self->on_log );
+	Py_TYPE( self )->tp_free( (PyObject*) self );
+}
+
+
+static PyObject * vmc96py_str( vmc96py_object_t * self )
+{
+	return PyUnicode_FromString( "VMC96 API" );
+}
+
+
+static PyObject * vmc96py_motor_run( vmc96py_object_t * self, PyObject * args )
+{
+	unsigned char motor_id = 0;
+
+	if( !PyArg_ParseTuple( args, "b", &motor_id ) )
+		return NULL;
+
+	if( self->inverted )
+		motor_id = VMC96PY_INVERT_MOTOR_ID( motor_id );
+
+	return vmc96py_execute_command( self, VMC96PY_CONTROLLER_MOTOR, VMC96PY_COMMAND_MOTOR_RUN, &motor_id, 1 );
+}
+
+
+static PyObject * vmc96py_motor_stop_all( vmc96py_object_t * self, PyObject * unused )
+{
+	return vmc96py_execute_command( self, VMC96PY_CONTROLLER_MOTOR, VMC96PY_COMMAND_MOTOR_STOP_ALL, NULL, 0 );
+}
+
+
+static PyObject * vmc96py_motor_reset( vmc96py_object_t * self, PyObject * unused )
+{
+	return vmc96py_execute_command( self, VMC96PY_CONTROLLER_MOTOR, VMC96PY_COMMAND_MOTOR_RESET, NULL, 0 );
+}
+
+
+static PyObject * vmc96py_relay_reset( vmc96py_object_t * self, PyObject * args )
+{
+	unsigned char relay_id = 0;
+
+	if( !PyArg_ParseTuple( args, "b", &relay_id ) )
+		return NULL;
+
+	return vmc96py_execute_command( self, VMC96PY_CONTROLLER_RELAY + relay_id, VMC96PY_COMMAND_RELAY_RESET, NULL, 0 );
+}
+
+
+static PyObject * vmc96py_relay_set_state( vmc96py_object_t * self, PyObject * args )
+{
+	unsigned char relay_id = 0;
+	unsigned char state = 0;
+
+	if( !PyArg_ParseTuple( args, "bb", &relay_id, &state ) )
+		return NULL;
+
+	return vmc96py_execute_command( self, VMC96PY_CONTROLLER_RELAY + relay_id, VMC96PY_COMMAND_RELAY_CONTROL, &state, 1 );
+}
+
+
+static PyObject * vmc96py_opto_sensor_read( vmc96py_object_t * self, PyObject * unused )
+{
+	unsigned char data[ VMC96_REQUEST_DATA_MAX_LEN ];
+	unsigned int data_length = 0;
+	int i = 0;
+	PyObject * list = NULL;
+
+	if( vmc96py_request( self, VMC96PY_CONTROLLER_MOTOR, VMC96PY_COMMAND_MOTOR_OPTO_SENSOR_STATUS, NULL, 0, data, &data_length ) != 0 )
+		return NULL;
+
+	if( data_length != VMC96PY_OPTO_SENSOR_RESPONSE_LENGTH )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "Invalid Opto Sensor Response: Invalid Length" );
+		return NULL;
+	}
+
+	if( data[0] != VMC96PY_COMMAND_MOTOR_OPTO_SENSOR_STATUS )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "Invalid Opto Sensor Response: Malformed" );
+		return NULL;
+	}
+
+	list = PyList_New( VMC96_OPTO_LINE_SAMPLES_PER_BLOCK );
+
+	if( !list )
+		return NULL;
+
+	for( i = 0; i < VMC96_OPTO_LINE_SAMPLES_PER_BLOCK; i++ )
+		PyList_SET_ITEM( list, i, PyLong_FromLong( (data[ 1 + i / 8 ] >> (i % 8)) & 0x01 ) );
+
+	return list;
+}
+
+
+static PyObject * vmc96py_motor_scan_array( vmc96py_object_t * self, PyObject * unused )
+{
+	unsigned char data[ VMC96_REQUEST_DATA_MAX_LEN ];
+	unsigned int data_length = 0;
+	unsigned int i = 0;
+	int bit = 0;
+	char motor[ 8 ];
+	PyObject * status = NULL;
+	PyObject * item = NULL;
+	PyObject * result = NULL;
+
+	if( vmc96py_request( self, VMC96PY_CONTROLLER_MOTOR, VMC96PY_COMMAND_MOTOR_SCAN_ARRAY, NULL, 0, data, &data_length ) != 0 )
+		return NULL;
+
+	if( data_length < 2 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "Invalid Motor Array Scan Response: Invalid Length" );
+		return NULL;
+	}
+
+	if( data[0] != VMC96PY_COMMAND_MOTOR_SCAN_ARRAY )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "Invalid Motor Array Scan Response: Malformed" );
+		return NULL;
+	}
+
+	status = PyList_New( 0 );
+
+	if( !status )
+		return NULL;
+
+	/* One byte per array line, one bit per motor, as in VMC96.motor_scan_array() */
+	for( i = 1; i < data_length; i++ )
+	{
+		for( bit = 0; bit < 8; bit++ )
+		{
+			if( !((data[i] >> bit) & 0x01) )
+				continue;
+
+			snprintf( motor, sizeof(motor), "0x%X%X", i, bit + 1 );
+
+			item = PyUnicode_FromString( motor );
+
+			if( !item || (PyList_Append( status, item ) != 0) )
+			{
+				Py_XDECREF( item );
+				Py_DECREF( status );
+				return NULL;
+			}
+
+			Py_DECREF( item );
+		}
+	}
+
+	result = Py_BuildValue( "{s:d,s:N}", "current_ma", ( 500.0 * data[1] ) / 255.0, "available_motors", status );
+
+	return result;
+}
+
+
+static PyObject * vmc96py_opto_sensor_read_block( vmc96py_object_t * self, PyObject * args )
+{
+	int ret = VMC96_SUCCESS;
+	int count = 1;
+	int interval_ms = 0;
+	int i = 0;
+	vmc96py_buffer_t * buf = NULL;
+	VMC96_t * vmc96 = self->vmc96;
+
+	if( !PyArg_ParseTuple( args, "|ii", &count, &interval_ms ) )
+		return NULL;
+
+	if( !vmc96 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "VMC96 Device not initialized" );
+		return NULL;
+	}
+
+	if( (count < 1) || (interval_ms < 0) )
+	{
+		PyErr_SetString( PyExc_ValueError, "count must be positive and interval_ms not negative" );
+		return NULL;
+	}
+
+	buf = vmc96py_buffer_new( 'B', 1, count, VMC96_OPTO_LINE_SAMPLES_PER_BLOCK );
+
+	if( !buf )
+		return NULL;
+
+	/* VMC96_opto_line_sample_block_t is one byte per sample: decode straight into the array */
+	Py_BEGIN_ALLOW_THREADS
+	for( i = 0; (i < count) && (ret == VMC96_SUCCESS); i++ )
+	{
+		if( (i > 0) && (interval_ms > 0) )
+			usleep( interval_ms * 1000 );
+
+		ret = vmc96_motor_opto_line_status( vmc96, (VMC96_opto_line_sample_block_t*)( (unsigned char *) buf->data + i * VMC96_OPTO_LINE_SAMPLES_PER_BLOCK ) );
+	}
+	Py_END_ALLOW_THREADS
+
+	if( ret != VMC96_SUCCESS )
+		return vmc96py_bulk_error( buf, ret );
+
+	return (PyObject*) buf;
+}
+
+
+static PyObject * vmc96py_motor_current_read( vmc96py_object_t * self, PyObject * args )
+{
+	int ret = VMC96_SUCCESS;
+	int count = 1;
+	int interval_ms = 0;
+	int i = 0;
+	vmc96py_buffer_t * buf = NULL;
+	VMC96_motor_array_status_t status;
+	VMC96_t * vmc96 = self->vmc96;
+
+	if( !PyArg_ParseTuple( args, "|ii", &count, &interval_ms ) )
+		return NULL;
+
+	if( !vmc96 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "VMC96 Device not initialized" );
+		return NULL;
+	}
+
+	if( (count < 1) || (interval_ms < 0) )
+	{
+		PyErr_SetString( PyExc_ValueError, "count must be positive and interval_ms not negative" );
+		return NULL;
+	}
+
+	buf = vmc96py_buffer_new( 'I', sizeof(unsigned int), count, 1 );
+
+	if( !buf )
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	for( i = 0; (i < count) && (ret == VMC96_SUCCESS); i++ )
+	{
+		if( (i > 0) && (interval_ms > 0) )
+			usleep( interval_ms * 1000 );
+
+		ret = vmc96_motor_get_status( vmc96, &status );
+
+		if( ret == VMC96_SUCCESS )
+			((unsigned int *) buf->data)[i] = status.current_ma;
+	}
+	Py_END_ALLOW_THREADS
+
+	if( ret != VMC96_SUCCESS )
+		return vmc96py_bulk_error( buf, ret );
+
+	return (PyObject*) buf;
+}
+
+
+static PyObject * vmc96py_motor_scan_bitmap( vmc96py_object_t * self, PyObject * unused )
+{
+	int ret = 0;
+	vmc96py_buffer_t * buf = NULL;
+	VMC96_motor_array_scan_result_t result;
+	VMC96_t * vmc96 = self->vmc96;
+
+	if( !vmc96 )
+	{
+		PyErr_SetString( PyExc_RuntimeError, "VMC96 Device not initialized" );
+		return NULL;
+	}
+
+	buf = vmc96py_buffer_new( 'B', 1, VMC96_MOTOR_ARRAY_ROWS_COUNT, VMC96_MOTOR_ARRAY_COLUMNS_COUNT );
+
+	if( !buf )
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = vmc96_motor_scan_array( vmc96, &result );
+	Py_END_ALLOW_THREADS
+
+	if( ret != VMC96_SUCCESS )
+		return vmc96py_bulk_error( buf, ret );
+
+	memcpy( buf->data, result.array.motor, sizeof(result.array.motor) );
+
+	return (PyObject*) buf;
+}
+
+
+static PyObject * vmc96py_get_on_log( vmc96py_object_t * self, void * closure )
+{
+	Py_INCREF( self->on_log );
+	return self->on_log;
+}
+
+
+static int vmc96py_set_on_log( vmc96py_object_t * self, PyObject * value, void * closure )
+{
+	if( !value )
+		value = Py_None;
+
+	if( (value != Py_None) && !PyCallable_Check( value ) )
+	{
+		PyErr_SetString( PyExc_TypeError, "on_log must be callable or None" );
+		return -1;
+	}
+
+	Py_INCREF( value );
+	Py_XSETREF( self->on_log, value );
+
+	return 0;
+}
+
+
+static PyMethodDef vmc96py_methods[] =
+{
+	{ "motor_run",        (PyCFunction) vmc96py_motor_run,        METH_VARARGS, "Run the motor with the given K1 motor id." },
+	{ "motor_stop_all",   (PyCFunction) vmc96py_motor_stop_all,   METH_NOARGS,  "Stop all motors." },
+	{ "motor_reset",      (PyCFunction) vmc96py_motor_reset,      METH_NOARGS,  "Reset the motor array controller." },
+	{ "relay_reset",      (PyCFunction) vmc96py_relay_reset,      METH_VARARGS, "Reset a relay controller." },
+	{ "relay_set_state",  (PyCFunction) vmc96py_relay_set_state,  METH_VARARGS, "Switch a relay on or off." },
+	{ "opto_sensor_read", (PyCFunction) vmc96py_opto_sensor_read, METH_NOARGS,  "Read the opto-sensor sample block (32 samples)." },
+	{ "motor_scan_array", (PyCFunction) vmc96py_motor_scan_array, METH_NOARGS,  "Scan the motor array." },
+	{ "opto_sensor_read_block", (PyCFunction) vmc96py_opto_sensor_read_block, METH_VARARGS, "Read count opto-sensor blocks, interval_ms apart, as a uint8 (count, 32) Buffer." },
+	{ "motor_current_read", (PyCFunction) vmc96py_motor_current_read, METH_VARARGS, "Read count current samples (mA), interval_ms apart, as a uint32 (count,) Buffer." },
+	{ "motor_scan_bitmap", (PyCFunction) vmc96py_motor_scan_bitmap, METH_NOARGS, "Scan the motor array as a uint8 (rows, columns) Buffer." },
+	{ NULL, NULL, 0, NULL }
+};
+
+
+static PyGetSetDef vmc96py_getset[] =
+{
+	{ "on_log", (getter) vmc96py_get_on_log, (setter) vmc96py_set_on_log, "Log callback (called with request/response strings).", NULL },
+	{ NULL, NULL, NULL, NULL, NULL }
+};
+
+
+static PyTypeObject vmc96py_type =
+{
+	PyVarObject_HEAD_INIT( NULL, 0 )
+	.tp_name = "_vmc96.VMC96",
+	.tp_doc = "VMC96 Board API backed by the C library.",
+	.tp_basicsize = sizeof(vmc96py_object_t),
+	.tp_itemsize = 0,
+	.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	.tp_new = vmc96py_new,
+	.tp_init = (initproc) vmc96py_init,
+	.tp_dealloc = (destructor) vmc96py_dealloc,
+	.tp_str = (reprfunc) vmc96py_str,
+	.tp_methods = vmc96py_methods,
+	.tp_getset = vmc96py_getset,
+};
+
+
+/* ********************************************************************* */
+/* *                              MODULE                               * */
+/* ********************************************************************* */
+
+static struct PyModuleDef vmc96py_module =
+{
+	PyModuleDef_HEAD_INIT,
+	.m_name = "_vmc96",
+	.m_doc = "VMC96 Board API (C library binding).",
+	.m_size = -1,
+};
+
+
+PyMODINIT_FUNC PyInit__vmc96( void )
+{
+	PyObject * module = NULL;
+
+	if( (PyType_Ready( &vmc96py_type ) < 0) || (PyType_Ready( &vmc96py_buffer_type ) < 0) )
+		return NULL;
+
+	module = PyModule_Create( &vmc96py_module );
+
+	if( !module )
+		return NULL;
+
+	Py_INCREF( &vmc96py_type );
+
+	if( PyModule_AddObject( module, "VMC96", (PyObject*) &vmc96py_type ) < 0 )
+	{
+		Py_DECREF( &vmc96py_type );
+		Py_DECREF( module );
+		return NULL;
+	}
+
+	Py_INCREF( &vmc96py_buffer_type );
+
+	if( PyModule_AddObject( module, "Buffer", (PyObject*) &vmc96py_buffer_type ) < 0 )
+	{
+		Py_DECREF( &vmc96py_buffer_type );
+		Py_DECREF( module );
+		return NULL;
+	}
+
+	return module;
+}
+
+/* eof */
@@ -0,0 +1,470 @@
+/*!
+	\file vmc96replay.c
+	\brief VMC96 K1 Capture Replay Tool
+	\author Tiago Ventura (tiago.ventura@gmail.com)
+	\date Dec.2018
+
+	Copyright (c) 2018 Tiago Ventura (tiago.ventura@gmail.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "vmc96api.h"
+
+
+/* ********************************************************************* */
+/* *                              DEFINES                              * */
+/* ********************************************************************* */
+
+#define VMC96REPLAY_SUCCESS                               (0)
+#define VMC96REPLAY_ERROR_INVALID_ARGS                    (-1)
+#define VMC96REPLAY_ERROR_OPEN_FILE                       (-2)
+#define VMC96REPLAY_ERROR_INVALID_FILE                    (-3)
+#define VMC96REPLAY_ERROR_OUT_OF_MEMORY                   (-4)
+
+#define VMC96REPLAY_IDLE_READ_DELAY_US                    (1000)   /* No response pending: avoid spinning */
+
+
+/* ********************************************************************* */
+/* *                        STRUCTS AND DATA TYPES                     * */
+/* ********************************************************************* */
+
+typedef struct vmc96replay_frame_s vmc96replay_frame_t;
+typedef struct vmc96replay_device_s vmc96replay_device_t;
+
+struct vmc96replay_frame_s
+{
+	unsigned long long time_us;         /* Since the capture start */
+	int result;
+	int direction;
+	int length;
+	const unsigned char * frame;
+};
+
+struct vmc96replay_device_s
+{
+	vmc96replay_frame_t * frames;
+	int count;
+	int cursor;                         /* Next frame expected to be written */
+	int pending;                        /* Response to be delivered (-1 if none) */
+	int fast;
+	unsigned long long write_us;
+	unsigned long long frame_mismatches;
+};
+
+
+/* ********************************************************************* */
+/* *                             PROTOTYPES                            * */
+/* ********************************************************************* */
+
+static const char * vmc96replay_get_error_code_string( int cod );
+static void vmc96replay_show_usage( void );
+static unsigned long long vmc96replay_monotonic_us( void );
+static void vmc96replay_sleep_until( unsigned long long us );
+static int vmc96replay_load( const char * path, unsigned char ** buf, VMC96_capture_header_t * header, vmc96replay_frame_t ** frames, int * count );
+static int vmc96replay_device_purge( void * userdata );
+static int vmc96replay_device_write( void * userdata, const unsigned char * buf, int len );
+static int vmc96replay_device_read( void * userdata, unsigned char * buf, int len );
+static void vmc96replay_report( VMC96_t * vmc96 );
+
+
+/* ********************************************************************* */
+/* *                          IMPLEMENTATION                           * */
+/* ********************************************************************* */
+
+static const char * vmc96replay_get_error_code_string( int cod )
+{
+	switch(cod)
+	{
+		case VMC96REPLAY_SUCCESS                  : return "Success."; break;
+		case VMC96REPLAY_ERROR_INVALID_ARGS       : return "Invalid arguments."; break;
+		case VMC96REPLAY_ERROR_OPEN_FILE          : return "Can not read capture file."; break;
+		case VMC96REPLAY_ERROR_INVALID_FILE       : return "Invalid or truncated capture file."; break;
+		case VMC96REPLAY_ERROR_OUT_OF_MEMORY      : return "Out of memory."; break;
+		default                                   : return "Unknown error."; break;
+	}
+}
+
+
+static void vmc96replay_show_usage( void )
+{
+	printf( "REPLAY A CAPTURE AT ITS ORIGINAL SPEED:\n\n" );
+	printf( "	vmc96replay capture.bin\n\n" );
+	printf( "REPLAY A CAPTURE AS FAST AS POSSIBLE (N TIMES):\n\n" );
+	printf( "	vmc96replay --fast --loops=N capture.bin\n\n" );
+	printf( "PRINT EVERY TRANSACTION:\n\n" );
+	printf( "	vmc96replay --verbose capture.bin\n\n" );
+}
+
+
+static unsigned long long vmc96replay_monotonic_us( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ((unsigned long long) ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+
+static void vmc96replay_sleep_until( unsigned long long us )
+{
+	unsigned long long now = vmc96replay_monotonic_us();
+
+	if( us > now )
+		usleep( us - now );
+}
+
+
+static int vmc96replay_load( const char * path, unsigned char ** buf, VMC96_capture_header_t * header, vmc96replay_frame_t ** frames, int * count )
+{
+	FILE * fp = NULL;
+	long size = 0;
+	long offset = 0;
+	int n = 0;
+	unsigned long long time_us = 0;
+	VMC96_capture_record_t record;
+
+	fp = fopen( path, "rb" );
+
+	if( !fp )
+		return VMC96REPLAY_ERROR_OPEN_FILE;
+
+	fseek( fp, 0, SEEK_END );
+	size = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+
+	*buf = (unsigned char*) malloc( size + 1 );
+
+	/* Every record is at least a record header */
+	*frames = (vmc96replay_frame_t*) calloc( size / sizeof(VMC96_capture_record_t) + 1, sizeof(vmc96replay_frame_t) );
+
+	if( !*buf || !*frames )
+	{
+		fclose( fp );
+		return VMC96REPLAY_ERROR_OUT_OF_MEMORY;
+	}
+
+	if( fread( *buf, 1, size, fp ) != (size_t) size )
+	{
+		fclose( fp );
+		return VMC96REPLAY_ERROR_OPEN_FILE;
+	}
+
+	fclose( fp );
+
+	if( size < (long) sizeof(VMC96_capture_header_t) )
+		return VMC96REPLAY_ERROR_INVALID_FILE;
+
+	memcpy( header, *buf, sizeof(VMC96_capture_header_t) );
+
+	if( memcmp( header->magic, VMC96_CAPTURE_MAGIC, sizeof(header->magic) ) || (header->version != VMC96_CAPTURE_VERSION) )
+		return VMC96REPLAY_ERROR_INVALID_FILE;
+
+	offset = sizeof(VMC96_capture_header_t);
+
+	while( offset + (long) sizeof(VMC96_capture_record_t) <= size )
+	{
+		memcpy( &record, *buf + offset, sizeof(record) );
+		offset += sizeof(record);
+
+		if( offset + record.length > size )
+			return VMC96REPLAY_ERROR_INVALID_FILE;
+
+		time_us += record.delta_us;
+
+		(*frames)[n].time_us = time_us;
+		(*frames)[n].result = record.result;
+		(*frames)[n].direction = record.direction;
+		(*frames)[n].length = record.length;
+		(*frames)[n].frame = *buf + offset;
+
+		offset += record.length;
+		n++;
+	}
+
+	*count = n;
+
+	return VMC96REPLAY_SUCCESS;
+}
+
+
+static int vmc96replay_device_purge( void * userdata )
+{
+	vmc96replay_device_t * dev = (vmc96replay_device_t*) userdata;
+
+	dev->pending = -1;
+
+	return 0;
+}
+
+
+static int vmc96replay_device_write( void * userdata, const unsigned char * buf, int len )
+{
+	vmc96replay_device_t * dev = (vmc96replay_device_t*) userdata;
+	vmc96replay_frame_t * tx = NULL;
+
+	while( (dev->cursor < dev->count) && (dev->frames[ dev->cursor ].direction != VMC96_TRACE_DIRECTION_TX) )
+		dev->cursor++;
+
+	if( dev->cursor >= dev->count )
+		return len;
+
+	tx = &dev->frames[ dev->cursor++ ];
+
+	if( (tx->length != len) || memcmp( tx->frame, buf, len ) )
+		dev->frame_mismatches++;
+
+	dev->pending = -1;
+
+	if( (dev->cursor < dev->count) && (dev->frames[ dev->cursor ].direction == VMC96_TRACE_DIRECTION_RX) )
+		dev->pending = dev->cursor++;
+
+	dev->write_us = vmc96replay_monotonic_us();
+
+	return len;
+}
+
+
+static int vmc96replay_device_read( void * userdata, unsigned char * buf, int len )
+{
+	vmc96replay_device_t * dev = (vmc96replay_device_t*) userdata;
+	vmc96replay_frame_t * rx = NULL;
+
+	/* Recorded timeout: let the library time out */
+	if( (dev->pending < 0) || (dev->frames[ dev->pending ].length == 0) )
+	{
+		usleep( VMC96REPLAY_IDLE_READ_DELAY_US );
+		return 0;
+	}
+
+	rx = &dev->frames[ dev->pending ];
+
+	/* Original speed: the response arrives as late as it did on the board */
+	if( !dev->fast )
+		vmc96replay_sleep_until( dev->write_us + (rx->time_us - rx[-1].time_us) );
+
+	if( len > rx->length )
+		len = rx->length;
+
+	memcpy( buf, rx->frame, len );
+
+	dev->pending = -1;
+
+	return len;
+}
+
+
+static void vmc96replay_report( VMC96_t * vmc96 )
+{
+	VMC96_stats_t * stats = NULL;
+	VMC96_command_stats_t * cs = NULL;
+	int i = 0;
+
+	stats = (VMC96_stats_t*) malloc( sizeof(VMC96_stats_t) );
+
+	if( !stats )
+		return;
+
+	vmc96_get_stats( vmc96, stats );
+
+	printf( "\nCNTLR  CMD   REQUESTS  ERRORS  P50(us)   P99(us)   PARSE P50(ns)\n" );
+
+	for( i = 0; i < VMC96_STATS_COMMANDS_COUNT; i++ )
+	{
+		cs = &stats->command[i];
+
+		if( !cs->requests )
+			continue;
+
+		printf( "0x%02X   0x%02X  %8llu  %6llu  %8llu  %8llu  %13llu\n", cs->id_controller, cs->command,
+			cs->requests, cs->errors,
+			vmc96_histogram_percentile( &cs->total, 50.0 ) / 1000,
+			vmc96_histogram_percentile( &cs->total, 99.0 ) / 1000,
+			vmc96_histogram_percentile( &cs->phase[ VMC96_STATS_PHASE_PARSE ], 50.0 ) );
+	}
+
+	free( stats );
+}
+
+
+/* ********************************************************************* */
+/* *                                MAIN                               * */
+/* ********************************************************************* */
+int main( int argc, char ** argv )
+{
+	int ret = 0;
+	int index = 0;
+	int loops = 1;
+	int verbose = 0;
+	int loop = 0;
+	int i = 0;
+	int expected = 0;
+	unsigned long long transactions = 0;
+	unsigned long long result_mismatches = 0;
+	unsigned long long start_us = 0;
+	unsigned long long elapsed_us = 0;
+	unsigned char * buf = NULL;
+	const unsigned char * f = NULL;
+	VMC96_capture_header_t header;
+	VMC96_transport_t transport;
+	VMC96_timeout_policy_t policy;
+	vmc96replay_device_t dev;
+	VMC96_t * vmc96 = NULL;
+
+	static struct option options[] =
+	{
+		{ "fast",        no_argument,       0,  'a' },
+		{ "loops",       required_argument, 0,  'b' },
+		{ "verbose",     no_argument,       0,  'c' },
+		{ "help",        no_argument,       0,  'd' },
+		{ NULL,          no_argument,       0,   0  }
+	};
+
+	memset( &dev, 0, sizeof(dev) );
+	dev.pending = -1;
+
+	while( (ret = getopt_long( argc, argv, "ab:cd", options, &index )) != -1 )
+	{
+		switch( ret )
+		{
+			case 'a' : dev.fast = 1; break;
+			case 'b' : loops = atoi( optarg ); break;
+			case 'c' : verbose = 1; break;
+
+			case 'd' :
+			default :
+				vmc96replay_show_usage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if( (optind >= argc) || (loops < 1) )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96replay_get_error_code_string( VMC96REPLAY_ERROR_INVALID_ARGS ) );
+		return EXIT_FAILURE;
+	}
+
+	ret = vmc96replay_load( argv[optind], &buf, &header, &dev.frames, &dev.count );
+
+	if( ret != VMC96REPLAY_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s\n", vmc96replay_get_error_code_string(ret) );
+		free( buf );
+		free( dev.frames );
+		return EXIT_FAILURE;
+	}
+
+	printf( "Capture: %s, board '%.*s', %d frames\n", argv[optind], VMC96_CAPTURE_BOARD_ID_MAX_LEN, header.board_id, dev.count );
+
+	memset( &transport, 0, sizeof(transport) );
+	transport.purge = vmc96replay_device_purge;
+	transport.write = vmc96replay_device_write;
+	transport.read = vmc96replay_device_read;
+	transport.read_delay_ms = 0;
+	transport.userdata = &dev;
+
+	ret = vmc96_initialize_transport( &vmc96, &transport );
+
+	if( ret != VMC96_SUCCESS )
+	{
+		fprintf( stderr, "Error: %s (Cod: %d)\n", vmc96_get_error_code_string(ret), ret );
+		free( buf );
+		free( dev.frames );
+		return EXIT_FAILURE;
+	}
+
+	/* As fast as possible: recorded timeouts should not cost a full second each */
+	if( dev.fast )
+	{
+		policy.mode = VMC96_TIMEOUT_MODE_ADAPTIVE;
+		policy.percentile = 99.0;
+		policy.safety_factor = 2.0;
+		policy.floor_ms = 5;
+		policy.min_samples = 1;
+
+		vmc96_set_timeout_policy( vmc96, &policy );
+	}
+
+	start_us = vmc96replay_monotonic_us();
+
+	for( loop = 0; loop < loops; loop++ )
+	{
+		unsigned long long loop_us = vmc96replay_monotonic_us();
+
+		dev.cursor = 0;
+
+		for( i = 0; i < dev.count; i++ )
+		{
+			if( dev.frames[i].direction != VMC96_TRACE_DIRECTION_TX )
+				continue;
+
+			f = dev.frames[i].frame;
+
+			/* Only well-formed requests can be re-issued through the API */
+			if( (dev.frames[i].length < 5) || (f[2] != dev.frames[i].length) )
+				continue;
+
+			if( !dev.fast )
+				vmc96replay_sleep_until( loop_us + dev.frames[i].time_us );
+
+			expected = dev.frames[i].result;
+
+			if( (expected == VMC96_SUCCESS) && (i + 1 < dev.count) && (dev.frames[i + 1].direction == VMC96_TRACE_DIRECTION_RX) )
+				expected = dev.frames[i + 1].result;
+
+			dev.cursor = i;
+
+			ret = vmc96_k1_request( vmc96, f[1], f[3], f + 4, f[2] - 5, NULL, NULL );
+
+			transactions++;
+
+			if( ret != expected )
+				result_mismatches++;
+
+			if( verbose )
+				printf( "%10llu.%03llu ms  0x%02X 0x%02X  result=%d expected=%d%s\n", dev.frames[i].time_us / 1000, dev.frames[i].time_us % 1000,
+					f[1], f[3], ret, expected, ( ret != expected ) ? "  MISMATCH" : "" );
+		}
+	}
+
+	elapsed_us = vmc96replay_monotonic_us() - start_us;
+
+	printf( "Transactions: %llu, result mismatches: %llu, frame mismatches: %llu\n", transactions, result_mismatches, dev.frame_mismatches );
+	printf( "Elapsed: %.3f s, %.1f transactions/s\n", elapsed_us / 1e6, elapsed_us ? transactions * 1e6 / elapsed_us : 0.0 );
+
+	vmc96replay_report( vmc96 );
+
+	vmc96_finish( vmc96 );
+
+	free( buf );
+	free( dev.frames );
+
+	return ( result_mismatches == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* eof */